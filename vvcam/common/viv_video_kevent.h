@@ -94,10 +94,22 @@ struct viv_video_event {
 	void *file;
 	u64 addr;
 	int buf_index;
+	/*
+	 * flags and seq sit in what used to be padding, the struct stays at
+	 * 48 bytes so the VIV_VIDIOC_EVENT_COMPLETE number does not change
+	 */
+	u32 flags;	/* VIV_VIDEO_EVENT_FLAG_* */
 	u64 response;
 	u32 sync;
+	u32 seq;	/* echoed back by VIV_VIDIOC_EVENT_COMPLETE, 0 completes the oldest */
 };
 
+/*
+ * SET_FMT on a running stream: the buffers stay, the daemon switches the
+ * sensor mode and stages ISPIOC_S_RECONFIG instead of restarting.
+ */
+#define VIV_VIDEO_EVENT_FLAG_SEAMLESS	(1 << 0)
+
 struct v4l2_user_buffer {
 	u64 addr;
 	int streamid;
@@ -202,6 +214,9 @@ struct viv_caps_supports{
 
 #define VIV_VIDEO_EVENT_TIMOUT_MS	5000
 
+/* struct isp_stats_frame, one per buffer of the isp stats node */
+#define V4L2_META_FMT_VIV_ISP_STATS	v4l2_fourcc('V', 'I', 'S', 'S')
+
 #define VIV_VIDIOC_EVENT_COMPLETE       _IOW('V',  BASE_VIDIOC_PRIVATE + 0, struct viv_video_event)
 #define VIV_VIDIOC_BUFFER_ALLOC         _IOWR('V', BASE_VIDIOC_PRIVATE + 1, struct ext_buf_info)
 #define VIV_VIDIOC_BUFFER_FREE          _IOWR('V', BASE_VIDIOC_PRIVATE + 2, struct ext_buf_info)
@@ -90,6 +90,7 @@
 #define V4L2_CID_VIV_MP_OUT_FORMAT (VIV_CUSTOM_CID_BASE + 0x20)
 #define V4L2_CID_VIV_PIPELINE_SMP_MODE (VIV_CUSTOM_CID_BASE + 0x21)
 #define V4L2_CID_VIV_PIPELINE_DWE_ENABLED_STATUS (VIV_CUSTOM_CID_BASE + 0x22)
+#define V4L2_CID_VIV_FRAME_DROPS (VIV_CUSTOM_CID_BASE + 0x23)
 
 enum v4l2_ctrl_direction {
 	V4L2_CTRL_GET,
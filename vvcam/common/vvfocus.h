@@ -7,6 +7,7 @@ enum {
     VVFOCUSIOC_SET_POS,
     VVFOCUSIOC_SET_REG,
     VVFOCUSIOC_GET_REG,
+    VVFOCUSIOC_SET_MOVE,
     VVFOCUSIOC_MAX,
 
 };
@@ -32,4 +33,41 @@ struct vvfocus_pos_s {
     int32_t pos;
 };
 
+typedef enum vvfocus_profile_e {
+    VVFOCUS_PROFILE_DIRECT = 0,     /* one write to the target */
+    VVFOCUS_PROFILE_LINEAR,         /* steps equal steps, step_us apart */
+    VVFOCUS_PROFILE_RINGING,        /* 2 or 3 shaped steps, step_us = half resonance period */
+} vvfocus_profile_t;
+
+#define VVFOCUS_MAX_STEPS 16
+
+/*
+ * VVFOCUSIOC_SET_MOVE returns once the first step is written, the rest
+ * run in the driver. A new move replaces one still in progress. When the
+ * lens has settled a VVFOCUS_EVENT_SETTLED event carries a struct
+ * vvfocus_settled_s; frame_id counts on from the one given here by
+ * frame_us, so it names the first frame started after the settle.
+ * Zero step_us/settle_us pick the driver defaults, seq returns a fence.
+ */
+struct vvfocus_move_s {
+    vvfocus_mode_t mode;
+    int32_t pos;
+    vvfocus_profile_t profile;
+    uint32_t steps;
+    uint32_t step_us;
+    uint32_t settle_us;
+    uint32_t frame_id;
+    uint32_t frame_us;
+    uint32_t seq;
+};
+
+#define VVFOCUS_EVENT_SETTLED (V4L2_EVENT_PRIVATE_START + 0x4000)
+
+struct vvfocus_settled_s {
+    uint32_t seq;
+    int32_t pos;
+    uint32_t frame_id;
+    uint32_t move_us;   /* first write to settled */
+};
+
 #endif
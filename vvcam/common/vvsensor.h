@@ -97,6 +97,8 @@ enum {
 	VVSENSORIOC_G_EXPAND_CURVE,
 	VVSENSORIOC_S_TEST_PATTERN,
 	VVSENSORIOC_G_LENS,
+	VVSENSORIOC_S_EXP_GAIN_BATCH,
+	VVSENSORIOC_S_SENSOR_MODE_SEAMLESS,
 	VVSENSORIOC_MAX,
 };
 
@@ -111,6 +113,12 @@ struct vvcam_sccb_data_s {
 	uint32_t data;
 };
 
+/*
+ * A register table entry with this addr is a delay of data ms. It sits
+ * above the 16 bit sensor register space, so 0xffff stays a register.
+ */
+#define VVSENSOR_SEQ_DELAY	0x10000
+
 /* vsi native usage */
 struct vvcam_sccb_cfg_s {
 	uint8_t slave_addr;
@@ -265,6 +273,39 @@ typedef struct vvcam_mode_info_array_s {
 	struct vvcam_mode_info_s modes[VVCAM_SUPPORT_MAX_MODE_COUNT];
 } vvcam_mode_info_array_t;
 
+#define VVSENSOR_BATCH_LONG_EXP		(1 << 0)
+#define VVSENSOR_BATCH_EXP		(1 << 1)
+#define VVSENSOR_BATCH_VS_EXP		(1 << 2)
+#define VVSENSOR_BATCH_LONG_GAIN	(1 << 3)
+#define VVSENSOR_BATCH_GAIN		(1 << 4)
+#define VVSENSOR_BATCH_VS_GAIN		(1 << 5)
+#define VVSENSOR_BATCH_VTS		(1 << 6)
+
+/*
+ * VVSENSORIOC_S_EXP_GAIN_BATCH: the fields selected by valid are written
+ * under one sensor group hold, so they take effect on the same frame.
+ * Exposures are in lines, gains in SENSOR_FIX_FRACBITS fixed point. A
+ * field the sensor cannot set fails the whole batch with -EINVAL.
+ */
+typedef struct vvcam_exp_gain_batch_s {
+	uint32_t valid;
+	uint32_t long_exp;
+	uint32_t exp;
+	uint32_t vs_exp;
+	uint32_t long_gain;
+	uint32_t gain;
+	uint32_t vs_gain;
+	uint32_t vts;
+	uint32_t delay_frm;	/* out: frames until the whole batch is active */
+} vvcam_exp_gain_batch_t;
+
+/*
+ * VVSENSORIOC_S_SENSOR_MODE_SEAMLESS takes a vvcam_mode_info_s like
+ * VVSENSORIOC_S_SENSOR_MODE. While streaming the sensor drops to standby
+ * at the end of the current frame, loads the new mode without a software
+ * reset and restarts; when stopped it only selects the mode.
+ */
+
 typedef struct vvcam_lens_s {
 	uint32_t id;
 	char name[16];
@@ -54,6 +54,9 @@
 #define _DWE_DEV_H
 
 #include "vvdefs.h"
+#ifdef __KERNEL__
+#include "video/vvlat.h"
+#endif
 
 #define MAX_DWE_NUM (2)
 #define MAX_CFG_NUM (2)
@@ -73,6 +76,13 @@ struct dwe_hw_info {
 	u32 split_h, split_v1, split_v2;
 };
 
+#define DWE_REG_IMAGE_NUM (13)
+
+/* dwe_hw_info compiled to the geometry register values dwe_s_params writes */
+struct dwe_reg_image {
+	u32 val[DWE_REG_IMAGE_NUM];
+};
+
 enum BUF_ERR_TYPE {
 	BUF_ERR_UNDERFLOW = 1,
 	BUF_ERR_OVERFLOW0 = 1 << 1,
@@ -87,6 +97,33 @@ enum HARDWARE_STATUS {
 	HARDWARE_BUSY,
 };
 
+#if defined(__KERNEL__)
+#define DWE_HW_TAG_NONE (-1)
+#define DWE_HW_TAG(index, which) ((index) * MAX_CFG_NUM + (which))
+
+/* per-stream sink queue, guarded by dwe_ic_dev.sched_lock */
+struct dwe_sched_queue {
+	struct list_head list;
+	u32 depth;
+	u32 max_depth;
+	u32 weight;		/* jobs per round-robin turn, at least 1 */
+	u32 credit;
+	u64 deadline_ns;	/* head of line older than this jumps the round, 0 off */
+	u64 jobs;
+	u64 drops;		/* pulled but returned unprocessed */
+	u64 overdue;
+	u64 flushed;
+	struct vvlat_hist wait;	/* queued until dma start */
+};
+
+/* a frame paired with its output buffer, ready to program */
+struct dwe_job {
+	struct vb2_dc_buf *src;
+	struct vb2_dc_buf *dst;
+	int index;
+};
+#endif
+
 struct dwe_ic_dev {
 	struct dwe_hw_info info[MAX_DWE_NUM][MAX_CFG_NUM];
 	int which[MAX_DWE_NUM];
@@ -104,18 +141,21 @@ struct dwe_ic_dev {
 	struct vb2_dc_buf *dst;
 	spinlock_t irqlock;
 	u32 error;
-	int (*get_index)(struct dwe_ic_dev *dev, struct vb2_dc_buf *buf);
+	spinlock_t sched_lock;
+	struct dwe_sched_queue sq[MAX_DWE_NUM];
+	int rr;
+	struct dwe_job next;
+	struct dwe_reg_image image[MAX_DWE_NUM][MAX_CFG_NUM];
+	int hw_tag;	/* image last programmed, DWE_HW_TAG_NONE if unknown */
+	u64 prog_full;
+	u64 prog_partial;
+	u64 kick_irq;
+	u64 kick_tasklet;
 	struct tasklet_struct tasklet;
+	int irq;
+	bool irq_thread;
+	struct vvlat_hist lat[MAX_DWE_NUM];
 
-#ifdef ENABLE_LATENCY_STATISTIC
-	uint64_t dwe_frame_cnt;
-	uint64_t frame_id_latency;
-	uint64_t frame_in_timestamp;
-	uint64_t frame_out_timestamp;
-	uint32_t interleave_frames;
-	uint64_t dwe_in_timestamp[LATENCY_FRAME_NUM];
-	uint64_t dwe_out_timestamp[LATENCY_FRAME_NUM];
-#endif
 #endif
 
 };
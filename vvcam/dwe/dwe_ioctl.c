@@ -77,32 +77,42 @@ int dwe_reset(struct dwe_ic_dev *dev)
 	return 0;
 }
 
-int dwe_s_params(struct dwe_ic_dev *dev, struct dwe_hw_info *info)
+/* registers behind dwe_reg_image.val, in the order they are written */
+static const u32 dwe_image_regs[DWE_REG_IMAGE_NUM] = {
+	MAP_LUT_SIZE,
+	SRC_IMG_SIZE,
+	SRC_IMG_STRIDE,
+	DST_IMG_SIZE,
+	DST_IMG_STRIDE,
+	DST_IMG_Y_SIZE1,
+	DST_IMG_UV_SIZE1,
+	VERTICAL_SPLIT_LINE,
+	HORIZON_SPLIT_LINE,
+	DEWARP_CTRL,
+	BOUNDRY_PIXEL,
+	SCALE_FACTOR,
+	ROI_START,
+};
+
+void dwe_compile_params(struct dwe_hw_info *info, struct dwe_reg_image *img)
 {
 	u32 reg = 0;
 	u32 reg_y_rbuff_size = ALIGN_UP(info->dst_stride * info->dst_h, 16);
 	u32 vUp = (info->split_v1 & ~0x0F) | 0x0C;
 	u32 vDown = (info->split_v2 & ~0x0F) | 0x0C;
 	u32 hLine = (info->split_h & ~0x0F) | 0x0C;
+	u32 *val = img->val;
 
-	pr_debug("enter %s\n", __func__);
+	*val++ = (info->map_w & 0x7ff) | ((info->map_h & 0x7ff) << 16);
+	*val++ = (info->src_w & 0x1fff) | ((info->src_h & 0x1fff) << 16);
+	*val++ = info->src_stride;
 
-	dwe_write_reg(dev, MAP_LUT_SIZE,
-		      ((info->map_w & 0x7ff) | ((info->map_h & 0x7ff) << 16)));
-	dwe_write_reg(dev, SRC_IMG_SIZE,
-		      ((info->src_w & 0x1fff) |
-		       ((info->src_h & 0x1fff) << 16)));
-	dwe_write_reg(dev, SRC_IMG_STRIDE, info->src_stride);
-
-	dwe_write_reg(dev, DST_IMG_SIZE,
-		      ((info->dst_w & 0x1FFF) |
-		       ((info->dst_h & 0x1FFF) << 16)));
-	dwe_write_reg(dev, DST_IMG_STRIDE, info->dst_stride);
-	dwe_write_reg(dev, DST_IMG_Y_SIZE1, reg_y_rbuff_size >> 4);
-	dwe_write_reg(dev, DST_IMG_UV_SIZE1, info->dst_size_uv >> 4);
-	dwe_write_reg(dev, VERTICAL_SPLIT_LINE,
-		      (vUp & 0x1fff) | ((vDown & 0x1fff) << 16));
-	dwe_write_reg(dev, HORIZON_SPLIT_LINE, (hLine & 0x1fff));
+	*val++ = (info->dst_w & 0x1FFF) | ((info->dst_h & 0x1FFF) << 16);
+	*val++ = info->dst_stride;
+	*val++ = reg_y_rbuff_size >> 4;
+	*val++ = info->dst_size_uv >> 4;
+	*val++ = (vUp & 0x1fff) | ((vDown & 0x1fff) << 16);
+	*val++ = hLine & 0x1fff;
 
 	reg = 0x4C800001;
 	reg |= ((info->split_line & 0x1) << 11);
@@ -112,19 +122,54 @@ int dwe_s_params(struct dwe_ic_dev *dev, struct dwe_hw_info *info)
 	    ((info->src_auto_shadow & 0x1) << 8) |
 	    ((info->dst_auto_shadow & 0x1) << 10);
 	reg |= ((info->hand_shake & 0x1) << 9);
-	dwe_write_reg(dev, DEWARP_CTRL, reg);
-
-	dwe_write_reg(dev, BOUNDRY_PIXEL,
-		      (((info->boundary_y & 0xff) << 16) |
-		       ((info->boundary_u & 0xff)
-			<< 8) | (info->boundary_v & 0xff)));
-	dwe_write_reg(dev, SCALE_FACTOR, info->scale_factor);
-	dwe_write_reg(dev, ROI_START,
-		      ((info->roi_x & 0x1fff) |
-		       ((info->roi_y & 0x1fff) << 16)));
+	*val++ = reg;
+
+	*val++ = ((info->boundary_y & 0xff) << 16) |
+		 ((info->boundary_u & 0xff) << 8) | (info->boundary_v & 0xff);
+	*val++ = info->scale_factor;
+	*val++ = (info->roi_x & 0x1fff) | ((info->roi_y & 0x1fff) << 16);
+}
+
+void dwe_write_image(struct dwe_ic_dev *dev, const struct dwe_reg_image *img)
+{
+	int i;
+
+	for (i = 0; i < DWE_REG_IMAGE_NUM; i++)
+		dwe_write_reg(dev, dwe_image_regs[i], img->val[i]);
+}
+
+int dwe_s_params(struct dwe_ic_dev *dev, struct dwe_hw_info *info)
+{
+	struct dwe_reg_image img;
+
+	pr_debug("enter %s\n", __func__);
+
+	dwe_compile_params(info, &img);
+	dwe_write_image(dev, &img);
 	return 0;
 }
 
+#ifdef __KERNEL__
+/*
+ * Store the params of one stream config and recompile its register
+ * image. If that image is the one programmed, it has to be written again.
+ */
+void dwe_update_params(struct dwe_ic_dev *dev, int index, int which,
+		struct dwe_hw_info *info)
+{
+	struct dwe_reg_image image;
+	unsigned long flags;
+
+	dwe_compile_params(info, &image);
+	spin_lock_irqsave(&dev->irqlock, flags);
+	dev->info[index][which] = *info;
+	dev->image[index][which] = image;
+	if (dev->hw_tag == DWE_HW_TAG(index, which))
+		dev->hw_tag = DWE_HW_TAG_NONE;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+}
+#endif
+
 int dwe_enable_bus(struct dwe_ic_dev *dev, bool enable)
 {
 	u32 reg = dwe_read_reg(dev, BUS_CTRL);
@@ -204,11 +249,13 @@ int dwe_start_dma_read(struct dwe_ic_dev *dev,
 	return 0;
 }
 
-int dwe_set_buffer(struct dwe_ic_dev *dev, struct dwe_hw_info *info, u64 addr)
+int dwe_set_buffer(struct dwe_ic_dev *dev, struct dwe_hw_info *info,
+		u64 addr, u64 addr_uv)
 {
 	u32 reg_dst_y_base = (u32) addr;
 	u32 reg_y_rbuff_size = ALIGN_UP(info->dst_stride * info->dst_h, 16);
-	u32 reg_dst_uv_base = reg_dst_y_base + reg_y_rbuff_size;
+	u32 reg_dst_uv_base = addr_uv ? (u32) addr_uv :
+			reg_dst_y_base + reg_y_rbuff_size;
 
 	dwe_write_reg(dev, DST_IMG_Y_BASE, (reg_dst_y_base) >> 4);
 	dwe_write_reg(dev, DST_IMG_UV_BASE, (reg_dst_uv_base) >> 4);
@@ -238,11 +285,26 @@ long dwe_priv_ioctl(struct dwe_ic_dev *dev, unsigned int cmd, void *args)
 	case DWEIOC_RESET:
 		ret = dwe_reset(dev);
 		break;
-	case DWEIOC_S_PARAMS:
+	case DWEIOC_S_PARAMS: {
+#ifdef __KERNEL__
+		struct dwe_hw_info info;
+		unsigned long flags;
+
+		viv_check_retval(copy_from_user(&info, args, sizeof(info)));
+		dwe_update_params(dev, 0, 0, &info);
+		/* programmed right away, so the hardware now holds image[0][0] */
+		spin_lock_irqsave(&dev->irqlock, flags);
+		dwe_write_image(dev, &dev->image[0][0]);
+		dev->hw_tag = DWE_HW_TAG(0, 0);
+		spin_unlock_irqrestore(&dev->irqlock, flags);
+		ret = 0;
+#else
 		viv_check_retval(copy_from_user
 				 (&dev->info[0][0], args, sizeof(dev->info[0][0])));
 		ret = dwe_s_params(dev, &dev->info[0][0]);
+#endif
 		break;
+	}
 	case DWEIOC_READ_IRQ: {
 		u32 irq = 0;
 		viv_check_retval(copy_to_user(args, &irq, sizeof(irq)));
@@ -250,14 +312,6 @@ long dwe_priv_ioctl(struct dwe_ic_dev *dev, unsigned int cmd, void *args)
 	}
 	case DWEIOC_START:
 		ret = dwe_start(dev);
-#ifdef ENABLE_LATENCY_STATISTIC
-		dev->frame_id_latency = 0;
-		dev->frame_out_timestamp = 0;
-		dev->interleave_frames = 0;
-		memset(dev->dwe_in_timestamp, 0, sizeof(dev->dwe_in_timestamp));
-		memset(dev->dwe_out_timestamp, 0,
-				sizeof(dev->dwe_out_timestamp));
-#endif
 		break;
 	case DWEIOC_STOP:
 		ret = dwe_stop(dev);
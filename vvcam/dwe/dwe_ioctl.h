@@ -68,6 +68,7 @@ enum {
 	DWEIOC_SET_BUFFER,
 	DWEIOC_SET_LUT,
 	DWEIOC_GET_LUT_STATUS,
+	DWEIOC_GEN_LUT,
 };
 
 struct lut_info {
@@ -75,22 +76,68 @@ struct lut_info {
 	u64 addr;
 };
 
+enum dwe_lens_model {
+	DWE_LENS_RECTILINEAR = 0,
+	DWE_LENS_EQUIDISTANT,		/* r = f * theta */
+	DWE_LENS_EQUISOLID,		/* r = 2f * sin(theta / 2) */
+	DWE_LENS_STEREOGRAPHIC,		/* r = 2f * tan(theta / 2) */
+	DWE_LENS_ORTHOGRAPHIC,		/* r = f * sin(theta) */
+	DWE_LENS_MODEL_NUM,
+};
+
+/* lens and virtual view a dewarp map is generated from, the cache key */
+struct dwe_lens_view {
+	u32 model;
+	u32 src_w, src_h;
+	u32 dst_w, dst_h;
+	u32 cx, cy;		/* optical centre, 16.16 px, 0 for the image centre */
+	u32 focal;		/* lens focal length, 16.16 px */
+	int pan, tilt;		/* view direction, millidegrees */
+	u32 zoom;		/* view over lens focal length, 16.16, 0 for 1.0 */
+};
+
+#define DWE_LUT_ASYNC	(1 << 0)	/* generate in the background */
+#define DWE_LUT_PRELOAD	(1 << 1)	/* fill the cache, keep the current map */
+
+#define DWE_LUT_HIT	(1 << 0)	/* status, the map came from the cache */
+#define DWE_LUT_PENDING	(1 << 1)	/* status, queued for generation */
+
+struct dwe_lut_gen {
+	u32 port;
+	u32 flags;
+	struct dwe_lens_view view;
+	u32 map_w, map_h;	/* returned, for dwe_hw_info */
+	u32 status;		/* returned */
+	u64 addr;		/* returned, 0 while pending */
+};
+
 long dwe_priv_ioctl(struct dwe_ic_dev *dev, unsigned int cmd, void *args);
 
 int dwe_reset(struct dwe_ic_dev *dev);
 int dwe_s_params(struct dwe_ic_dev *dev, struct dwe_hw_info *info);
+void dwe_compile_params(struct dwe_hw_info *info, struct dwe_reg_image *img);
+void dwe_write_image(struct dwe_ic_dev *dev, const struct dwe_reg_image *img);
 int dwe_enable_bus(struct dwe_ic_dev *dev, bool enable);
 int dwe_disable_irq(struct dwe_ic_dev *dev);
 int dwe_clear_irq(struct dwe_ic_dev *dev);
 int dwe_read_irq(struct dwe_ic_dev *dev, u32 *ret);
 int dwe_start_dma_read(struct dwe_ic_dev *dev,
 				struct dwe_hw_info *info, u64 addr);
-int dwe_set_buffer(struct dwe_ic_dev *dev, struct dwe_hw_info *info, u64 addr);
+int dwe_set_buffer(struct dwe_ic_dev *dev, struct dwe_hw_info *info,
+		u64 addr, u64 addr_uv);
 int dwe_set_lut(struct dwe_ic_dev *dev, u64 addr);
 #ifdef __KERNEL__
 irqreturn_t dwe_hw_isr(int irq, void *data);
 void dwe_clear_interrupts(struct dwe_ic_dev *dev);
 void dwe_isr_tasklet(unsigned long arg);
+irqreturn_t dwe_isr_thread(int irq, void *data);
+void dwe_isr_schedule(struct dwe_ic_dev *dev);
 void dwe_clean_src_memory(struct dwe_ic_dev *dev);
+void dwe_release_stream(struct dwe_ic_dev *dev, int index);
+void dwe_update_params(struct dwe_ic_dev *dev, int index, int which,
+		struct dwe_hw_info *info);
+void dwe_sched_init(struct dwe_ic_dev *dev);
+void dwe_sched_push(struct dwe_ic_dev *dev, int index, struct vb2_dc_buf *buf);
+void dwe_sched_flush(struct dwe_ic_dev *dev, int index);
 #endif
 #endif /* _DWE_IOC_H_ */
@@ -51,74 +51,232 @@
  *
  *****************************************************************************/
 
+#include <linux/interrupt.h>
 #include "dwe_driver.h"
 #include "video/vvbuf.h"
 #include "dwe_ioctl.h"
 #include "dwe_regs.h"
+#include "dwe_trace.h"
 
-void dwe_isr_tasklet(unsigned long arg)
+void dwe_sched_init(struct dwe_ic_dev *dev)
 {
-	int which;
-	u32 dewarp_ctrl;
+	int i;
+
+	spin_lock_init(&dev->sched_lock);
+	for (i = 0; i < MAX_DWE_NUM; i++) {
+		INIT_LIST_HEAD(&dev->sq[i].list);
+		dev->sq[i].weight = 1;
+		dev->sq[i].credit = 1;
+	}
+	dev->rr = 0;
+}
+
+void dwe_sched_push(struct dwe_ic_dev *dev, int index, struct vb2_dc_buf *buf)
+{
+	struct dwe_sched_queue *sq = &dev->sq[index];
 	unsigned long flags;
-	unsigned long irq_flags;
-	struct dwe_ic_dev *dev = (struct dwe_ic_dev *)(arg);
-	struct vb2_dc_buf *sink_buf, *sink_next;
 
-	spin_lock_irqsave(&dev->irqlock, flags);
-	dwe_enable_bus(dev, 0);
-	do {
-		dev->src = vvbuf_pull_buf(dev->sink_bctx);
-		if (dev->src == NULL) {
-			dev->hardware_status = HARDWARE_IDLE;
-			spin_unlock_irqrestore(&dev->irqlock, flags);
-			return;
+	buf->queue_ts = ktime_get_ns();
+	spin_lock_irqsave(&dev->sched_lock, flags);
+	list_add_tail(&buf->irqlist, &sq->list);
+	if (++sq->depth > sq->max_depth)
+		sq->max_depth = sq->depth;
+	spin_unlock_irqrestore(&dev->sched_lock, flags);
+}
+
+/* hand back every frame queued on one stream, the queue is detached in O(1) */
+void dwe_sched_flush(struct dwe_ic_dev *dev, int index)
+{
+	struct vb2_dc_buf *buf, *next;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&dev->sched_lock, flags);
+	list_splice_init(&dev->sq[index].list, &list);
+	dev->sq[index].flushed += dev->sq[index].depth;
+	dev->sq[index].depth = 0;
+	spin_unlock_irqrestore(&dev->sched_lock, flags);
+
+	list_for_each_entry_safe(buf, next, &list, irqlist) {
+		list_del(&buf->irqlist);
+		vvbuf_ready(dev->sink_bctx, buf->pad, buf);
+	}
+}
+
+/*
+ * Pick the next source frame. A stream whose oldest frame has waited past
+ * its deadline goes first, otherwise streams take turns of weight frames.
+ */
+static struct vb2_dc_buf *dwe_sched_pull(struct dwe_ic_dev *dev, int *index)
+{
+	struct dwe_sched_queue *sq;
+	struct vb2_dc_buf *buf;
+	unsigned long flags;
+	u64 now, due, best_due = U64_MAX;
+	int i, id, pass, best = -1;
+
+	now = ktime_get_ns();
+	spin_lock_irqsave(&dev->sched_lock, flags);
+	for (i = 0; i < MAX_DWE_NUM; i++) {
+		sq = &dev->sq[i];
+		if (!sq->depth || !sq->deadline_ns)
+			continue;
+		buf = list_first_entry(&sq->list, struct vb2_dc_buf, irqlist);
+		due = buf->queue_ts + sq->deadline_ns;
+		if (due <= now && due < best_due) {
+			best_due = due;
+			best = i;
 		}
+	}
+	if (best >= 0)
+		dev->sq[best].overdue++;
 
-		dev->index = dev->get_index(dev, dev->src);
-		if ( *dev->state[dev->index]  != (STATE_DRIVER_STARTED | STATE_STREAM_STARTED) ) {
-			vvbuf_ready(dev->sink_bctx, dev->src->pad, dev->src);
-			dev->src = NULL;
-			spin_lock_irqsave(&dev->sink_bctx->irqlock, irq_flags);
-			list_for_each_entry_safe(sink_buf, sink_next, &(dev->sink_bctx->dmaqueue), irqlist) {
-				if (dev->get_index(dev, sink_buf) == dev->index) {
-					list_del(&sink_buf->irqlist);
-					vvbuf_ready(dev->sink_bctx, sink_buf->pad, sink_buf);
-				}
+	for (pass = 0; best < 0 && pass < 2; pass++) {
+		for (i = 0; i < MAX_DWE_NUM; i++) {
+			id = (dev->rr + i) % MAX_DWE_NUM;
+			if (dev->sq[id].depth && dev->sq[id].credit) {
+				best = id;
+				break;
 			}
-			spin_unlock_irqrestore(&dev->sink_bctx->irqlock, irq_flags);
+		}
+		if (best < 0)
+			for (i = 0; i < MAX_DWE_NUM; i++)
+				dev->sq[i].credit = dev->sq[i].weight;
+	}
+
+	if (best < 0) {
+		spin_unlock_irqrestore(&dev->sched_lock, flags);
+		return NULL;
+	}
+
+	sq = &dev->sq[best];
+	if (sq->credit)
+		sq->credit--;
+	dev->rr = best;
+	buf = list_first_entry(&sq->list, struct vb2_dc_buf, irqlist);
+	list_del(&buf->irqlist);
+	sq->depth--;
+	vvlat_hist_add(&sq->wait, now - buf->queue_ts);
+	spin_unlock_irqrestore(&dev->sched_lock, flags);
+
+	*index = best;
+	return buf;
+}
+
+/* drop a staged job, the source goes back to its producer */
+static void dwe_release_job(struct dwe_ic_dev *dev, struct dwe_job *job)
+{
+	if (job->src)
+		vvbuf_ready(dev->sink_bctx, job->src->pad, job->src);
+	job->src = NULL;
+	if (job->dst)
+		vvbuf_push_buf(dev->src_bctx[job->index], job->dst);
+	job->dst = NULL;
+}
+
+/* pick the next runnable frame and its output buffer, caller holds irqlock */
+static bool dwe_stage_job(struct dwe_ic_dev *dev, struct dwe_job *job)
+{
+	struct vb2_dc_buf *src;
+	int index;
+
+	while ((src = dwe_sched_pull(dev, &index)) != NULL) {
+		if (*dev->state[index] != (STATE_DRIVER_STARTED | STATE_STREAM_STARTED)) {
+			vvbuf_ready(dev->sink_bctx, src->pad, src);
+			dwe_sched_flush(dev, index);
 			continue;
 		}
-		which = dev->which[dev->index];
-		if (dev->dist_map[dev->index][which] == (dma_addr_t)NULL) {
-			vvbuf_ready(dev->sink_bctx, dev->src->pad, dev->src);
-			dev->src = NULL;
+		if (dev->dist_map[index][dev->which[index]] == (dma_addr_t)NULL) {
+			vvbuf_ready(dev->sink_bctx, src->pad, src);
+			dev->sq[index].drops++;
 			continue;
 		}
-		dev->dst = vvbuf_pull_buf(dev->src_bctx[dev->index]);
-		if (dev->dst == NULL) {
-			vvbuf_ready(dev->sink_bctx, dev->src->pad, dev->src);
-			dev->src = NULL;
+		job->dst = vvbuf_pull_buf(dev->src_bctx[index]);
+		if (job->dst == NULL) {
+			vvbuf_ready(dev->sink_bctx, src->pad, src);
+			dev->sq[index].drops++;
 			continue;
 		}
-	} while (dev->dst == NULL);
+		job->src = src;
+		job->index = index;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Program a staged job and start the engine, caller holds irqlock. The
+ * precompiled geometry image is only written when the core last ran
+ * another stream or config, otherwise just the base addresses change.
+ */
+static bool dwe_run_job(struct dwe_ic_dev *dev, struct dwe_job *job)
+{
+	struct dwe_hw_info *info;
+	dma_addr_t lut;
+	u32 dewarp_ctrl;
+	int which;
+
+	which = dev->which[job->index];
+	lut = dev->dist_map[job->index][which];
+	if (*dev->state[job->index] != (STATE_DRIVER_STARTED | STATE_STREAM_STARTED) ||
+	    lut == (dma_addr_t)NULL) {
+		/* the stream stopped while the job was staged */
+		dwe_release_job(dev, job);
+		return false;
+	}
+
+	info = &dev->info[job->index][which];
+	dev->index = job->index;
+	dev->src = job->src;
+	dev->dst = job->dst;
+	job->src = NULL;
+	job->dst = NULL;
 
+	dev->sq[dev->index].jobs++;
 	dev->dst->timestamp = dev->src->timestamp;
-	dwe_s_params(dev, &dev->info[dev->index][which]);
-	dwe_set_buffer(dev, &dev->info[dev->index][which], dev->dst->dma);
-	dwe_set_lut(dev, dev->dist_map[dev->index][which]);
-	dwe_start_dma_read(dev, &dev->info[dev->index][which], dev->src->dma);
+	dev->dst->frame_id = dev->src->frame_id;
+	trace_dwe_start(dev->index, dev->src->dma, dev->dst->dma);
+	dwe_enable_bus(dev, 0);
+	if (dev->hw_tag != DWE_HW_TAG(job->index, which)) {
+		dwe_write_image(dev, &dev->image[job->index][which]);
+		dev->hw_tag = DWE_HW_TAG(job->index, which);
+		dev->prog_full++;
+	} else {
+		dev->prog_partial++;
+	}
+	dwe_set_buffer(dev, info, dev->dst->dma, dev->dst->dma_cb);
+	dwe_set_lut(dev, lut);
+	dwe_start_dma_read(dev, info, dev->src->dma);
 	dewarp_ctrl = dwe_read_reg(dev, DEWARP_CTRL);
 	dwe_write_reg(dev, DEWARP_CTRL, dewarp_ctrl | 2);
 	dwe_write_reg(dev, DEWARP_CTRL, dewarp_ctrl);
 	dwe_write_reg(dev, INTERRUPT_STATUS, INT_MSK_STATUS_MASK);
 	dwe_enable_bus(dev, 1);
-	dev->curmap[dev->index][which] = dev->dist_map[dev->index][which];
+	dev->curmap[dev->index][which] = lut;
+	return true;
+}
+
+/*
+ * Keep one job staged behind the running one so frame done can start it
+ * straight from the irq, and start the engine here when it is idle.
+ */
+void dwe_isr_tasklet(unsigned long arg)
+{
+	unsigned long flags;
+	struct dwe_ic_dev *dev = (struct dwe_ic_dev *)(arg);
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	while (!dev->src) {
+		if (!dev->next.src && !dwe_stage_job(dev, &dev->next))
+			break;
+		if (dwe_run_job(dev, &dev->next))
+			dev->kick_tasklet++;
+	}
+	if (!dev->next.src)
+		dwe_stage_job(dev, &dev->next);
+	if (!dev->src && !dev->next.src)
+		dev->hardware_status = HARDWARE_IDLE;
 	spin_unlock_irqrestore(&dev->irqlock, flags);
-#ifdef ENABLE_LATENCY_STATISTIC
-	dev->dwe_frame_cnt++;
-	dev->frame_in_timestamp = ktime_get_ns();
-#endif
 }
 
 void dwe_clear_interrupts(struct dwe_ic_dev *dev)
@@ -130,81 +288,20 @@ void dwe_clear_interrupts(struct dwe_ic_dev *dev)
 	dwe_write_reg(dev, INTERRUPT_STATUS, clr);
 }
 
-#ifdef ENABLE_LATENCY_STATISTIC
-void dwe_latency_statistic(struct dwe_ic_dev *dev)
+irqreturn_t dwe_isr_thread(int irq, void *data)
 {
-	int i = 0;
-	uint64_t average_latency_ns = 0;
-
-	if (dev->dwe_frame_cnt < LATENCY_START_STATISTIC)
-		return;
-
-	if (dev->interleave_frames > 0 &&
-		dev->interleave_frames <= LATENCY_INTERLEVE_FRAME) {
-		dev->interleave_frames++;
-		return;
-	}
-
-	dev->interleave_frames = 0;
-	dev->dwe_in_timestamp[dev->frame_id_latency]  = dev->frame_in_timestamp;
-	dev->dwe_out_timestamp[dev->frame_id_latency] = dev->frame_out_timestamp;
-	if (dev->frame_id_latency == (LATENCY_FRAME_NUM - 1)) {
-		pr_info("dwe[%d] dwe_in_timestamp(ns) [%lld~%lld]:\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n",
-			dev->index, dev->dwe_frame_cnt - LATENCY_FRAME_NUM + 1,
-			dev->dwe_frame_cnt,
-			dev->dwe_in_timestamp[0], dev->dwe_in_timestamp[1],
-			dev->dwe_in_timestamp[2], dev->dwe_in_timestamp[3],
-			dev->dwe_in_timestamp[4], dev->dwe_in_timestamp[5],
-			dev->dwe_in_timestamp[6], dev->dwe_in_timestamp[7],
-			dev->dwe_in_timestamp[8], dev->dwe_in_timestamp[9],
-			dev->dwe_in_timestamp[10], dev->dwe_in_timestamp[11],
-			dev->dwe_in_timestamp[12], dev->dwe_in_timestamp[13],
-			dev->dwe_in_timestamp[14], dev->dwe_in_timestamp[15],
-			dev->dwe_in_timestamp[16], dev->dwe_in_timestamp[17],
-			dev->dwe_in_timestamp[18], dev->dwe_in_timestamp[19],
-			dev->dwe_in_timestamp[20], dev->dwe_in_timestamp[21],
-			dev->dwe_in_timestamp[22], dev->dwe_in_timestamp[23]
-		);
-
-		pr_info("dwe[%d] dwe_out_timestamp(ns) [%lld~%lld]:\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n",
-			dev->index, dev->dwe_frame_cnt - LATENCY_FRAME_NUM + 1,
-			dev->dwe_frame_cnt,
-			dev->dwe_out_timestamp[0], dev->dwe_out_timestamp[1],
-			dev->dwe_out_timestamp[2], dev->dwe_out_timestamp[3],
-			dev->dwe_out_timestamp[4], dev->dwe_out_timestamp[5],
-			dev->dwe_out_timestamp[6], dev->dwe_out_timestamp[7],
-			dev->dwe_out_timestamp[8], dev->dwe_out_timestamp[9],
-			dev->dwe_out_timestamp[10], dev->dwe_out_timestamp[11],
-			dev->dwe_out_timestamp[12], dev->dwe_out_timestamp[13],
-			dev->dwe_out_timestamp[14], dev->dwe_out_timestamp[15],
-			dev->dwe_out_timestamp[16], dev->dwe_out_timestamp[17],
-			dev->dwe_out_timestamp[18], dev->dwe_out_timestamp[19],
-			dev->dwe_out_timestamp[20], dev->dwe_out_timestamp[21],
-			dev->dwe_out_timestamp[22], dev->dwe_out_timestamp[23]
-		);
-
-		pr_info("dwe[%d] average latency(ns) [%lld~%lld]:\n",
-			dev->index, dev->dwe_frame_cnt - LATENCY_FRAME_NUM + 1,
-			dev->dwe_frame_cnt);
-		for (i = 0; i < LATENCY_FRAME_NUM; i++) {
-			average_latency_ns +=
-				(dev->dwe_out_timestamp[i] - dev->dwe_in_timestamp[i]);
-		}
-		pr_info("%lld\n", average_latency_ns / LATENCY_FRAME_NUM);
+	dwe_isr_tasklet((unsigned long)data);
+	return IRQ_HANDLED;
+}
 
-		dev->frame_id_latency = 0;
-		dev->interleave_frames++;
-	} else if (dev->frame_id_latency < (LATENCY_FRAME_NUM - 1)) {
-		dev->frame_id_latency++;
-	}
+/* run the next job from the irq thread when one was requested */
+void dwe_isr_schedule(struct dwe_ic_dev *dev)
+{
+	if (dev->irq_thread)
+		irq_wake_thread(dev->irq, dev);
+	else
+		tasklet_schedule(&dev->tasklet);
 }
-#endif
 
 irqreturn_t dwe_hw_isr(int irq, void *data)
 {
@@ -212,6 +309,7 @@ irqreturn_t dwe_hw_isr(int irq, void *data)
 	u32 status;
 	u32 clr;
 	unsigned long flags;
+	u64 now, latency;
 	int dwe_status_active = (STATE_DRIVER_STARTED | STATE_STREAM_STARTED);
 
 	if (!dev)
@@ -224,11 +322,15 @@ irqreturn_t dwe_hw_isr(int irq, void *data)
 	if ((dev->state[0] && (*dev->state[0] == dwe_status_active)) ||
 	    (dev->state[1] && (*dev->state[1] == dwe_status_active))) {
 		if (status & INT_FRAME_DONE) {
-#ifdef ENABLE_LATENCY_STATISTIC
-			dev->frame_out_timestamp = ktime_get_ns();
-			dwe_latency_statistic(dev);
-#endif
+			now = ktime_get_ns();
 			spin_lock_irqsave(&dev->irqlock, flags);
+			if (dev->src && dev->dst && dev->src->done_ts) {
+				/* isp frame end to dwe frame done */
+				latency = now - dev->src->done_ts;
+				vvlat_hist_add(&dev->lat[dev->index], latency);
+				trace_dwe_done(dev->index, status, latency);
+				dev->dst->done_ts = now;
+			}
 			if (dev->src) {
 				vvbuf_ready(dev->sink_bctx, dev->src->pad, dev->src);
 				dev->src = NULL;
@@ -237,8 +339,11 @@ irqreturn_t dwe_hw_isr(int irq, void *data)
 				vvbuf_ready(dev->src_bctx[dev->index], dev->dst->pad, dev->dst);
 				dev->dst = NULL;
 			}
+			if (dev->next.src && dwe_run_job(dev, &dev->next))
+				dev->kick_irq++;
 			spin_unlock_irqrestore(&dev->irqlock, flags);
-			tasklet_schedule(&dev->tasklet);
+			/* stage the job after this one, or start one if none was ready */
+			dwe_isr_schedule(dev);
 		} else {
 			spin_lock_irqsave(&dev->irqlock, flags);
 			if (dev->src) {
@@ -249,35 +354,50 @@ irqreturn_t dwe_hw_isr(int irq, void *data)
 				vvbuf_push_buf(dev->src_bctx[dev->index], dev->dst);
 				dev->dst = NULL;
 			}
+			/* nothing runs a staged job once the core is idle */
+			dwe_release_job(dev, &dev->next);
 			dwe_enable_bus(dev, 0);
 			dev->hardware_status = HARDWARE_IDLE;
 			spin_unlock_irqrestore(&dev->irqlock, flags);
 		}
 	}
 	else {
+		spin_lock_irqsave(&dev->irqlock, flags);
+		dwe_release_job(dev, &dev->next);
 		dev->hardware_status = HARDWARE_IDLE;
+		spin_unlock_irqrestore(&dev->irqlock, flags);
 	}
 
 	return IRQ_HANDLED;
 }
 
+/* a stream is stopping, give back the job staged for it */
+void dwe_release_stream(struct dwe_ic_dev *dev, int index)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	if (dev->next.src && dev->next.index == index)
+		dwe_release_job(dev, &dev->next);
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+}
+
 void dwe_clean_src_memory(struct dwe_ic_dev *dev)
 {
 	unsigned long flags;
-	struct vb2_dc_buf *buf;
+	int i;
 
 	spin_lock_irqsave(&dev->irqlock, flags);
-	do {
-		buf = vvbuf_pull_buf(dev->sink_bctx);
-		if (buf)
-			vvbuf_ready(dev->sink_bctx, buf->pad, buf);
-	} while(buf);
+	for (i = 0; i < MAX_DWE_NUM; i++)
+		dwe_sched_flush(dev, i);
 
 	if (dev->src) {
 		vvbuf_ready(dev->sink_bctx, dev->src->pad, dev->src);
 		dev->src = NULL;
 	}
 	dev->dst = NULL;
+	dwe_release_job(dev, &dev->next);
+	dev->hw_tag = DWE_HW_TAG_NONE;
 	spin_unlock_irqrestore(&dev->irqlock, flags);
 }
 
@@ -55,6 +55,11 @@
 
 #include "isp_version.h"
 #include "vvdefs.h"
+#ifdef __KERNEL__
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include "video/vvlat.h"
+#endif
 
 #define REG_ADDR(x)  ((uint32_t)(uintptr_t)&all_regs->x)
 
@@ -493,6 +498,47 @@ struct isp_vsm_context {
 	u32 h_seg, v_seg;
 };
 
+#define ISP_STATS_RING_NUM		(8)
+#define ISP_STATS_EXP_MEAN_NUM	(25)
+#define ISP_STATS_HIST_BIN_NUM	(256)
+
+enum {
+	ISP_STATS_EXP_VALID  = 1 << 0,
+	ISP_STATS_HIST_VALID = 1 << 1,
+	ISP_STATS_AWB_VALID  = 1 << 2,
+	ISP_STATS_AFM_VALID  = 1 << 3,
+	ISP_STATS_VSM_VALID  = 1 << 4,
+	ISP_STATS_3DNR_VALID = 1 << 5,
+};
+
+/*
+ * One slot of the 3A statistics ring. The isr makes seq odd while it
+ * updates the slot and even again when done, so a reader copies the
+ * slot and retries if seq was odd or changed during the copy.
+ */
+struct isp_stats_frame {
+	u32 seq;
+	u32 valid;		/* ISP_STATS_*_VALID */
+	u64 frame_id;	/* frame_in_cnt of the measured frame */
+	u64 timestamp;	/* frame in timestamp (ns) */
+	u8 exp_mean[ISP_STATS_EXP_MEAN_NUM];
+	u8 reserved[3];
+	u32 hist[ISP_STATS_HIST_BIN_NUM];
+	struct isp_awb_mean awb;
+	struct isp_afm_result afm;
+	struct isp_vsm_result vsm;
+	u32 dnr3_avg;
+	u32 reserved2;
+};
+
+/* mapped by userspace, see ISPIOC_G_STATS_BUF */
+struct isp_stats_ring {
+	u32 num;		/* ISP_STATS_RING_NUM */
+	u32 head;		/* slot of the latest finished frame */
+	u64 frame_id;	/* frame_id of the head slot */
+	struct isp_stats_frame frame[ISP_STATS_RING_NUM];
+};
+
 #ifndef WDR3_BIN
 #define WDR3_BIN 14
 #endif
@@ -710,6 +756,198 @@ typedef struct isp_wdr_context
 	u8		dY[33];
 } isp_wdr_context_t;
 
+enum {
+	ISP_LUT_LSC = 0,
+	ISP_LUT_GAMMA_OUT,
+	ISP_LUT_GCMONO,
+	ISP_LUT_RGBGAMMA,
+	ISP_LUT_WDR,
+	ISP_LUT_MAX,
+};
+
+#define ISP_PARAMS_VERSION		(1)
+#define ISP_PARAMS_MAX_SIZE		(64 * 1024)
+
+enum {
+	ISP_PARAMS_BLOCK_DGAIN = 0,
+	ISP_PARAMS_BLOCK_BLS,
+	ISP_PARAMS_BLOCK_AWB,
+	ISP_PARAMS_BLOCK_CC,
+	ISP_PARAMS_BLOCK_EE,
+	ISP_PARAMS_BLOCK_EXP,
+	ISP_PARAMS_BLOCK_HIST,
+	ISP_PARAMS_BLOCK_AFM,
+	ISP_PARAMS_BLOCK_VSM,
+	ISP_PARAMS_BLOCK_FLT,
+	ISP_PARAMS_BLOCK_CNR,
+	ISP_PARAMS_BLOCK_CPROC,
+	ISP_PARAMS_BLOCK_DPF,
+	ISP_PARAMS_BLOCK_DPCC,
+	ISP_PARAMS_BLOCK_DMSC,
+	ISP_PARAMS_BLOCK_GAMMA_OUT,
+	ISP_PARAMS_BLOCK_MAX,
+};
+
+/*
+ * ISPIOC_S_PARAMS takes a struct isp_params_buffer followed by data_size
+ * bytes of blocks. Each block is a struct isp_params_block_header and the
+ * matching isp_*_context, padded to 8 bytes.
+ */
+struct isp_params_block_header {
+	u16 type;		/* ISP_PARAMS_BLOCK_* */
+	u16 reserved;
+	u32 size;		/* size of the context following the header */
+};
+
+struct isp_params_buffer {
+	u32 version;	/* ISP_PARAMS_VERSION */
+	u32 data_size;
+};
+
+/*
+ * ISPIOC_S_LSC_TBL_ASYNC returns a fence in seq. When the table takes
+ * effect an isp irq event is posted with addr ISP_IRQ_DATA_LSC_DONE, val
+ * the fence and nop[0] the input frame count. ISPIOC_G_LSC_SEQ reads the
+ * last fence in effect.
+ */
+#define ISP_IRQ_DATA_LSC_DONE	(1)
+
+struct isp_lsc_submit {
+	struct isp_lsc_context lsc;
+	u32 seq;
+};
+
+/*
+ * ISPIOC_S_RECONFIG switches the input window, hdr stitching and mi paths
+ * of a running stream at the next frame end, the buffers already queued
+ * must be large enough for the new mode. The frame straddling the switch
+ * and drop_frames frames after it go back to the queue without being
+ * returned. seq returns a fence, posted with addr ISP_IRQ_DATA_RECONFIG_DONE
+ * once the new setup is in effect.
+ */
+#define ISP_IRQ_DATA_RECONFIG_DONE	(2)
+#define ISP_RECONFIG_MAX_DROP		(8)
+
+struct isp_reconfig_context {
+	struct isp_context ctx;
+	struct isp_hdr_context hdr;
+	struct isp_mi_context mi;
+	u32 drop_frames;
+	u32 seq;
+};
+
+/*
+ * ISPIOC_QUEUE_AE queues sensor exposure/gain (VVSENSOR_BATCH_* bits in
+ * sensor_valid) together with the isp gains that go with them. The sensor
+ * part is written from the frame in irq once frame_id is reached, the isp
+ * part at the frame end before the sensor settings take effect, so both
+ * land on the same frame. Then an isp irq event is posted with addr
+ * ISP_IRQ_DATA_AE_DONE, val the fence returned in seq and nop[0] the
+ * frame the entry took effect on.
+ */
+#define ISP_IRQ_DATA_AE_DONE	(3)
+#define ISP_AE_QUEUE_LEN		(8)
+
+#define ISP_AE_DGAIN		(1 << 0)
+#define ISP_AE_HDR_WB		(1 << 1)
+
+struct isp_ae_entry {
+	u32 frame_id;	/* frame in count to start at, 0 for the next frame */
+	u32 sensor_valid;
+	u32 long_exp;
+	u32 exp;
+	u32 vs_exp;
+	u32 long_gain;
+	u32 gain;
+	u32 vs_gain;
+	u32 vts;
+	u32 isp_valid;	/* ISP_AE_* */
+	struct isp_digital_gain_cxt dgain;
+	u32 r, gr, gb, b;	/* hdr stitching wb */
+	u32 seq;
+};
+
+#if defined(__KERNEL__)
+/* blocks waiting for the next frame end, protected by irqlock */
+struct isp_params_stage {
+	u32 pending;	/* bitmask of ISP_PARAMS_BLOCK_* */
+	struct isp_digital_gain_cxt dgain;
+	struct isp_bls_context bls;
+	struct isp_awb_context awb;
+	struct isp_cc_context cc;
+	struct isp_ee_context ee;
+	struct isp_exp_context exp;
+	struct isp_hist_context hist;
+	struct isp_afm_context afm;
+	struct isp_vsm_context vsm;
+	struct isp_flt_context flt;
+	struct isp_cnr_context cnr;
+	struct isp_cproc_context cproc;
+	struct isp_dpf_context dpf;
+	struct isp_dpcc_context dpcc;
+	struct isp_dmsc_context demosaic;
+	struct isp_gamma_out_context gamma_out;
+};
+
+/*
+ * ISPIOC_S_LSC_TBL_ASYNC state. The work item loads the latest submitted
+ * table into the bank the isp is not using, the frame end irq flips
+ * isp_lsc_table_sel to it. A table that cannot be loaded while the isp
+ * is off waits in defer until isp_s_lsc_tbl() writes it. Everything but
+ * work and lock is protected by irqlock, lock serialises the uploads,
+ * ISPIOC_S_LSC_TBL included.
+ */
+struct isp_lsc_async {
+	struct work_struct work;
+	struct mutex lock;
+	struct isp_lsc_context next;
+	u32 seq;		/* last submitted */
+	u32 load_seq;	/* picked up by the work item */
+	u32 flip_seq;	/* sitting in the inactive bank */
+	u32 done_seq;	/* in effect */
+	u32 defer_seq;	/* waiting for the isp to be enabled */
+	u32 sel;
+	bool flip;
+	bool defer;
+};
+
+/* ISPIOC_S_RECONFIG state, protected by irqlock */
+struct isp_reconfig_stage {
+	struct isp_reconfig_context next;
+	bool pending;
+	u32 seq;		/* last submitted */
+	u32 done_seq;	/* in effect */
+	u32 drop;		/* frames still to recycle */
+	u32 cnt;
+	u64 drop_cnt;
+};
+
+/*
+ * ISPIOC_QUEUE_AE state. Entries wait in queue until their frame, the
+ * work item writes cur to the sensor and moves the isp half to pend with
+ * the frame it has to be latched at. All but work are protected by
+ * irqlock.
+ */
+struct isp_ae_queue {
+	struct work_struct work;
+	struct isp_ae_entry queue[ISP_AE_QUEUE_LEN];
+	u32 head, tail;
+	struct isp_ae_entry cur;
+	u64 cur_frame;	/* frame the sensor write was started in */
+	bool busy;
+	bool stop;		/* isp_ae_flush() is cancelling the work */
+	struct isp_ae_entry pend[ISP_AE_QUEUE_LEN];
+	u64 pend_frame[ISP_AE_QUEUE_LEN];
+	u32 pend_head, pend_tail;
+	u32 seq;
+	u32 done_seq;
+	u64 done_frame;
+	u64 applied_cnt;
+	u64 late_cnt;	/* sensor write crossed a frame start */
+	u64 err_cnt;
+};
+#endif
+
 struct isp_ic_dev {
 	void __iomem *base;
 	void __iomem *reset;
@@ -722,32 +960,60 @@ struct isp_ic_dev {
 	struct vvbuf_ctx *bctx;
 	struct vb2_dc_buf *mi_buf[MI_PATH_NUM];
 	struct vb2_dc_buf *mi_buf_shd[MI_PATH_NUM];
+	struct list_head mi_drop_list[MI_PATH_NUM];	/* reused before the queue */
+	u32 mi_stride[MI_PATH_NUM];	/* line length programmed, 0 if packed */
 	int (*alloc)(struct isp_ic_dev *dev, struct isp_buffer_context *buf);
 	int (*free)(struct isp_ic_dev *dev, struct vb2_dc_buf *buf);
 	int *state;
 	struct tasklet_struct tasklet;
 	spinlock_t lock;
+	int irq;
+	bool irq_thread;
 #endif
 
 #ifdef __KERNEL__
 	spinlock_t irqlock;
 	uint64_t last_ns[MI_PATH_NUM];
 	uint64_t frame_loss_cnt[MI_PATH_NUM];
+	uint64_t mi_late_cnt[MI_PATH_NUM];
+	uint64_t mi_sched_frame;
+	uint64_t mp_end_frame;	/* frame_in_cnt at the last main path frame end */
+	bool mi_irq_program;
 	uint32_t frame_cnt[MI_PATH_NUM];
 	uint32_t fps[MI_PATH_NUM];
 	uint64_t frame_in_cnt;
 	uint64_t frame_in_timestamp;
-#ifdef ENABLE_LATENCY_STATISTIC
-	uint64_t frame_id_latency;
-	uint64_t frame_out_timestamp;
-	uint64_t latency_stat_frame;
-	uint32_t interleave_frames;
-	uint64_t isp_in_timestamp[LATENCY_FRAME_NUM];
-	uint64_t isp_out_timestamp[LATENCY_FRAME_NUM];
-#endif
+	struct vvlat_hist out_lat[MI_PATH_NUM];
+	u32 lut_us[ISP_LUT_MAX];
+	u32 lut_max_us[ISP_LUT_MAX];
+	struct isp_stats_ring *stats;
+	phys_addr_t stats_pa;
+	u32 stats_size;
+	u32 stats_slot;
+	u32 stats_hist_slot;
+	struct isp_params_stage params;
+	struct isp_lsc_async lsc_async;
+	u32 lut_bench_loops;
+	u32 lut_bench_us[ISP_LUT_MAX];		/* average, 0 if not timed */
+	u32 lut_bench_max_us[ISP_LUT_MAX];
+	struct isp_reconfig_stage reconfig;
+	struct isp_ae_queue ae;
+	u32 *shadow;	/* write-through copy of the register space */
+	unsigned long *shadow_map;
+	unsigned long *shadow_valid;
+	u32 replay_us;
+	u32 replay_cnt;
+	u64 resume_ns;
+	u32 resume_frame_us;
 #endif
 
 	void (*post_event)(struct isp_ic_dev *dev, void *data, size_t size);
+#ifdef __KERNEL__
+	void (*stats_done)(struct isp_ic_dev *dev, struct isp_stats_frame *frame);
+	void (*rdma_done)(struct isp_ic_dev *dev, u64 frame_id);
+	int (*sensor_batch)(struct isp_ic_dev *dev,
+			const struct isp_ae_entry *entry, u32 *delay_frm);
+#endif
 
 	struct isp_context ctx;
 	struct isp_digital_gain_cxt dgain;
@@ -803,5 +1069,10 @@ struct isp_extmem_info {
 
 void isp_write_reg(struct isp_ic_dev *dev, u32 offset, u32 val);
 u32 isp_read_reg(struct isp_ic_dev *dev, u32 offset);
+void isp_write_reg_burst(struct isp_ic_dev *dev, u32 offset,
+			const u32 *vals, u32 n);
+void isp_write_reg_fifo(struct isp_ic_dev *dev, u32 offset,
+			const u32 *vals, u32 n);
+void isp_lut_time(struct isp_ic_dev *dev, int lut, u64 start_ns);
 
 #endif /* _ISP_DEV_H_ */
@@ -0,0 +1,224 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/uaccess.h>
+#include "mrv_all_bits.h"
+#include "isp_ioctl.h"
+#include "isp_types.h"
+
+/* the sensor write for the head entry, outside irqlock since it sleeps */
+static void isp_ae_work(struct work_struct *work)
+{
+	struct isp_ae_queue *ae = container_of(work, struct isp_ae_queue, work);
+	struct isp_ic_dev *dev = container_of(ae, struct isp_ic_dev, ae);
+	unsigned long flags;
+	u32 delay_frm = 1;
+	int ret = 0;
+
+	if (ae->cur.sensor_valid) {
+		ret = dev->sensor_batch ?
+			dev->sensor_batch(dev, &ae->cur, &delay_frm) : -ENODEV;
+	}
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	if (ret) {
+		ae->err_cnt++;
+		delay_frm = 1;
+	}
+	/* a frame started meanwhile, the sensor latches one frame later */
+	if (dev->frame_in_cnt != ae->cur_frame) {
+		ae->late_cnt++;
+		ae->cur_frame = dev->frame_in_cnt;
+	}
+	if (ae->pend_head - ae->pend_tail < ISP_AE_QUEUE_LEN) {
+		ae->pend[ae->pend_head % ISP_AE_QUEUE_LEN] = ae->cur;
+		ae->pend_frame[ae->pend_head % ISP_AE_QUEUE_LEN] =
+				ae->cur_frame + max_t(u32, delay_frm, 1) - 1;
+		ae->pend_head++;
+	} else {
+		/* the isp half is lost, count it like a failed sensor write */
+		ae->err_cnt++;
+	}
+	ae->busy = false;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+}
+
+void isp_ae_init(struct isp_ic_dev *dev)
+{
+	INIT_WORK(&dev->ae.work, isp_ae_work);
+}
+
+int isp_queue_ae(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_ae_queue *ae = &dev->ae;
+	struct isp_ae_entry entry;
+	unsigned long flags;
+	int ret = 0;
+
+	viv_check_retval(copy_from_user(&entry, args, sizeof(entry)));
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	if (ae->head - ae->tail >= ISP_AE_QUEUE_LEN) {
+		ret = -EBUSY;
+	} else {
+		entry.seq = ++ae->seq;
+		ae->queue[ae->head % ISP_AE_QUEUE_LEN] = entry;
+		ae->head++;
+	}
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+	if (ret)
+		return ret;
+
+	viv_check_retval(copy_to_user((u8 *)args +
+			offsetof(struct isp_ae_entry, seq), &entry.seq,
+			sizeof(entry.seq)));
+	return 0;
+}
+
+/* called from the frame in irq, starts the sensor write of a due entry */
+void isp_ae_frame_in(struct isp_ic_dev *dev)
+{
+	struct isp_ae_queue *ae = &dev->ae;
+	struct isp_ae_entry *entry;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	if (ae->stop || ae->busy || ae->head == ae->tail)
+		goto end;
+	entry = &ae->queue[ae->tail % ISP_AE_QUEUE_LEN];
+	if (entry->frame_id && entry->frame_id > (u32)dev->frame_in_cnt)
+		goto end;
+
+	ae->cur = *entry;
+	ae->tail++;
+	ae->cur_frame = dev->frame_in_cnt;
+	ae->busy = true;
+	queue_work(system_highpri_wq, &ae->work);
+end:
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+}
+
+/*
+ * Called with irqlock held at frame end. Everything written here latches
+ * for the next frame, the one the sensor half of the entry lands on.
+ */
+bool isp_ae_apply(struct isp_ic_dev *dev)
+{
+	struct isp_ae_queue *ae = &dev->ae;
+	struct isp_ae_entry *entry;
+	bool done = false;
+
+	while (ae->pend_head != ae->pend_tail &&
+	       ae->pend_frame[ae->pend_tail % ISP_AE_QUEUE_LEN] <=
+			dev->frame_in_cnt) {
+		entry = &ae->pend[ae->pend_tail % ISP_AE_QUEUE_LEN];
+		if (entry->isp_valid & ISP_AE_DGAIN) {
+			dev->dgain = entry->dgain;
+			isp_s_digital_gain(dev);
+		}
+		if (entry->isp_valid & ISP_AE_HDR_WB) {
+			dev->hdr.r = entry->r;
+			dev->hdr.gr = entry->gr;
+			dev->hdr.gb = entry->gb;
+			dev->hdr.b = entry->b;
+			isp_s_hdr_wb(dev);
+		}
+		ae->done_seq = entry->seq;
+		ae->done_frame = dev->frame_in_cnt + 1;
+		ae->applied_cnt++;
+		ae->pend_tail++;
+		done = true;
+	}
+	return done;
+}
+
+void isp_ae_post_done(struct isp_ic_dev *dev)
+{
+	struct isp_irq_data irq_data;
+
+	if (!dev->post_event)
+		return;
+
+	memset(&irq_data, 0, sizeof(irq_data));
+	irq_data.addr = ISP_IRQ_DATA_AE_DONE;
+	irq_data.val = READ_ONCE(dev->ae.done_seq);
+	irq_data.nop[0] = (uint32_t)READ_ONCE(dev->ae.done_frame);
+	dev->post_event(dev, &irq_data, sizeof(irq_data));
+}
+
+/*
+ * Drops whatever is queued, the stream is going away. stop keeps the
+ * frame in irq from starting another sensor write while the running one
+ * is cancelled.
+ */
+void isp_ae_flush(struct isp_ic_dev *dev)
+{
+	struct isp_ae_queue *ae = &dev->ae;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	ae->stop = true;
+	ae->tail = ae->head;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	cancel_work_sync(&ae->work);
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	ae->tail = ae->head;
+	ae->pend_tail = ae->pend_head;
+	ae->busy = false;
+	ae->stop = false;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+}
@@ -131,24 +131,16 @@ int isp_s_gcmonoWriteData(struct isp_ic_dev *dev, u32 *tblX, u32 *tblY)
 	pr_err("unsupported function %s", __func__);
 	return -1;
 #else
-	u32 isp_gc_y_data, isp_gc_x_data;
-	u32 *p_table = NULL;
-	int i;
-	u32 gc_px_data = 0;
+	u64 start_ns;
 
 	pr_info("enter %s\n", __func__);
 	isp_write_reg(dev, REG_ADDR(isp_gcmono_y_addr), 0);
 	isp_write_reg(dev, REG_ADDR(isp_gcmono_x_addr), 0);
-	for (i = 0; i < 64; i++) {
-		isp_gc_y_data = *(tblY + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcmono_y_write_data),
-			      isp_gc_y_data);
-	}
-	for (i = 0; i < 63; i++) {
-		isp_gc_x_data = *(tblX + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcmono_x_write_data),
-			      isp_gc_x_data);
-	}
+	start_ns = ktime_get_ns();
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcmono_y_write_data), tblY, 64);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcmono_x_write_data), tblX, 63);
+	isp_lut_time(dev, ISP_LUT_GCMONO, start_ns);
+	return 0;
 #endif
 }
 
@@ -67,7 +67,7 @@ int isp_s_hdr(struct isp_ic_dev *dev)
 	u32 val;
 	int i;
 
-	pr_info("enter %s\n", __func__);
+	pr_debug("enter %s\n", __func__);
 
 	val = 0;
 	REG_SET_SLICE(val, STITCHING_RATIO_LONG_SHORT_1, hdr->ls1);
@@ -165,7 +165,7 @@ int isp_enable_hdr(struct isp_ic_dev *dev)
 	u32 dpcl;
 	int val = 0;
 
-	pr_info("enter %s\n", __func__);
+	pr_debug("enter %s\n", __func__);
 	addr = REG_ADDR(isp_stitching_ctrl);
 	isp_stitching_ctrl = isp_read_reg(dev, addr);
 	REG_SET_SLICE(val, STITCHING_FRAME_WIDTH, dev->ctx.acqWindow.width);
@@ -187,7 +187,7 @@ int isp_disable_hdr(struct isp_ic_dev *dev)
 {
 	u32 addr, isp_stitching_ctrl = 0;
 
-	pr_info("enter %s\n", __func__);
+	pr_debug("enter %s\n", __func__);
 	addr = REG_ADDR(isp_stitching_ctrl);
 	isp_stitching_ctrl = isp_read_reg(dev, addr);
 	REG_SET_SLICE(isp_stitching_ctrl, STITCHING_COMBINE_ENABLE_BIT, 1);
@@ -82,6 +82,20 @@
 volatile MrvAllRegister_t *all_regs = NULL;
 
 
+/* write-through, see isp_shadow.c for what is cached */
+static inline void isp_shadow_store(struct isp_ic_dev *dev, u32 offset, u32 val)
+{
+	u32 idx = offset >> 2;
+
+	if (!dev->shadow || !test_bit(idx, dev->shadow_map))
+		return;
+	/* reads back as 0 */
+	if (offset == REG_ADDR(img_eff_ctrl))
+		val &= ~MRV_IMGEFF_CFG_UPD_MASK;
+	dev->shadow[idx] = val;
+	set_bit(idx, dev->shadow_valid);
+}
+
 void isp_write_reg(struct isp_ic_dev *dev, u32 offset, u32 val)
 {
 	if (offset >= ISP_REG_SIZE)
@@ -90,7 +104,105 @@ void isp_write_reg(struct isp_ic_dev *dev, u32 offset, u32 val)
 	if ((offset >= REG_ADDR(mi_mp_y_base_ad_init))
 		&& (offset <= REG_ADDR(mi_mp_y_pic_size)))
 		writel(val, dev->base + offset);
+	isp_shadow_store(dev, offset, val);
+}
+
+/*
+ * Write n words to consecutive registers. LUT registers sit outside the
+ * MP-Y range, so none of them needs the double write of isp_write_reg().
+ */
+void isp_write_reg_burst(struct isp_ic_dev *dev, u32 offset,
+			const u32 *vals, u32 n)
+{
+	u32 i;
+
+	if (offset + n * sizeof(u32) > ISP_REG_SIZE)
+		return;
+	__iowrite32_copy(dev->base + offset, vals, n);
+	for (i = 0; i < n; i++)
+		isp_shadow_store(dev, offset + i * sizeof(u32), vals[i]);
+}
+
+/* write n words to one auto-incrementing table data port */
+void isp_write_reg_fifo(struct isp_ic_dev *dev, u32 offset,
+			const u32 *vals, u32 n)
+{
+	if (offset >= ISP_REG_SIZE)
+		return;
+	wmb();
+	writesl(dev->base + offset, vals, n);
+}
+
+void isp_lut_time(struct isp_ic_dev *dev, int lut, u64 start_ns)
+{
+	u32 us = (u32)div_u64(ktime_get_ns() - start_ns, NSEC_PER_USEC);
+
+	dev->lut_us[lut] = us;
+	if (us > dev->lut_max_us[lut])
+		dev->lut_max_us[lut] = us;
+}
+
+#ifdef __KERNEL__
+/*
+ * Upload the cached LSC and gamma out tables loops times and keep the
+ * average and worst case, for the procfs "lutbench" command. gcmono and
+ * rgbgamma come from the caller and are not kept, so they are not timed.
+ * The LSC goes to the bank not selected, which holds dev->lsc already or
+ * is rewritten before it is selected. The live lut_us counters are left
+ * as they were.
+ */
+int isp_lut_bench(struct isp_ic_dev *dev, u32 loops)
+{
+	static const int luts[] = { ISP_LUT_LSC, ISP_LUT_GAMMA_OUT };
+	u32 saved_us[ISP_LUT_MAX], saved_max_us[ISP_LUT_MAX];
+	u64 total[ARRAY_SIZE(luts)] = { 0 };
+	u32 max[ARRAY_SIZE(luts)] = { 0 };
+	unsigned long flags;
+	bool changed;
+	u32 i, j, us, bank;
+
+	if (loops == 0)
+		return -EINVAL;
+
+	mutex_lock(&dev->lsc_async.lock);
+	if (!is_isp_enable(dev)) {
+		/* the lsc sram is clocked off */
+		mutex_unlock(&dev->lsc_async.lock);
+		return -EBUSY;
+	}
+
+	memcpy(saved_us, dev->lut_us, sizeof(saved_us));
+	memcpy(saved_max_us, dev->lut_max_us, sizeof(saved_max_us));
+	for (i = 0; i < loops; i++) {
+		spin_lock_irqsave(&dev->irqlock, flags);
+		bank = (isp_read_reg(dev, REG_ADDR(isp_lsc_table_sel)) & 0x1U) ? 0U : 1U;
+		isp_lsc_load_bank(dev, bank);
+		/* a frame end update still pending stays pending */
+		changed = dev->gamma_out.changed;
+		isp_s_gamma_out(dev);
+		dev->gamma_out.changed = changed;
+		spin_unlock_irqrestore(&dev->irqlock, flags);
+
+		for (j = 0; j < ARRAY_SIZE(luts); j++) {
+			us = dev->lut_us[luts[j]];
+			total[j] += us;
+			if (us > max[j])
+				max[j] = us;
+		}
+		cond_resched();
+	}
+	memcpy(dev->lut_us, saved_us, sizeof(saved_us));
+	memcpy(dev->lut_max_us, saved_max_us, sizeof(saved_max_us));
+
+	for (j = 0; j < ARRAY_SIZE(luts); j++) {
+		dev->lut_bench_us[luts[j]] = (u32)div_u64(total[j], loops);
+		dev->lut_bench_max_us[luts[j]] = max[j];
+	}
+	dev->lut_bench_loops = loops;
+	mutex_unlock(&dev->lsc_async.lock);
+	return 0;
 }
+#endif
 
 u32 isp_read_reg(struct isp_ic_dev *dev, u32 offset)
 {
@@ -98,6 +210,8 @@ u32 isp_read_reg(struct isp_ic_dev *dev, u32 offset)
 
 	if (offset >= ISP_REG_SIZE)
 		return 0;
+	if (dev->shadow && test_bit(offset >> 2, dev->shadow_valid))
+		return dev->shadow[offset >> 2];
 	val = readl(dev->base + offset);
 	if ((offset >= REG_ADDR(mi_mp_y_base_ad_init))
 		&& (offset <= REG_ADDR(mi_mp_y_pic_size)))
@@ -869,6 +983,8 @@ int isp_enable_gamma_out_ctrl(struct isp_ic_dev *dev, bool bEnable)
 int isp_s_gamma_out(struct isp_ic_dev *dev)
 {
 	u32 isp_gamma_out_mode;
+	u32 curve[17];
+	u64 start_ns;
 	int i;
 	struct isp_gamma_out_context *gamma = &dev->gamma_out;
 
@@ -876,10 +992,12 @@ int isp_s_gamma_out(struct isp_ic_dev *dev)
 	REG_SET_SLICE(isp_gamma_out_mode, MRV_ISP_EQU_SEGM, gamma->mode);
 	isp_write_reg(dev, REG_ADDR(isp_gamma_out_mode), isp_gamma_out_mode);
 
-	for (i = 0; i < 17; i++) {
-		isp_write_reg(dev, REG_ADDR(gamma_out_y_block_arr[i]),
-					MRV_ISP_ISP_GAMMA_OUT_Y_MASK & gamma->curve[i]);
-	}
+	for (i = 0; i < 17; i++)
+		curve[i] = MRV_ISP_ISP_GAMMA_OUT_Y_MASK & gamma->curve[i];
+
+	start_ns = ktime_get_ns();
+	isp_write_reg_burst(dev, REG_ADDR(gamma_out_y_block_arr[0]), curve, 17);
+	isp_lut_time(dev, ISP_LUT_GAMMA_OUT, start_ns);
 
 	gamma->changed = false;
 
@@ -903,13 +1021,59 @@ int isp_s_gamma_out_ctrl(struct isp_ic_dev *dev)
 	return ret;
 }
 
-int isp_s_lsc_tbl(struct isp_ic_dev *dev)
+/* 17 samples per row, two 12 bit samples per word, 9 words per row */
+#define ISP_LSC_ROW_WORDS	((CAMERIC_MAX_LSC_SECTORS + 2) / 2)
+#define ISP_LSC_TBL_WORDS	(ISP_LSC_ROW_WORDS * (CAMERIC_MAX_LSC_SECTORS + 1))
+
+static void isp_lsc_pack(const u16 *tbl, u32 *words)
 {
 	int i, n;
+
+	for (n = 0;
+		 n <
+		 ((CAMERIC_MAX_LSC_SECTORS + 1) * (CAMERIC_MAX_LSC_SECTORS + 1));
+		 n += CAMERIC_MAX_LSC_SECTORS + 1) {
+		for (i = 0; i < (CAMERIC_MAX_LSC_SECTORS); i += 2)
+			*words++ = tbl[n + i] | (tbl[n + i + 1] << 12);
+		*words++ = tbl[n + CAMERIC_MAX_LSC_SECTORS];
+	}
+}
+
+/* bank 0 starts at sram address 0, bank 1 at 153 */
+void isp_lsc_load_bank(struct isp_ic_dev *dev, u32 bank)
+{
+	u32 sram_addr = bank ? 153U : 0U;
+	u32 words[ISP_LSC_TBL_WORDS];
+	u64 start_ns;
+	struct isp_lsc_context *lsc = (&dev->lsc);
+
+	isp_write_reg(dev, REG_ADDR(isp_lsc_r_table_addr), sram_addr);
+	isp_write_reg(dev, REG_ADDR(isp_lsc_gr_table_addr), sram_addr);
+	isp_write_reg(dev, REG_ADDR(isp_lsc_gb_table_addr), sram_addr);
+	isp_write_reg(dev, REG_ADDR(isp_lsc_b_table_addr), sram_addr);
+
+	/* each channel has its own auto-incrementing data port */
+	start_ns = ktime_get_ns();
+	isp_lsc_pack(lsc->r, words);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_lsc_r_table_data),
+			words, ISP_LSC_TBL_WORDS);
+	isp_lsc_pack(lsc->gr, words);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_lsc_gr_table_data),
+			words, ISP_LSC_TBL_WORDS);
+	isp_lsc_pack(lsc->gb, words);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_lsc_gb_table_data),
+			words, ISP_LSC_TBL_WORDS);
+	isp_lsc_pack(lsc->b, words);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_lsc_b_table_data),
+			words, ISP_LSC_TBL_WORDS);
+	isp_lut_time(dev, ISP_LUT_LSC, start_ns);
+}
+
+int isp_s_lsc_tbl(struct isp_ic_dev *dev)
+{
 	u32 isp_ctrl;
-	u32 sram_addr;
+	u32 bank;
 	u32 isp_lsc_status;
-	struct isp_lsc_context *lsc = (&dev->lsc);
 
 	isp_debug("enter %s\n", __func__);
 
@@ -923,43 +1087,12 @@ int isp_s_lsc_tbl(struct isp_ic_dev *dev)
 	}
 
 	isp_lsc_status = isp_read_reg(dev, REG_ADDR(isp_lsc_status));
-	sram_addr = (isp_lsc_status & 0x2U) ? 0U : 153U;
-	isp_write_reg(dev, REG_ADDR(isp_lsc_r_table_addr), sram_addr);
-	isp_write_reg(dev, REG_ADDR(isp_lsc_gr_table_addr), sram_addr);
-	isp_write_reg(dev, REG_ADDR(isp_lsc_gb_table_addr), sram_addr);
-	isp_write_reg(dev, REG_ADDR(isp_lsc_b_table_addr), sram_addr);
-
-	for (n = 0;
-		 n <
-		 ((CAMERIC_MAX_LSC_SECTORS + 1) * (CAMERIC_MAX_LSC_SECTORS + 1));
-		 n += CAMERIC_MAX_LSC_SECTORS + 1) {
-		/* 17 sectors with 2 values in one DWORD = 9 DWORDs (8 steps + 1 outside loop) */
-		for (i = 0; i < (CAMERIC_MAX_LSC_SECTORS); i += 2) {
-			isp_write_reg(dev, REG_ADDR(isp_lsc_r_table_data),
-					  lsc->r[n +
-						 i] | (lsc->r[n + i + 1] << 12));
-			isp_write_reg(dev, REG_ADDR(isp_lsc_gr_table_data),
-					  lsc->gr[n +
-						  i] | (lsc->gr[n + i + 1] << 12));
-			isp_write_reg(dev, REG_ADDR(isp_lsc_gb_table_data),
-					  lsc->gb[n +
-						  i] | (lsc->gb[n + i + 1] << 12));
-			isp_write_reg(dev, REG_ADDR(isp_lsc_b_table_data),
-					  lsc->b[n +
-						 i] | (lsc->b[n + i + 1] << 12));
-		}
-		isp_write_reg(dev, REG_ADDR(isp_lsc_r_table_data),
-				  lsc->r[n + CAMERIC_MAX_LSC_SECTORS]);
-		isp_write_reg(dev, REG_ADDR(isp_lsc_gr_table_data),
-				  lsc->gr[n + CAMERIC_MAX_LSC_SECTORS]);
-		isp_write_reg(dev, REG_ADDR(isp_lsc_gb_table_data),
-				  lsc->gb[n + CAMERIC_MAX_LSC_SECTORS]);
-		isp_write_reg(dev, REG_ADDR(isp_lsc_b_table_data),
-				  lsc->b[n + CAMERIC_MAX_LSC_SECTORS]);
-	}
-
-	isp_write_reg(dev, REG_ADDR(isp_lsc_table_sel),
-			  (isp_lsc_status & 0x2U) ? 0U : 1U);
+	bank = (isp_lsc_status & 0x2U) ? 0U : 1U;
+	isp_lsc_load_bank(dev, bank);
+	isp_write_reg(dev, REG_ADDR(isp_lsc_table_sel), bank);
+#ifdef __KERNEL__
+	isp_lsc_loaded(dev);
+#endif
 
 	return 0;
 }
@@ -2112,6 +2245,51 @@ int isp_ioc_g_feature_veresion(struct isp_ic_dev *dev, void *args)
 	return 0;
 }
 
+#ifdef ISP_HIST256
+/*
+ * Copy the last measured histogram out of the stats ring with the same
+ * seq protocol as the ISPIOC_G_STATS_BUF readers, retrying while the isr
+ * has the slot open or reopened it during the copy.
+ */
+static int isp_g_hist_slot(struct isp_ic_dev *dev, u32 *mean)
+{
+	struct isp_stats_frame *frame;
+	u32 seq, valid;
+	int retry;
+
+	for (retry = 0; retry < ISP_STATS_RING_NUM; retry++) {
+		frame = &dev->stats->frame[READ_ONCE(dev->stats_hist_slot)];
+		seq = READ_ONCE(frame->seq);
+		if (seq & 1) {
+			cpu_relax();
+			continue;
+		}
+		smp_rmb();
+		valid = frame->valid;
+		memcpy(mean, frame->hist, sizeof(frame->hist));
+		smp_rmb();
+		if (READ_ONCE(frame->seq) != seq)
+			continue;
+		return (valid & ISP_STATS_HIST_VALID) ? 0 : -EAGAIN;
+	}
+	return -EAGAIN;
+}
+#endif
+
+static long isp_get_stats_buf(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_extmem_info stats_mem;
+
+	if (!dev->stats)
+		return -ENOMEM;
+
+	stats_mem.addr = dev->stats_pa;
+	stats_mem.size = dev->stats_size;
+	viv_check_retval(copy_to_user(args, &stats_mem, sizeof(stats_mem)));
+
+	return 0;
+}
+
 static long isp_get_extmem(struct isp_ic_dev *dev, void *args)
 {
 	long ret = 0;
@@ -2175,6 +2353,10 @@ static int isp_s_wdr_curve(struct isp_ic_dev *dev)
 
 	int i, j;
 	uint32_t dYi = 0U;
+	/* isp_wdr_tonecurve_1..4 are followed by the 33 Ym registers */
+	u32 curve[4 + 33];
+	u64 start_ns;
+
 	for ( i=0; i<4; i++ )
 	{
 		for ( j=8; j>0; j-- )
@@ -2182,29 +2364,18 @@ static int isp_s_wdr_curve(struct isp_ic_dev *dev)
 			dYi <<= 4;
 			dYi += wdr->dY[ (i*8 + j) ];
 		}
-
-		switch(i)
-		{
-		case 0:
-			isp_write_reg(dev, REG_ADDR(isp_wdr_tonecurve_1), dYi);
-			break;
-		case 1:
-			isp_write_reg(dev, REG_ADDR(isp_wdr_tonecurve_2), dYi);
-			break;
-		case 2:
-			isp_write_reg(dev, REG_ADDR(isp_wdr_tonecurve_3), dYi);
-			break;
-		default:
-			isp_write_reg(dev, REG_ADDR(isp_wdr_tonecurve_4), dYi);
-			break;
-		}
+		curve[i] = dYi;
 	}
 
 	for ( i=0; i<33; i++ )
 	{
-		isp_write_reg(dev, REG_ADDR(wdr_tone_mapping_curve_y_block_arr[i]), wdr->Ym[i]);
+		curve[4 + i] = wdr->Ym[i];
 	}
 
+	start_ns = ktime_get_ns();
+	isp_write_reg_burst(dev, REG_ADDR(isp_wdr_tonecurve_1), curve, 4 + 33);
+	isp_lut_time(dev, ISP_LUT_WDR, start_ns);
+
 	dYi = 0x00000000;
 
 	isp_write_reg(dev, REG_ADDR(isp_wdr_offset), dYi);
@@ -2235,6 +2406,7 @@ long isp_priv_ioctl(struct isp_ic_dev *dev, unsigned int cmd, void *args)
 			break;
 		}
 		ret = isp_reset(dev);
+		isp_shadow_replay(dev);
 		break;
 
 	case ISPIOC_WRITE_REG:
@@ -2405,9 +2577,13 @@ long isp_priv_ioctl(struct isp_ic_dev *dev, unsigned int cmd, void *args)
 		ret = isp_awb_control(dev);
 		break;
 	case ISPIOC_S_LSC_TBL:
+#ifdef __KERNEL__
+		ret = isp_s_lsc_tbl_sync(dev, args);
+#else
 		viv_check_retval(copy_from_user
 				 (&dev->lsc, args, sizeof(dev->lsc)));
 		ret = isp_s_lsc_tbl(dev);
+#endif
 		break;
 	case ISPIOC_S_LSC_SEC:
 		viv_check_retval(copy_from_user
@@ -2550,6 +2726,9 @@ long isp_priv_ioctl(struct isp_ic_dev *dev, unsigned int cmd, void *args)
 	case ISPIOC_MI_START:
 		viv_check_retval(copy_from_user
 				 (&dev->mi, args, sizeof(dev->mi)));
+#ifdef __KERNEL__
+		memset(dev->mi_stride, 0, sizeof(dev->mi_stride));
+#endif
 		ret = isp_mi_start(dev);
 		break;
 	case ISPIOC_S_HDR_WB:
@@ -2600,16 +2779,6 @@ long isp_priv_ioctl(struct isp_ic_dev *dev, unsigned int cmd, void *args)
 					dev->frame_cnt[i] = 0;
 					dev->last_ns[i] = 0;
 				}
-
-#ifdef ENABLE_LATENCY_STATISTIC
-				dev->latency_stat_frame = 0;
-				dev->frame_id_latency = 0;
-				dev->frame_out_timestamp = 0;
-				dev->interleave_frames = 0;
-				memset(dev->isp_in_timestamp, 0, sizeof(dev->isp_in_timestamp));
-				memset(dev->isp_out_timestamp, 0,
-						sizeof(dev->isp_out_timestamp));
-#endif
 			}
 			break;
 		}
@@ -2644,6 +2813,12 @@ long isp_priv_ioctl(struct isp_ic_dev *dev, unsigned int cmd, void *args)
 		}
 	case ISPIOC_G_HISTMEAN:{
 			u32 mean[HIST_BIN_TOTAL];
+#ifdef ISP_HIST256
+			/* the bin port auto-increments and is drained by the isr */
+			if (dev->stats)
+				ret = isp_g_hist_slot(dev, mean);
+			else
+#endif
 			ret = isp_g_histmean(dev, mean);
 			viv_check_retval(copy_to_user
 					 (args, mean, sizeof(mean)));
@@ -2752,6 +2927,29 @@ long isp_priv_ioctl(struct isp_ic_dev *dev, unsigned int cmd, void *args)
 	case ISPIOC_G_QUERY_EXTMEM:
 		ret = isp_get_extmem(dev, args);
 		break;
+	case ISPIOC_G_STATS_BUF:
+		ret = isp_get_stats_buf(dev, args);
+		break;
+	case ISPIOC_S_PARAMS:
+		ret = isp_s_params(dev, args);
+		break;
+#ifdef __KERNEL__
+	case ISPIOC_S_LSC_TBL_ASYNC:
+		ret = isp_s_lsc_tbl_async(dev, args);
+		break;
+	case ISPIOC_G_LSC_SEQ: {
+		u32 seq = READ_ONCE(dev->lsc_async.done_seq);
+
+		viv_check_retval(copy_to_user(args, &seq, sizeof(seq)));
+		break;
+	}
+	case ISPIOC_S_RECONFIG:
+		ret = isp_s_reconfig(dev, args);
+		break;
+	case ISPIOC_QUEUE_AE:
+		ret = isp_queue_ae(dev, args);
+		break;
+#endif
 	default:
 		isp_err("unsupported command %d", cmd);
 		ret = -EINVAL;
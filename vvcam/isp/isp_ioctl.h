@@ -152,6 +152,12 @@ enum {
 	ISPIOC_S_COLOR_ADJUST		= 0x15E,
 	ISPIOC_S_DIGITAL_GAIN		= 0x15F,
 	ISPIOC_G_QUERY_EXTMEM		= 0x160,
+	ISPIOC_G_STATS_BUF			= 0x161,
+	ISPIOC_S_PARAMS				= 0x162,
+	ISPIOC_S_LSC_TBL_ASYNC		= 0x163,
+	ISPIOC_G_LSC_SEQ			= 0x164,
+	ISPIOC_S_RECONFIG			= 0x165,
+	ISPIOC_QUEUE_AE				= 0x166,
 
 	ISPIOC_WDR_CONFIG			= 0x16C,
 	ISPIOC_S_WDR_CURVE			= 0x16D,
@@ -239,10 +245,15 @@ int isp_s_rgbgamma(struct isp_ic_dev *dev, struct isp_rgbgamma_data *data);
 u32 isp_read_mi_irq(struct isp_ic_dev *dev);
 void isp_reset_mi_irq(struct isp_ic_dev *dev, u32 icr);
 
+int isp_start_dma_read(struct isp_ic_dev *dev, struct isp_dma_context *dma);
+int isp_stop_dma_read(struct isp_ic_dev *dev);
+bool isp_dma_read_active(struct isp_ic_dev *dev);
 int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args);
 int isp_mi_start(struct isp_ic_dev *dev);
+int isp_mi_resize(struct isp_ic_dev *dev);
 int isp_mi_stop(struct isp_ic_dev *dev);
 int isp_set_buffer(struct isp_ic_dev *dev, struct isp_buffer_context *buf);
+int isp_set_llength(struct isp_ic_dev *dev, int id, u32 stride);
 int isp_set_bp_buffer(struct isp_ic_dev *dev,
 		      struct isp_bp_buffer_context *buf);
 
@@ -258,6 +269,13 @@ int isp_s_ge(struct isp_ic_dev *dev);
 int isp_s_color_adjust(struct isp_ic_dev *dev);
 int isp_config_dummy_hblank(struct isp_ic_dev *dev);
 int isp_s_wdr(struct isp_ic_dev *dev);
+int isp_s_digital_gain(struct isp_ic_dev *dev);
+int isp_params_validate(const u8 *data, u32 data_size);
+int isp_stage_params(struct isp_ic_dev *dev, const u8 *data, u32 data_size,
+		bool apply_now);
+int isp_s_params(struct isp_ic_dev *dev, void *args);
+int isp_apply_params(struct isp_ic_dev *dev);
+void isp_lsc_load_bank(struct isp_ic_dev *dev, u32 bank);
 
 #ifdef __KERNEL__
 int clean_dma_buffer(struct isp_ic_dev *dev);
@@ -265,5 +283,27 @@ irqreturn_t isp_hw_isr(int irq, void *data);
 void isp_clear_interrupts(struct isp_ic_dev *dev);
 int update_dma_buffer(struct isp_ic_dev *dev);
 void isp_isr_tasklet(unsigned long arg);
+irqreturn_t isp_isr_thread(int irq, void *data);
+void isp_lsc_async_init(struct isp_ic_dev *dev);
+int isp_s_lsc_tbl_async(struct isp_ic_dev *dev, void *args);
+int isp_s_lsc_tbl_sync(struct isp_ic_dev *dev, void *args);
+void isp_lsc_loaded(struct isp_ic_dev *dev);
+void isp_lsc_async_stop(struct isp_ic_dev *dev);
+int isp_lut_bench(struct isp_ic_dev *dev, u32 loops);
+bool isp_lsc_flip(struct isp_ic_dev *dev);
+void isp_lsc_post_done(struct isp_ic_dev *dev);
+int isp_s_reconfig(struct isp_ic_dev *dev, void *args);
+bool isp_apply_reconfig(struct isp_ic_dev *dev);
+void isp_reconfig_post_done(struct isp_ic_dev *dev);
+void isp_ae_init(struct isp_ic_dev *dev);
+int isp_queue_ae(struct isp_ic_dev *dev, void *args);
+void isp_ae_frame_in(struct isp_ic_dev *dev);
+bool isp_ae_apply(struct isp_ic_dev *dev);
+void isp_ae_post_done(struct isp_ic_dev *dev);
+void isp_ae_flush(struct isp_ic_dev *dev);
+int isp_shadow_init(struct isp_ic_dev *dev);
+void isp_shadow_free(struct isp_ic_dev *dev);
+void isp_shadow_invalidate(struct isp_ic_dev *dev);
+void isp_shadow_replay(struct isp_ic_dev *dev);
 #endif
 #endif /* _ISP_IOC_H_ */
@@ -52,20 +52,24 @@
  *****************************************************************************/
 
 #include <linux/version.h>
+#include <linux/interrupt.h>
 #include "isp_ioctl.h"
 #include "isp_types.h"
 #include "mrv_all_bits.h"
 #include "video/vvbuf.h"
 #include "isp_driver.h"
+#include "isp_trace.h"
 
 extern MrvAllRegister_t *all_regs;
 
 static int config_dma_buf(struct isp_mi_data_path_context *path,
-		dma_addr_t dma, struct isp_buffer_context *buf)
+		struct vb2_dc_buf *vbuf, struct isp_buffer_context *buf)
 {
 	u32 size = path->out_width * path->out_height;
+	u32 line = vbuf->stride ? vbuf->stride : path->out_width;
+	dma_addr_t dma_cb = vbuf->dma_cb;
 
-	buf->addr_y = dma;
+	buf->addr_y = vbuf->dma;
 	switch (path->out_mode) {
 	case IC_MI_DATAMODE_YUV444:
 	case IC_MI_DATAMODE_YUV422:
@@ -78,15 +82,18 @@ static int config_dma_buf(struct isp_mi_data_path_context *path,
 			buf->size_cr = size + ISP_BUF_GAP;
 		} else if (path->data_layout ==
 				IC_MI_DATASTORAGE_SEMIPLANAR) {
+			size = line * path->out_height;
 			buf->size_y = size + ISP_BUF_GAP;
-			buf->addr_cb = buf->addr_y + size;
+			/* mplane buffers carry the chroma plane separately */
+			buf->addr_cb = dma_cb ? dma_cb : buf->addr_y + size;
 			if (path->out_mode == IC_MI_DATAMODE_YUV420)
 				buf->size_cb = (size >> 1) + ISP_BUF_GAP;
 			else
 				buf->size_cb = size + ISP_BUF_GAP;
 		} else if (path->data_layout ==
 				IC_MI_DATASTORAGE_INTERLEAVED) {
-			buf->size_y = (size << 1) + ISP_BUF_GAP;
+			buf->size_y = (vbuf->stride ? line * path->out_height :
+					size << 1) + ISP_BUF_GAP;
 		} else
 			return -1;
 		break;
@@ -116,23 +123,39 @@ int update_dma_buffer(struct isp_ic_dev *dev)
 	struct isp_mi_context *mi = &dev->mi;
 	struct vb2_dc_buf *buf = NULL;
 	struct isp_buffer_context dmabuf;
+	bool dropped;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	for (i = 0; i < MI_PATH_NUM; ++i) {
 		if (!mi->path[i].enable)
 			continue;
 
-		buf = vvbuf_pull_buf(dev->bctx);
+		/* a frame dropped across a reconfig goes straight back in */
+		buf = list_first_entry_or_null(&dev->mi_drop_list[i],
+				struct vb2_dc_buf, irqlist);
+		dropped = buf != NULL;
 		if (buf == NULL) {
-			dev->frame_loss_cnt[i]++;
-			continue;
+			/* peek first so a bad config leaves the buffer queued */
+			buf = vvbuf_try_dqbuf(dev->bctx);
+			if (buf == NULL) {
+				dev->frame_loss_cnt[i]++;
+				continue;
+			}
 		}
 		dmabuf.path = i;
-		if (config_dma_buf(&mi->path[i], buf->dma, &dmabuf)){
-			vvbuf_push_buf(dev->bctx,buf);
+		if (config_dma_buf(&mi->path[i], buf, &dmabuf))
 			continue;
+		if (dropped)
+			list_del_init(&buf->irqlist);
+		else
+			vvbuf_try_dqbuf_done(dev->bctx, buf);
+		/* the line length latches with the base addresses */
+		if (buf->stride != dev->mi_stride[i]) {
+			isp_set_llength(dev, i, buf->stride);
+			dev->mi_stride[i] = buf->stride;
 		}
 		isp_set_buffer(dev, &dmabuf);
+		trace_isp_buf_program(dev->id, i, buf->dma);
 		dev->mi_buf_shd[i] = dev->mi_buf[i];
 		dev->mi_buf[i] = buf;
 	}
@@ -156,113 +179,186 @@ static void isp_fps_stat(struct isp_ic_dev *dev, int path)
 		dev->last_ns[path] = cur_ns;
 	}
 }
-#ifdef ENABLE_LATENCY_STATISTIC
-void isp_latency_statistic(struct isp_ic_dev *dev)
+
+static inline void isp_stats_write_begin(struct isp_stats_frame *frame)
 {
-	int i = 0;
-	uint64_t average_latency_ns = 0;
+	frame->seq++;
+	smp_wmb();
+}
 
-	if (dev->frame_in_cnt < LATENCY_START_STATISTIC)
-		return;
+static inline void isp_stats_write_end(struct isp_stats_frame *frame)
+{
+	smp_wmb();
+	frame->seq++;
+}
 
-	if (dev->interleave_frames > 0 &&
-		dev->interleave_frames < LATENCY_INTERLEVE_FRAME) {
-		dev->interleave_frames++;
-		return;
-	}
+static void isp_stats_open_frame(struct isp_ic_dev *dev)
+{
+	struct isp_stats_frame *frame;
+
+	dev->stats_slot = dev->frame_in_cnt % ISP_STATS_RING_NUM;
+	frame = &dev->stats->frame[dev->stats_slot];
+
+	isp_stats_write_begin(frame);
+	frame->valid = 0;
+	frame->frame_id = dev->frame_in_cnt;
+	frame->timestamp = dev->frame_in_timestamp;
+	isp_stats_write_end(frame);
+}
 
-	dev->isp_in_timestamp[dev->frame_id_latency]  = dev->frame_in_timestamp;
-	dev->isp_out_timestamp[dev->frame_id_latency] = dev->frame_out_timestamp;
-	if (dev->frame_id_latency == (LATENCY_FRAME_NUM - 1)) {
-		pr_info("isp[%d] isp_in_timestamp(ns) [%lld~%lld]:\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n",
-			dev->id, dev->frame_in_cnt - LATENCY_FRAME_NUM + 1,
-			dev->frame_in_cnt,
-			dev->isp_in_timestamp[0], dev->isp_in_timestamp[1],
-			dev->isp_in_timestamp[2], dev->isp_in_timestamp[3],
-			dev->isp_in_timestamp[4], dev->isp_in_timestamp[5],
-			dev->isp_in_timestamp[6], dev->isp_in_timestamp[7],
-			dev->isp_in_timestamp[8], dev->isp_in_timestamp[9],
-			dev->isp_in_timestamp[10], dev->isp_in_timestamp[11],
-			dev->isp_in_timestamp[12], dev->isp_in_timestamp[13],
-			dev->isp_in_timestamp[14], dev->isp_in_timestamp[15],
-			dev->isp_in_timestamp[16], dev->isp_in_timestamp[17],
-			dev->isp_in_timestamp[18], dev->isp_in_timestamp[19],
-			dev->isp_in_timestamp[20], dev->isp_in_timestamp[21],
-			dev->isp_in_timestamp[22], dev->isp_in_timestamp[23]
-		);
-
-		pr_info("isp[%d] isp_out_timestamp(ns)  [%lld~%lld]:\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n"
-			"%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld ,%lld\n",
-			dev->id, dev->frame_in_cnt - LATENCY_FRAME_NUM + 1,
-			dev->frame_in_cnt,
-			dev->isp_out_timestamp[0], dev->isp_out_timestamp[1],
-			dev->isp_out_timestamp[2], dev->isp_out_timestamp[3],
-			dev->isp_out_timestamp[4], dev->isp_out_timestamp[5],
-			dev->isp_out_timestamp[6], dev->isp_out_timestamp[7],
-			dev->isp_out_timestamp[8], dev->isp_out_timestamp[9],
-			dev->isp_out_timestamp[10], dev->isp_out_timestamp[11],
-			dev->isp_out_timestamp[12], dev->isp_out_timestamp[13],
-			dev->isp_out_timestamp[14], dev->isp_out_timestamp[15],
-			dev->isp_out_timestamp[16], dev->isp_out_timestamp[17],
-			dev->isp_out_timestamp[18], dev->isp_out_timestamp[19],
-			dev->isp_out_timestamp[20], dev->isp_out_timestamp[21],
-			dev->isp_out_timestamp[22], dev->isp_out_timestamp[23]
-		);
-
-		pr_info("isp[%d] average latency(ns) [%lld~%lld]:\n",
-			dev->id, dev->frame_in_cnt - LATENCY_FRAME_NUM + 1,
-			dev->frame_in_cnt);
-		for (i = 0; i < LATENCY_FRAME_NUM; i++) {
-			average_latency_ns +=
-				(dev->isp_out_timestamp[i] - dev->isp_in_timestamp[i]);
+/* snapshot the finished measurements into the slot of the current frame */
+static void isp_stats_snapshot(struct isp_ic_dev *dev, u32 isp_mis)
+{
+	struct isp_stats_ring *ring = dev->stats;
+	struct isp_stats_frame *frame = &ring->frame[dev->stats_slot];
+
+	if (isp_mis & (MRV_ISP_MIS_EXP_END_MASK |
+			MRV_ISP_MIS_HIST_MEASURE_RDY_MASK |
+			MRV_ISP_MIS_AWB_DONE_MASK |
+			MRV_ISP_MIS_AFM_FIN_MASK |
+			MRV_ISP_MIS_VSM_END_MASK)) {
+		isp_stats_write_begin(frame);
+		if (isp_mis & MRV_ISP_MIS_EXP_END_MASK) {
+			isp_g_expmean(dev, frame->exp_mean);
+			frame->valid |= ISP_STATS_EXP_VALID;
+		}
+		if (isp_mis & MRV_ISP_MIS_HIST_MEASURE_RDY_MASK) {
+			isp_g_histmean(dev, frame->hist);
+			frame->valid |= ISP_STATS_HIST_VALID;
+			dev->stats_hist_slot = dev->stats_slot;
+		}
+		if (isp_mis & MRV_ISP_MIS_AWB_DONE_MASK) {
+			isp_g_awbmean(dev, &frame->awb);
+			frame->valid |= ISP_STATS_AWB_VALID;
 		}
-		pr_info("%lld\n", average_latency_ns / LATENCY_FRAME_NUM);
+		if (isp_mis & MRV_ISP_MIS_AFM_FIN_MASK) {
+			isp_g_afm(dev, &frame->afm);
+			frame->valid |= ISP_STATS_AFM_VALID;
+		}
+		if (isp_mis & MRV_ISP_MIS_VSM_END_MASK) {
+			isp_g_vsm(dev, &frame->vsm);
+			frame->valid |= ISP_STATS_VSM_VALID;
+		}
+		isp_stats_write_end(frame);
+	}
 
-		dev->frame_id_latency = 0;
-		dev->interleave_frames++;
-	} else if (dev->frame_id_latency < (LATENCY_FRAME_NUM - 1)) {
-		dev->frame_id_latency++;
+	if (isp_mis & MRV_ISP_MIS_FRAME_MASK) {
+		if (dev->dnr3.enable) {
+			isp_stats_write_begin(frame);
+			isp_g_3dnr(dev, &frame->dnr3_avg);
+			frame->valid |= ISP_STATS_3DNR_VALID;
+			isp_stats_write_end(frame);
+		}
+		ring->frame_id = frame->frame_id;
+		smp_wmb();
+		ring->head = dev->stats_slot;
+		if (dev->stats_done)
+			dev->stats_done(dev, frame);
 	}
 }
-#endif
 
-static void isr_process_frame(struct isp_ic_dev *dev)
+static void isr_process_frame(struct isp_ic_dev *dev, u32 mi_mis)
 {
 	int i;
 	unsigned long flags;
 	struct isp_mi_context *mi = &dev->mi;
+	u64 now = ktime_get_ns();
+	bool drop;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	drop = dev->reconfig.drop > 0;
+	if (drop) {
+		dev->reconfig.drop--;
+		dev->reconfig.drop_cnt++;
+	}
+	spin_unlock_irqrestore(&dev->irqlock, flags);
 
 	spin_lock_irqsave(&dev->lock, flags);
 	for (i = 0; i < MI_PATH_NUM; ++i) {
 		if (!mi->path[i].enable)
 			continue;
 
+		/*
+		 * The frame was written with the old mode, or while the
+		 * sensor settles: keep the buffer for the next program
+		 * instead of returning it. The drop list is drained by
+		 * update_dma_buffer under dev->lock ahead of bctx, so the
+		 * buffer is programmed again before any newly queued one.
+		 */
+		if (drop && dev->mi_buf_shd[i]) {
+			list_add_tail(&dev->mi_buf_shd[i]->irqlist,
+					&dev->mi_drop_list[i]);
+			dev->mi_buf_shd[i] = NULL;
+			continue;
+		}
+
 		if (dev->mi_buf_shd[i]) {
+			vvlat_hist_add(&dev->out_lat[i],
+					now - dev->frame_in_timestamp);
+			trace_isp_frame_end(dev->id, i, dev->frame_in_cnt,
+					now - dev->frame_in_timestamp);
 			dev->mi_buf_shd[i]->timestamp = dev->frame_in_timestamp;
+			dev->mi_buf_shd[i]->frame_id = dev->frame_in_cnt;
+			dev->mi_buf_shd[i]->done_ts = now;
 			vvbuf_ready(dev->bctx, dev->mi_buf_shd[i]->pad, dev->mi_buf_shd[i]);
 			dev->mi_buf_shd[i] = NULL;
 			isp_fps_stat(dev, i);
-#ifdef ENABLE_LATENCY_STATISTIC
-			if (i == 0)
-				isp_latency_statistic(dev);
-#endif
 		}
 	}
+	dev->mi_sched_frame = dev->frame_in_cnt;
+	if (mi_mis & MRV_MI_MP_FRAME_END_MASK)
+		dev->mp_end_frame = dev->frame_in_cnt;
 	spin_unlock_irqrestore(&dev->lock, flags);
-	tasklet_schedule(&dev->tasklet);
+
+	/*
+	 * The buffers are already queued on bctx, so programming the next
+	 * base address here closes the window where a late tasklet lets the
+	 * next frame start on the old shadow address.
+	 */
+	if (dev->mi_irq_program) {
+		update_dma_buffer(dev);
+		if (dev->rdma_done)
+			dev->rdma_done(dev, READ_ONCE(dev->mp_end_frame));
+	} else if (dev->irq_thread)
+		irq_wake_thread(dev->irq, dev);
+	else
+		tasklet_schedule(&dev->tasklet);
 	return;
 }
 
-void isp_isr_tasklet(unsigned long arg)
+static void isp_isr_bottom_half(struct isp_ic_dev *dev)
 {
-	struct isp_ic_dev *dev = (struct isp_ic_dev *)arg;
+	unsigned long flags;
+	u64 frame_id;
+	int i;
+
+	/* a frame started since the frame end, it keeps the old address */
+	spin_lock_irqsave(&dev->lock, flags);
+	frame_id = dev->mp_end_frame;
+	if (dev->frame_in_cnt != dev->mi_sched_frame) {
+		for (i = 0; i < MI_PATH_NUM; ++i) {
+			if (dev->mi.path[i].enable)
+				dev->mi_late_cnt[i]++;
+		}
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
 	update_dma_buffer(dev);
-	return;
+
+	/* the next output address is in, feed the next reprocessing job */
+	if (dev->rdma_done)
+		dev->rdma_done(dev, frame_id);
+}
+
+void isp_isr_tasklet(unsigned long arg)
+{
+	isp_isr_bottom_half((struct isp_ic_dev *)arg);
+}
+
+irqreturn_t isp_isr_thread(int irq, void *data)
+{
+	isp_isr_bottom_half((struct isp_ic_dev *)data);
+	return IRQ_HANDLED;
 }
 
 int clean_dma_buffer(struct isp_ic_dev *dev)
@@ -276,6 +372,11 @@ int clean_dma_buffer(struct isp_ic_dev *dev)
 	if (!dev->free)
 		return 0;
 
+	/* the next stream starts in whatever mode was set up last */
+	spin_lock_irqsave(&dev->irqlock, flags);
+	dev->reconfig.drop = 0;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
 	isp_dev = container_of(dev, struct isp_device, ic_dev);
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 19, 0)
@@ -285,15 +386,15 @@ int clean_dma_buffer(struct isp_ic_dev *dev)
 #endif
 	if (remote_pad && is_media_entity_v4l2_video_device(remote_pad->entity)) {
 		/*if isp connect to video, the buf free by video,isp maybe not access by isp,so just empty queue*/
+		spin_lock_irqsave(&dev->lock, flags);
 		for (i = 0; i < MI_PATH_NUM; ++i) {
 			dev->mi_buf[i]     = NULL;
 			dev->mi_buf_shd[i] = NULL;
+			INIT_LIST_HEAD(&dev->mi_drop_list[i]);
 		}
 
-		spin_lock_irqsave(&dev->bctx->irqlock, flags);
-		if (!list_empty(&dev->bctx->dmaqueue))
-			list_del_init(&dev->bctx->dmaqueue);
-		spin_unlock_irqrestore(&dev->bctx->irqlock, flags);
+		vvbuf_flush(dev->bctx);
+		spin_unlock_irqrestore(&dev->lock, flags);
 
 		return 0;
 	} else {
@@ -313,6 +414,12 @@ int clean_dma_buffer(struct isp_ic_dev *dev)
 				dev->free(dev, dev->mi_buf_shd[i]);
 				dev->mi_buf_shd[i] = NULL;
 			}
+			while (!list_empty(&dev->mi_drop_list[i])) {
+				buf = list_first_entry(&dev->mi_drop_list[i],
+						struct vb2_dc_buf, irqlist);
+				list_del_init(&buf->irqlist);
+				dev->free(dev, buf);
+			}
 		}
 		spin_unlock_irqrestore(&dev->lock, flags);
 	}
@@ -367,6 +474,7 @@ irqreturn_t isp_hw_isr(int irq, void *data)
 			MRV_MI_SP_CB_FIFO_FULL_MASK |
 			MRV_MI_SP_CR_FIFO_FULL_MASK;
 	u32 isp_mis, mi_mis, mi_status;
+	bool lsc_done, reconfig_done, ae_done;
 	struct isp_irq_data irq_data;
 
 	if (!dev)
@@ -394,14 +502,35 @@ irqreturn_t isp_hw_isr(int irq, void *data)
 		pr_debug("MI FIFO full: 0x%x\n", mi_status);
 	}
 
+	if (dev->stats)
+		isp_stats_snapshot(dev, isp_mis);
+
 	if (isp_mis & MRV_ISP_MIS_FRAME_IN_MASK) {
 		dev->frame_in_cnt++;
 		dev->frame_in_timestamp = ktime_get_ns();
+		if (dev->resume_ns) {
+			dev->resume_frame_us = (u32)div_u64(
+				dev->frame_in_timestamp - dev->resume_ns,
+				NSEC_PER_USEC);
+			dev->resume_ns = 0;
+		}
+		trace_isp_frame_in(dev->id, dev->frame_in_cnt);
+		if (dev->stats)
+			isp_stats_open_frame(dev);
+		isp_ae_frame_in(dev);
 	}
 
 	if (isp_mis & MRV_ISP_MIS_FRAME_MASK) {
 		spin_lock_irqsave(&dev->irqlock, flags);
 
+		if (dev->params.pending) {
+			isp_apply_params(dev);
+		}
+
+		lsc_done = isp_lsc_flip(dev);
+		reconfig_done = isp_apply_reconfig(dev);
+		ae_done = isp_ae_apply(dev);
+
 		if (dev->cproc.changed) {
 			isp_s_cproc(dev);
 		}
@@ -429,6 +558,13 @@ irqreturn_t isp_hw_isr(int irq, void *data)
 		}
 
 		spin_unlock_irqrestore(&dev->irqlock, flags);
+
+		if (lsc_done)
+			isp_lsc_post_done(dev);
+		if (reconfig_done)
+			isp_reconfig_post_done(dev);
+		if (ae_done)
+			isp_ae_post_done(dev);
 	}
 
 	if (mi_mis & errormask)
@@ -436,10 +572,7 @@ irqreturn_t isp_hw_isr(int irq, void *data)
 
 	if (mi_mis & frameendmask) {
 		if (*dev->state == (STATE_DRIVER_STARTED | STATE_STREAM_STARTED)) {
-#ifdef ENABLE_LATENCY_STATISTIC
-			dev->frame_out_timestamp = ktime_get_ns();
-#endif
-			isr_process_frame(dev);
+			isr_process_frame(dev, mi_mis);
 		}
 	}
 
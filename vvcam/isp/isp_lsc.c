@@ -0,0 +1,245 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include "mrv_all_bits.h"
+#include "isp_ioctl.h"
+#include "isp_types.h"
+
+static void isp_lsc_work(struct work_struct *work)
+{
+	struct isp_lsc_async *async =
+			container_of(work, struct isp_lsc_async, work);
+	struct isp_ic_dev *dev =
+			container_of(async, struct isp_ic_dev, lsc_async);
+	unsigned long flags;
+	u32 seq, bank;
+
+	mutex_lock(&async->lock);
+	spin_lock_irqsave(&dev->irqlock, flags);
+	if (async->load_seq == async->seq) {
+		spin_unlock_irqrestore(&dev->irqlock, flags);
+		goto end;
+	}
+	seq = async->seq;
+	async->load_seq = seq;
+	memcpy(&dev->lsc, &async->next, sizeof(dev->lsc));
+	/* the bank we are about to overwrite may be waiting for a flip */
+	async->flip = false;
+	async->defer = false;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	if (!is_isp_enable(dev)) {
+		/*
+		 * The sram is clocked off, isp_enable() loads dev->lsc and
+		 * only then is the table done.
+		 */
+		spin_lock_irqsave(&dev->irqlock, flags);
+		async->defer_seq = seq;
+		async->defer = true;
+		dev->update_lsc_tbl = true;
+		spin_unlock_irqrestore(&dev->irqlock, flags);
+		goto end;
+	}
+
+	/*
+	 * table_sel rather than lsc_status: a flip written at the last frame
+	 * end is not reflected in the status until the next frame starts.
+	 */
+	bank = (isp_read_reg(dev, REG_ADDR(isp_lsc_table_sel)) & 0x1U) ? 0U : 1U;
+	isp_lsc_load_bank(dev, bank);
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	async->sel = bank;
+	async->flip_seq = seq;
+	async->flip = true;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+end:
+	mutex_unlock(&async->lock);
+}
+
+void isp_lsc_async_init(struct isp_ic_dev *dev)
+{
+	INIT_WORK(&dev->lsc_async.work, isp_lsc_work);
+	mutex_init(&dev->lsc_async.lock);
+}
+
+int isp_s_lsc_tbl_async(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_lsc_async *async = &dev->lsc_async;
+	struct isp_lsc_context *lsc;
+	unsigned long flags;
+	u32 seq;
+
+	lsc = kmalloc(sizeof(*lsc), GFP_KERNEL);
+	if (!lsc)
+		return -ENOMEM;
+
+	if (copy_from_user(lsc, args, sizeof(*lsc))) {
+		kfree(lsc);
+		return -EIO;
+	}
+
+	/* a newer table replaces one the work item has not picked up yet */
+	spin_lock_irqsave(&dev->irqlock, flags);
+	memcpy(&async->next, lsc, sizeof(async->next));
+	seq = ++async->seq;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+	kfree(lsc);
+
+	queue_work(system_highpri_wq, &async->work);
+
+	viv_check_retval(copy_to_user((u8 *)args +
+			offsetof(struct isp_lsc_submit, seq), &seq, sizeof(seq)));
+	return 0;
+}
+
+/*
+ * ISPIOC_S_LSC_TBL. Taking the async lock keeps it from interleaving with
+ * the work item, and the synchronous table retires every async one
+ * submitted before it.
+ */
+int isp_s_lsc_tbl_sync(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_lsc_async *async = &dev->lsc_async;
+	unsigned long flags;
+	int ret;
+
+	mutex_lock(&async->lock);
+	if (copy_from_user(&dev->lsc, args, sizeof(dev->lsc))) {
+		mutex_unlock(&async->lock);
+		return -EFAULT;
+	}
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	async->load_seq = async->seq;
+	async->flip = false;
+	async->defer_seq = async->seq;
+	async->defer = async->done_seq != async->seq;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	ret = isp_s_lsc_tbl(dev);
+	mutex_unlock(&async->lock);
+	return ret;
+}
+
+/* isp_s_lsc_tbl() wrote dev->lsc, complete a table deferred on it */
+void isp_lsc_loaded(struct isp_ic_dev *dev)
+{
+	struct isp_lsc_async *async = &dev->lsc_async;
+	unsigned long flags;
+	bool done;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	done = async->defer;
+	if (done) {
+		async->defer = false;
+		WRITE_ONCE(async->done_seq, async->defer_seq);
+	}
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	if (done)
+		isp_lsc_post_done(dev);
+}
+
+/*
+ * The isp is being closed and reset, a flip still pending would never
+ * happen. Reload the table on the next enable and complete it then.
+ */
+void isp_lsc_async_stop(struct isp_ic_dev *dev)
+{
+	struct isp_lsc_async *async = &dev->lsc_async;
+	unsigned long flags;
+
+	cancel_work_sync(&async->work);
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	if (async->flip) {
+		async->flip = false;
+		async->defer_seq = async->flip_seq;
+		async->defer = true;
+		dev->update_lsc_tbl = true;
+	}
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+}
+
+/* called with irqlock held at frame end */
+bool isp_lsc_flip(struct isp_ic_dev *dev)
+{
+	struct isp_lsc_async *async = &dev->lsc_async;
+
+	if (!async->flip)
+		return false;
+
+	isp_write_reg(dev, REG_ADDR(isp_lsc_table_sel), async->sel);
+	async->flip = false;
+	WRITE_ONCE(async->done_seq, async->flip_seq);
+	return true;
+}
+
+void isp_lsc_post_done(struct isp_ic_dev *dev)
+{
+	struct isp_irq_data irq_data;
+
+	if (!dev->post_event)
+		return;
+
+	memset(&irq_data, 0, sizeof(irq_data));
+	irq_data.addr = ISP_IRQ_DATA_LSC_DONE;
+	irq_data.val = READ_ONCE(dev->lsc_async.done_seq);
+	irq_data.nop[0] = (uint32_t)dev->frame_in_cnt;
+	dev->post_event(dev, &irq_data, sizeof(irq_data));
+}
@@ -79,31 +79,27 @@ int getRawBit(u32 type, u32 *bit, u32 *len)
 	return 0;
 }
 
-int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args)
+int isp_start_dma_read(struct isp_ic_dev *dev, struct isp_dma_context *dma)
 {
-	struct isp_dma_context dma;
 	u32 mi_dma_ctrl = isp_read_reg(dev, REG_ADDR(mi_dma_ctrl));
 	u32 llength = 0, mcm_rd_fmt_bit = 0;
 	u32 mi_imsc = 0, mcm_fmt = 0;
 
-	pr_info("enter %s\n", __func__);
-	viv_check_retval(copy_from_user(&dma, args, sizeof(dma)));
-
-	REG_SET_SLICE(mi_dma_ctrl, MRV_MI_DMA_BURST_LEN_LUM, dma.burst_y);
-	REG_SET_SLICE(mi_dma_ctrl, MRV_MI_DMA_BURST_LEN_CHROM, dma.burst_c);
+	REG_SET_SLICE(mi_dma_ctrl, MRV_MI_DMA_BURST_LEN_LUM, dma->burst_y);
+	REG_SET_SLICE(mi_dma_ctrl, MRV_MI_DMA_BURST_LEN_CHROM, dma->burst_c);
 
 	isp_write_reg(dev, REG_ADDR(mi_dma_y_pic_start_ad),
-		      (MRV_MI_DMA_Y_PIC_START_AD_MASK & dma.base));
-	getRawBit(dma.type, &mcm_rd_fmt_bit, &llength);
+		      (MRV_MI_DMA_Y_PIC_START_AD_MASK & dma->base));
+	getRawBit(dma->type, &mcm_rd_fmt_bit, &llength);
 
-	llength = dma.width * llength / 8;
+	llength = dma->width * llength / 8;
 	REG_SET_SLICE(mcm_fmt, MCM_RD_RAW_BIT, mcm_rd_fmt_bit);
 	isp_write_reg(dev, REG_ADDR(mi_dma_y_pic_width),
-		      (MRV_MI_DMA_Y_PIC_WIDTH_MASK & dma.width));
+		      (MRV_MI_DMA_Y_PIC_WIDTH_MASK & dma->width));
 	isp_write_reg(dev, REG_ADDR(mi_dma_y_llength),
 		      (MRV_MI_DMA_Y_LLENGTH_MASK & llength));
 	isp_write_reg(dev, REG_ADDR(mi_dma_y_pic_size),
-		      (MRV_MI_DMA_Y_PIC_SIZE_MASK & (llength * dma.height)));
+		      (MRV_MI_DMA_Y_PIC_SIZE_MASK & (llength * dma->height)));
 	isp_write_reg(dev, REG_ADDR(mi_dma_cb_pic_start_ad), 0);
 	isp_write_reg(dev, REG_ADDR(mi_dma_cr_pic_start_ad), 0);
 	isp_write_reg(dev, REG_ADDR(mi_dma_ctrl), mi_dma_ctrl);
@@ -120,6 +116,34 @@ int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args)
 	return 0;
 }
 
+/*
+ * The mi dma has no abort, mask its ready irq and let the caller wait for
+ * isp_dma_read_active() to clear before the buffer is released.
+ */
+int isp_stop_dma_read(struct isp_ic_dev *dev)
+{
+	u32 mi_imsc = isp_read_reg(dev, REG_ADDR(mi_imsc));
+
+	mi_imsc &= ~MRV_MI_DMA_READY_MASK;
+	isp_write_reg(dev, REG_ADDR(mi_imsc), mi_imsc);
+	return 0;
+}
+
+bool isp_dma_read_active(struct isp_ic_dev *dev)
+{
+	return !!(isp_read_reg(dev, REG_ADDR(mi_dma_status)) &
+			MRV_MI_DMA_ACTIVE_MASK);
+}
+
+int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_dma_context dma;
+
+	pr_info("enter %s\n", __func__);
+	viv_check_retval(copy_from_user(&dma, args, sizeof(dma)));
+	return isp_start_dma_read(dev, &dma);
+}
+
 u32 getScaleFactor(u32 src, u32 dst)
 {
 	if (dst > src) {
@@ -573,6 +597,54 @@ int isp_set_buffer(struct isp_ic_dev *dev, struct isp_buffer_context *buf)
 	return 0;
 }
 
+/* override the packed line length set by isp_mi_start, 0 restores it */
+int isp_set_llength(struct isp_ic_dev *dev, int id, u32 stride)
+{
+	struct isp_mi_data_path_context *path = &dev->mi.path[id];
+
+	if (id > 1)
+		return -EINVAL;
+
+	if (!stride)
+		stride = path->data_layout == IC_MI_DATASTORAGE_INTERLEAVED ?
+		    path->out_width * 2 : path->out_width;
+	isp_write_reg(dev, id == 0 ? REG_ADDR(mi_mp_y_llength) :
+		      REG_ADDR(mi_sp_y_llength), stride);
+	isp_write_reg(dev, id == 0 ? REG_ADDR(mi_mp_y_pic_size) :
+		      REG_ADDR(mi_sp_y_pic_size), stride * path->out_height);
+	return 0;
+}
+
+/*
+ * Picture size of the enabled paths for a mode switch at frame end. The mi
+ * size registers are shadowed and latch with the next base address, the
+ * buffers in flight and the mi setup otherwise stay as they are.
+ */
+int isp_mi_resize(struct isp_ic_dev *dev)
+{
+	struct isp_mi_data_path_context *path;
+	u32 out_stride;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		path = &dev->mi.path[i];
+		if (!path->enable)
+			continue;
+
+		if (path->hscale || path->vscale)
+			set_scaling(i, dev, dev->is.enable);
+
+		out_stride = path->data_layout == IC_MI_DATASTORAGE_INTERLEAVED ?
+		    path->out_width * 2 : path->out_width;
+		isp_write_reg(dev, i == 0 ? REG_ADDR(mi_mp_y_pic_width) :
+			      REG_ADDR(mi_sp_y_pic_width), out_stride);
+		isp_write_reg(dev, i == 0 ? REG_ADDR(mi_mp_y_pic_height) :
+			      REG_ADDR(mi_sp_y_pic_height), path->out_height);
+		isp_set_llength(dev, i, dev->mi_stride[i]);
+	}
+	return 0;
+}
+
 int isp_set_bp_buffer(struct isp_ic_dev *dev, struct isp_bp_buffer_context *buf)
 {
 #ifndef ISP_MI_BP
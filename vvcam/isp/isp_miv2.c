@@ -180,36 +180,32 @@ int isp_set_buffer(struct isp_ic_dev *dev, struct isp_buffer_context *buf)
 }
 
 /* only support read raw */
-int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args)
+int isp_start_dma_read(struct isp_ic_dev *dev, struct isp_dma_context *dma)
 {
-	struct isp_dma_context dma;
 	u32 llength, miv2_imsc, miv2_ctrl, mcm_ctrl, mcm_fmt;
 	u32 mcm_bus_cfg;
 	u32 mcm_rd_fmt_bit = 0;
 
-	pr_info("enter %s\n", __func__);
-	viv_check_retval(copy_from_user(&dma, args, sizeof(dma)));
-
 	miv2_imsc = isp_read_reg(dev, REG_ADDR(miv2_imsc));
 	miv2_ctrl = isp_read_reg(dev, REG_ADDR(miv2_ctrl));
 	mcm_ctrl = isp_read_reg(dev, REG_ADDR(miv2_mcm_ctrl));
 	mcm_fmt = isp_read_reg(dev, REG_ADDR(miv2_mcm_fmt));
 	mcm_bus_cfg = isp_read_reg(dev, REG_ADDR(miv2_mcm_bus_cfg));
 
-	getRawBit(dma.type, &mcm_rd_fmt_bit, &llength);
+	getRawBit(dma->type, &mcm_rd_fmt_bit, &llength);
 
-	llength = dma.width * llength / 8;
+	llength = dma->width * llength / 8;
 	REG_SET_SLICE(mcm_fmt, MCM_RD_RAW_BIT, mcm_rd_fmt_bit);
 	REG_SET_SLICE(mcm_ctrl, MCM_RD_CFG_UPD, 1);
 	REG_SET_SLICE(mcm_ctrl, MCM_RD_AUTO_UPDATE, 1);
 	isp_write_reg(dev, REG_ADDR(miv2_mcm_dma_raw_pic_start_ad),
-		      (MCM_DMA_RAW_PIC_START_AD_MASK & dma.base));
+		      (MCM_DMA_RAW_PIC_START_AD_MASK & dma->base));
 	isp_write_reg(dev, REG_ADDR(miv2_mcm_dma_raw_pic_width),
-		      (MCM_DMA_RAW_PIC_WIDTH_MASK & dma.width));
+		      (MCM_DMA_RAW_PIC_WIDTH_MASK & dma->width));
 	isp_write_reg(dev, REG_ADDR(miv2_mcm_dma_raw_pic_llength),
 		      (MCM_DMA_RAW_PIC_LLENGTH_MASK & llength));
 	isp_write_reg(dev, REG_ADDR(miv2_mcm_dma_raw_pic_size),
-		      (MCM_DMA_RAW_PIC_SIZE_MASK & (llength * dma.height)));
+		      (MCM_DMA_RAW_PIC_SIZE_MASK & (llength * dma->height)));
 	isp_write_reg(dev, REG_ADDR(miv2_mcm_dma_raw_pic_lval),
 		      (MCM_DMA_RAW_PIC_WIDTH_MASK & llength));
 	isp_write_reg(dev, REG_ADDR(miv2_mcm_fmt), mcm_fmt);
@@ -222,6 +218,30 @@ int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args)
 	return 0;
 }
 
+/* disabling the raw rdma path stops the mcm read at once */
+int isp_stop_dma_read(struct isp_ic_dev *dev)
+{
+	u32 miv2_ctrl = isp_read_reg(dev, REG_ADDR(miv2_ctrl));
+
+	miv2_ctrl &= ~(MCM_RAW_RDMA_START_MASK | MCM_RAW_RDMA_PATH_ENABLE_MASK);
+	isp_write_reg(dev, REG_ADDR(miv2_ctrl), miv2_ctrl);
+	return 0;
+}
+
+bool isp_dma_read_active(struct isp_ic_dev *dev)
+{
+	return isp_read_reg(dev, REG_ADDR(miv2_mcm_dma_status)) & MCM_DMA_ACTIVE_MASK;
+}
+
+int isp_ioc_start_dma_read(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_dma_context dma;
+
+	pr_info("enter %s\n", __func__);
+	viv_check_retval(copy_from_user(&dma, args, sizeof(dma)));
+	return isp_start_dma_read(dev, &dma);
+}
+
 u32 getScaleFactor(u32 src, u32 dst)
 {
 	if (dst > src) {
@@ -617,6 +637,66 @@ void set_data_path(int id, struct isp_mi_data_path_context *path,
 
 }
 
+/*
+ * Override the packed line length set by set_data_path, 0 restores it.
+ * llength counts pixels, which take two bytes when interleaved.
+ */
+int isp_set_llength(struct isp_ic_dev *dev, int id, u32 stride)
+{
+	struct isp_mi_data_path_context *path = &dev->mi.path[id];
+	u32 addr, llength = path->out_width;
+
+	if (id >= PATHNUM)
+		return -EINVAL;
+
+	if (stride)
+		llength = path->data_layout == IC_MI_DATASTORAGE_INTERLEAVED ?
+		    stride / 2 : stride;
+	if (id == 0)
+		addr = REG_ADDR(miv2_mp_y_llength);
+	else if (id == 1)
+		addr = REG_ADDR(miv2_sp1_y_llength);
+	else
+		addr = REG_ADDR(miv2_sp2_y_llength);
+	/* llength, pic_width, pic_height, pic_size */
+	isp_write_reg(dev, addr, llength);
+	isp_write_reg(dev, addr + 12, llength * path->out_height);
+	return 0;
+}
+
+/*
+ * Picture size of the enabled ycbcr paths for a mode switch at frame end.
+ * The size registers are shadowed and latch with the next base address,
+ * the buffers in flight and the mi setup otherwise stay as they are.
+ */
+int isp_mi_resize(struct isp_ic_dev *dev)
+{
+	struct isp_mi_data_path_context *path;
+	u32 addr;
+	int i;
+
+	for (i = 0; i < PATHNUM; i++) {
+		path = &dev->mi.path[i];
+		if (!path->enable)
+			continue;
+
+		if (path->hscale || path->vscale || dev->is.enable)
+			set_scaling(i, dev, dev->is.enable);
+
+		if (i == 0)
+			addr = REG_ADDR(miv2_mp_y_llength);
+		else if (i == 1)
+			addr = REG_ADDR(miv2_sp1_y_llength);
+		else
+			addr = REG_ADDR(miv2_sp2_y_llength);
+		/* llength, pic_width, pic_height, pic_size */
+		isp_write_reg(dev, addr + 4, path->out_width);
+		isp_write_reg(dev, addr + 8, path->out_height);
+		isp_set_llength(dev, i, dev->mi_stride[i]);
+	}
+	return 0;
+}
+
 int isp_mi_start(struct isp_ic_dev *dev)
 {
 	int i;
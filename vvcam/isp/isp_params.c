@@ -0,0 +1,211 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include "mrv_all_bits.h"
+#include "isp_ioctl.h"
+#include "isp_types.h"
+
+struct isp_params_block_desc {
+	size_t size;
+	size_t ctx_offset;
+	size_t stage_offset;
+	int (*apply)(struct isp_ic_dev *dev);
+};
+
+#define ISP_PARAMS_BLOCK(_type, _member, _apply) \
+	[_type] = { \
+		.size = sizeof(((struct isp_ic_dev *)0)->_member), \
+		.ctx_offset = offsetof(struct isp_ic_dev, _member), \
+		.stage_offset = offsetof(struct isp_params_stage, _member), \
+		.apply = _apply, \
+	}
+
+static const struct isp_params_block_desc isp_params_blocks[ISP_PARAMS_BLOCK_MAX] = {
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_DGAIN, dgain, isp_s_digital_gain),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_BLS, bls, isp_s_bls),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_AWB, awb, isp_s_awb),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_CC, cc, isp_s_cc),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_EE, ee, isp_s_ee),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_EXP, exp, isp_s_exp),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_HIST, hist, isp_s_hist),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_AFM, afm, isp_s_afm),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_VSM, vsm, isp_s_vsm),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_FLT, flt, isp_s_flt),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_CNR, cnr, isp_s_cnr),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_CPROC, cproc, isp_s_cproc),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_DPF, dpf, isp_s_dpf),
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_DPCC, dpcc, isp_s_dpcc),
+#ifdef ISP_DEMOSAIC2
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_DMSC, demosaic, isp_s_dmsc),
+#endif
+	ISP_PARAMS_BLOCK(ISP_PARAMS_BLOCK_GAMMA_OUT, gamma_out, isp_s_gamma_out),
+};
+
+/* walk the blocks once, nothing is staged unless all of them are valid */
+int isp_params_validate(const u8 *data, u32 data_size)
+{
+	const struct isp_params_block_header *header;
+	u32 offset = 0;
+
+	while (offset < data_size) {
+		if (data_size - offset < sizeof(*header))
+			return -EINVAL;
+		header = (const struct isp_params_block_header *)(data + offset);
+		if (header->type >= ISP_PARAMS_BLOCK_MAX ||
+		    !isp_params_blocks[header->type].apply) {
+			pr_err("%s: unsupported block %u\n", __func__, header->type);
+			return -EINVAL;
+		}
+		if (header->size != isp_params_blocks[header->type].size ||
+		    header->size > data_size - offset - sizeof(*header)) {
+			pr_err("%s: block %u size %u mismatch\n", __func__,
+					header->type, header->size);
+			return -EINVAL;
+		}
+		offset += ALIGN(sizeof(*header) + header->size, 8);
+	}
+
+	return 0;
+}
+
+/* called with irqlock held */
+int isp_apply_params(struct isp_ic_dev *dev)
+{
+	struct isp_params_stage *stage = &dev->params;
+	const struct isp_params_block_desc *desc;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < ISP_PARAMS_BLOCK_MAX; i++) {
+		if (!(stage->pending & BIT(i)))
+			continue;
+		desc = &isp_params_blocks[i];
+		memcpy((u8 *)dev + desc->ctx_offset,
+				(u8 *)stage + desc->stage_offset, desc->size);
+		ret |= desc->apply(dev);
+	}
+	stage->pending = 0;
+
+	return ret;
+}
+
+/*
+ * stage validated blocks for the next frame end, apply_now latches them at
+ * once for callers that know the isp is between frames
+ */
+int isp_stage_params(struct isp_ic_dev *dev, const u8 *data, u32 data_size,
+		bool apply_now)
+{
+	const struct isp_params_block_header *header;
+	const struct isp_params_block_desc *desc;
+	unsigned long flags;
+	u32 offset = 0;
+	int ret = 0;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	while (offset < data_size) {
+		header = (const struct isp_params_block_header *)(data + offset);
+		desc = &isp_params_blocks[header->type];
+		memcpy((u8 *)&dev->params + desc->stage_offset,
+				header + 1, desc->size);
+		dev->params.pending |= BIT(header->type);
+		offset += ALIGN(sizeof(*header) + header->size, 8);
+	}
+
+	/* nothing latches the blocks at frame end while the isp is off */
+	if (apply_now || !is_isp_enable(dev))
+		ret = isp_apply_params(dev);
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	return ret;
+}
+
+int isp_s_params(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_params_buffer params;
+	u8 *data;
+	int ret = 0;
+
+	viv_check_retval(copy_from_user(&params, args, sizeof(params)));
+	if (params.version != ISP_PARAMS_VERSION) {
+		pr_err("%s: unsupported params version %u\n", __func__,
+				params.version);
+		return -EINVAL;
+	}
+	if (params.data_size == 0 || params.data_size > ISP_PARAMS_MAX_SIZE)
+		return -EINVAL;
+
+	data = kmalloc(params.data_size, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+
+	if (copy_from_user(data, (u8 *)args + sizeof(params),
+				params.data_size)) {
+		ret = -EIO;
+		goto end;
+	}
+
+	ret = isp_params_validate(data, params.data_size);
+	if (ret)
+		goto end;
+
+	ret = isp_stage_params(dev, data, params.data_size, false);
+
+end:
+	kfree(data);
+	return ret;
+}
@@ -0,0 +1,160 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include "mrv_all_bits.h"
+#include "isp_ioctl.h"
+#include "isp_types.h"
+
+extern MrvAllRegister_t *all_regs;
+
+int isp_s_reconfig(struct isp_ic_dev *dev, void *args)
+{
+	struct isp_reconfig_stage *stage = &dev->reconfig;
+	struct isp_reconfig_context *next;
+	bool done = false;
+	unsigned long flags;
+	u32 seq;
+
+	next = kmalloc(sizeof(*next), GFP_KERNEL);
+	if (!next)
+		return -ENOMEM;
+
+	if (copy_from_user(next, args, sizeof(*next))) {
+		kfree(next);
+		return -EFAULT;
+	}
+	if (next->drop_frames > ISP_RECONFIG_MAX_DROP) {
+		kfree(next);
+		return -EINVAL;
+	}
+
+	/* a newer setup replaces one that has not reached a frame end yet */
+	spin_lock_irqsave(&dev->irqlock, flags);
+	memcpy(&stage->next, next, sizeof(stage->next));
+	stage->pending = true;
+	seq = ++stage->seq;
+	/* nothing latches it at frame end while the isp is off */
+	if (!is_isp_enable(dev))
+		done = isp_apply_reconfig(dev);
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+	kfree(next);
+
+	if (done)
+		isp_reconfig_post_done(dev);
+
+	viv_check_retval(copy_to_user((u8 *)args +
+			offsetof(struct isp_reconfig_context, seq), &seq, sizeof(seq)));
+	return 0;
+}
+
+/*
+ * Called with irqlock held at frame end. The frame has left the isp and
+ * the resizers, the input, hdr and resizer setup switch at once. The mi
+ * only gets new sizes, which latch with the next base address, so the
+ * frame still in the mi keeps the old setup and its buffer.
+ * Lock order is irqlock, then dev->lock.
+ */
+bool isp_apply_reconfig(struct isp_ic_dev *dev)
+{
+	struct isp_reconfig_stage *stage = &dev->reconfig;
+	u32 isp_ctrl;
+
+	if (!stage->pending)
+		return false;
+
+	memcpy(&dev->ctx, &stage->next.ctx, sizeof(dev->ctx));
+	isp_s_input(dev);
+
+	memcpy(&dev->hdr, &stage->next.hdr, sizeof(dev->hdr));
+	if (dev->hdr.enable) {
+		isp_s_hdr(dev);
+		isp_enable_hdr(dev);
+	} else {
+		isp_disable_hdr(dev);
+	}
+
+	/* update_dma_buffer and the frame end read the paths under dev->lock */
+	spin_lock(&dev->lock);
+	memcpy(&dev->mi, &stage->next.mi, sizeof(dev->mi));
+	isp_mi_resize(dev);
+	spin_unlock(&dev->lock);
+
+	isp_ctrl = isp_read_reg(dev, REG_ADDR(isp_ctrl));
+	REG_SET_SLICE(isp_ctrl, MRV_ISP_ISP_GEN_CFG_UPD, 1);
+	isp_write_reg(dev, REG_ADDR(isp_ctrl), isp_ctrl);
+
+	if (is_isp_enable(dev))
+		stage->drop = 1 + stage->next.drop_frames;
+	stage->pending = false;
+	stage->cnt++;
+	WRITE_ONCE(stage->done_seq, stage->seq);
+	return true;
+}
+
+void isp_reconfig_post_done(struct isp_ic_dev *dev)
+{
+	struct isp_irq_data irq_data;
+
+	if (!dev->post_event)
+		return;
+
+	memset(&irq_data, 0, sizeof(irq_data));
+	irq_data.addr = ISP_IRQ_DATA_RECONFIG_DONE;
+	irq_data.val = READ_ONCE(dev->reconfig.done_seq);
+	irq_data.nop[0] = (uint32_t)dev->frame_in_cnt;
+	dev->post_event(dev, &irq_data, sizeof(irq_data));
+}
@@ -153,47 +153,21 @@ int isp_s_rgbgammaWriteData(struct isp_ic_dev *dev,
 	isp_write_reg(dev, REG_ADDR(isp_gcrgb_b_x_addr), 0);
 	isp_write_reg(dev, REG_ADDR(isp_gcrgb_b_y_addr), 0);
 
-	u32 isp_gc_y_data, isp_gc_x_data;
-	int i;
-	u32 *tblX, *tblY;
-
-	tblX = data->rgbgc_r_datax;
-	tblY = data->rgbgc_r_datay;
-	for (i = 0; i < 64; i++) {
-		isp_gc_y_data = *(tblY + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcrgb_r_y_write_data),
-			      isp_gc_y_data);
-	}
-	for (i = 0; i < 63; i++) {
-		isp_gc_x_data = *(tblX + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcrgb_r_x_write_data),
-			      isp_gc_x_data);
-	}
-
-	tblX = data->rgbgc_g_datax;
-	tblY = data->rgbgc_g_datay;
-	for (i = 0; i < 64; i++) {
-		isp_gc_y_data = *(tblY + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcrgb_g_y_write_data),
-			      isp_gc_y_data);
-	}
-	for (i = 0; i < 63; i++) {
-		isp_gc_x_data = *(tblX + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcrgb_g_x_write_data),
-			      isp_gc_x_data);
-	}
-	tblX = data->rgbgc_b_datax;
-	tblY = data->rgbgc_b_datay;
-	for (i = 0; i < 64; i++) {
-		isp_gc_y_data = *(tblY + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcrgb_b_y_write_data),
-			      isp_gc_y_data);
-	}
-	for (i = 0; i < 63; i++) {
-		isp_gc_x_data = *(tblX + i);
-		isp_write_reg(dev, REG_ADDR(isp_gcrgb_b_x_write_data),
-			      isp_gc_x_data);
-	}
+	u64 start_ns = ktime_get_ns();
+
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcrgb_r_y_write_data),
+			data->rgbgc_r_datay, 64);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcrgb_r_x_write_data),
+			data->rgbgc_r_datax, 63);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcrgb_g_y_write_data),
+			data->rgbgc_g_datay, 64);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcrgb_g_x_write_data),
+			data->rgbgc_g_datax, 63);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcrgb_b_y_write_data),
+			data->rgbgc_b_datay, 64);
+	isp_write_reg_fifo(dev, REG_ADDR(isp_gcrgb_b_x_write_data),
+			data->rgbgc_b_datax, 63);
+	isp_lut_time(dev, ISP_LUT_RGBGAMMA, start_ns);
     return 0;
 #endif
 }
@@ -0,0 +1,176 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+
+#include <linux/bitmap.h>
+#include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include "mrv_all_bits.h"
+#include "isp_ioctl.h"
+#include "isp_types.h"
+
+extern MrvAllRegister_t *all_regs;
+
+/*
+ * Registers that only software changes and that hold tuning or pipeline
+ * configuration. Status, shadow, measurement and table data port registers
+ * are left out and always go to the hardware, so is everything in the MI,
+ * which the irq reprograms every frame. isp_ctrl and isp_exp_ctrl have bits
+ * the hardware clears and are not cached either.
+ */
+struct isp_shadow_range {
+	u32 first;
+	u32 last;
+};
+
+#define ISP_SHADOW_RANGE(_first, _last) \
+	{ offsetof(MrvAllRegister_t, _first), offsetof(MrvAllRegister_t, _last) }
+
+static const struct isp_shadow_range isp_shadow_ranges[] = {
+	ISP_SHADOW_RANGE(img_eff_ctrl, img_eff_tint),
+	ISP_SHADOW_RANGE(img_eff_sharpen, img_eff_sharpen),
+	ISP_SHADOW_RANGE(isp_acq_prop, isp_acq_nr_frames),
+	ISP_SHADOW_RANGE(isp_gamma_dx_lo, isp_awb_gain_rb),
+	ISP_SHADOW_RANGE(isp_cc_coeff_0, isp_demosaic),
+	ISP_SHADOW_RANGE(isp_imsc, isp_imsc),
+	ISP_SHADOW_RANGE(cross_talk_coef_block_arr[0],
+			gamma_out_y_block_arr[GAMMA_OUT_Y_BLOCK_ARR_SIZE - 1]),
+	ISP_SHADOW_RANGE(isp_ct_offset_r, isp_cnr_threshold_c2),
+	ISP_SHADOW_RANGE(green_equilibrate_ctrl, green_equilibrate_hcnt_dummy),
+	ISP_SHADOW_RANGE(cproc_ctrl, cproc_hue),
+	ISP_SHADOW_RANGE(isp_afm_ctrl, isp_afm_var_shift),
+	ISP_SHADOW_RANGE(isp_lsc_ctrl, isp_lsc_ctrl),
+	ISP_SHADOW_RANGE(isp_lsc_xgrad_01, isp_lsc_ysize_67),
+	ISP_SHADOW_RANGE(isp_hist_prop, isp_hist_v_size),
+	ISP_SHADOW_RANGE(isp_hist_weight_00to30, isp_hist_weight_44),
+	ISP_SHADOW_RANGE(isp_filt_mode, isp_cac_y_norm),
+	ISP_SHADOW_RANGE(isp_exp_h_offset, isp_exp_v_size),
+	ISP_SHADOW_RANGE(isp_bls_ctrl, isp_bls_d_fixed),
+	ISP_SHADOW_RANGE(isp_dpf_mode, isp_dpf_nf_gain_b),
+	ISP_SHADOW_RANGE(isp_dpcc_mode, isp_dpcc_bpt_number),
+	ISP_SHADOW_RANGE(isp_wdr_ctrl, isp_wdr_deltamin),
+	ISP_SHADOW_RANGE(awb_meas_mode, awb_meas_rmax[7]),
+	ISP_SHADOW_RANGE(isp_vsm_mode, isp_vsm_v_segments),
+	ISP_SHADOW_RANGE(isp_compand_ctrl, isp_compand_compress_px_10),
+	ISP_SHADOW_RANGE(isp_wdr3_ctrl, isp_wdr3_block_flag_height),
+	ISP_SHADOW_RANGE(isp_wdr3_histogram[0], isp_wdr3_shift_1),
+	ISP_SHADOW_RANGE(isp_ee_ctrl, isp_ee_y_gain),
+	ISP_SHADOW_RANGE(isp_denoise2d_control, isp_denoise2d_sigma_y[23]),
+	ISP_SHADOW_RANGE(isp_dmsc_ctrl, isp_dmsc_cac_y_norm),
+};
+
+int isp_shadow_init(struct isp_ic_dev *dev)
+{
+	const struct isp_shadow_range *range;
+	int i;
+
+	dev->shadow = vzalloc(ISP_REG_SIZE);
+	dev->shadow_map = bitmap_zalloc(ISP_REG_SIZE / 4, GFP_KERNEL);
+	dev->shadow_valid = bitmap_zalloc(ISP_REG_SIZE / 4, GFP_KERNEL);
+	if (!dev->shadow || !dev->shadow_map || !dev->shadow_valid) {
+		isp_shadow_free(dev);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(isp_shadow_ranges); i++) {
+		range = &isp_shadow_ranges[i];
+		if (range->last >= ISP_REG_SIZE)
+			continue;
+		bitmap_set(dev->shadow_map, range->first / 4,
+				(range->last - range->first) / 4 + 1);
+	}
+
+	return 0;
+}
+
+void isp_shadow_free(struct isp_ic_dev *dev)
+{
+	/* the accessors test shadow first */
+	vfree(dev->shadow);
+	dev->shadow = NULL;
+	bitmap_free(dev->shadow_map);
+	dev->shadow_map = NULL;
+	bitmap_free(dev->shadow_valid);
+	dev->shadow_valid = NULL;
+}
+
+/* forget the cached values, the next session starts from the hardware */
+void isp_shadow_invalidate(struct isp_ic_dev *dev)
+{
+	if (dev->shadow)
+		bitmap_zero(dev->shadow_valid, ISP_REG_SIZE / 4);
+}
+
+/*
+ * Write every cached register back after the hardware lost its state. The
+ * lsc sram is not register mapped, isp_enable() reloads it from dev->lsc.
+ */
+void isp_shadow_replay(struct isp_ic_dev *dev)
+{
+	unsigned long idx;
+	u64 start_ns;
+
+	if (!dev->shadow)
+		return;
+
+	start_ns = ktime_get_ns();
+	for_each_set_bit(idx, dev->shadow_valid, ISP_REG_SIZE / 4)
+		writel(dev->shadow[idx], dev->base + idx * 4);
+	if (isp_read_reg(dev, REG_ADDR(isp_lsc_ctrl)) & MRV_LSC_LSC_EN_MASK)
+		dev->update_lsc_tbl = true;
+
+	dev->replay_us = (u32)div_u64(ktime_get_ns() - start_ns, NSEC_PER_USEC);
+	dev->replay_cnt++;
+}
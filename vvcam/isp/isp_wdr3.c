@@ -108,6 +108,10 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 	u32 height_left;
 	u32 height_count = 0;
 	u32 val;
+	/* histogram..difference_weight and the two invert curves are contiguous */
+	u32 curve[7][5];
+	u32 invert[2][7];
+	u64 start_ns;
 	bool reg_flag = false;
 	int i, pos;
 
@@ -274,7 +278,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_HISTOGRAM_CURVE2,
 				      wdr3->histogram[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_histogram[i]), val);
+		curve[0][i] = val;
 
 		val =
 		    wdr3->entropy[pos] << (reg_flag ?
@@ -287,7 +291,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_ENTROPY_CONVERT2,
 				      wdr3->entropy[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_entropy[i]), val);
+		curve[1][i] = val;
 
 		val =
 		    wdr3->gamma_pre[pos] << (reg_flag ?
@@ -301,7 +305,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_GAMMA_PRE_CURVE2,
 				      wdr3->gamma_pre[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_gamma_pre[i]), val);
+		curve[2][i] = val;
 
 		val =
 		    wdr3->gamma_up[pos] << (reg_flag ?
@@ -314,7 +318,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_GAMMA_UP_CURVE2,
 				      wdr3->gamma_up[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_gamma_up[i]), val);
+		curve[3][i] = val;
 
 		val =
 		    wdr3->gamma_down[pos] << (reg_flag ?
@@ -328,7 +332,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_GAMMA_DOWN_CURVE2,
 				      wdr3->gamma_down[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_gamma_down[i]), val);
+		curve[4][i] = val;
 
 		val =
 		    wdr3->distance_weight[pos] << (reg_flag ?
@@ -344,7 +348,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_DISTANCE_WEIGHT_CURVE2,
 				      wdr3->distance_weight[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_distance_weight[i]), val);
+		curve[5][i] = val;
 
 		val =
 		    wdr3->difference_weight[pos] << (reg_flag ?
@@ -360,8 +364,7 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 		if (reg_flag)
 			REG_SET_SLICE(val, WDR3_DIFFERENCE_WEIGHT_CURVE2,
 				      wdr3->difference_weight[pos + 2]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_difference_weight[i]),
-			      val);
+		curve[6][i] = val;
 	}
 
 	for (i = 0; i < 7; i++) {
@@ -370,15 +373,22 @@ void wdr3_hw_init(struct isp_ic_dev *dev)
 			      wdr3->invert_curve[i * 2]);
 		REG_SET_SLICE(val, WDR3_GLOBAL_CURVE_INVERT1,
 			      wdr3->invert_curve[i * 2 + 1]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_invert_curve[i]), val);
+		invert[0][i] = val;
 		val = 0;
 		REG_SET_SLICE(val, WDR3_LINEAR_CURVE_INVERT0,
 			      wdr3->invert_linear[i * 2]);
 		REG_SET_SLICE(val, WDR3_LINEAR_CURVE_INVERT1,
 			      wdr3->invert_linear[i * 2 + 1]);
-		isp_write_reg(dev, REG_ADDR(isp_wdr3_invert_linear[i]), val);
+		invert[1][i] = val;
 	}
 
+	start_ns = ktime_get_ns();
+	isp_write_reg_burst(dev, REG_ADDR(isp_wdr3_histogram[0]),
+			&curve[0][0], 7 * 5);
+	isp_write_reg_burst(dev, REG_ADDR(isp_wdr3_invert_curve[0]),
+			&invert[0][0], 2 * 7);
+	isp_lut_time(dev, ISP_LUT_WDR, start_ns);
+
 	isp_wdr3_shift_0 = 0;
 	REG_SET_SLICE(isp_wdr3_shift_0, WDR3_HISTOGRAM_SHIFT0, wdr3->shift[0]);
 	REG_SET_SLICE(isp_wdr3_shift_0, WDR3_HISTOGRAM_SHIFT1, wdr3->shift[1]);
@@ -66,11 +66,14 @@ long dwe_devcore_ioctl(struct dwe_device *dwe, unsigned int cmd, void *args)
 	switch (cmd) {
 	case DWEIOC_RESET:
 		break;
-	case DWEIOC_S_PARAMS:
+	case DWEIOC_S_PARAMS: {
+		struct dwe_hw_info info;
+
 		which = dev->which[dwe->id]; /*just set the current one*/
-		viv_check_retval(copy_from_user(&dev->info[dwe->id][which],
-				args, sizeof(dev->info[dwe->id][which])));
+		viv_check_retval(copy_from_user(&info, args, sizeof(info)));
+		dwe_update_params(dev, dwe->id, which, &info);
 		break;
+	}
 	case DWEIOC_START:
 		if (dwe->state & STATE_DRIVER_STARTED)
 			break;
@@ -78,6 +81,7 @@ long dwe_devcore_ioctl(struct dwe_device *dwe, unsigned int cmd, void *args)
 			ret = dwe_priv_ioctl(&dwe->core->ic_dev,
 					DWEIOC_RESET, NULL);
 			ret |= dwe_priv_ioctl(&dwe->core->ic_dev, cmd, args);
+			dwe->core->ic_dev.hw_tag = DWE_HW_TAG_NONE;
 		}
 		dwe->core->state++;
 		dwe->state |= STATE_DRIVER_STARTED;
@@ -104,11 +108,15 @@ long dwe_devcore_ioctl(struct dwe_device *dwe, unsigned int cmd, void *args)
 			pr_err("map num exceeds the max cfg num.\n");
 		break;
 	}
+	case DWEIOC_GEN_LUT:
+		ret = dwe_lut_gen(dwe, args);
+		break;
 	case DWEIOC_GET_LUT_STATUS: {
 		which = dev->which[dwe->id];
 		if (dwe->state & STATE_DRIVER_STARTED) {
 			if (dev->dist_map[dwe->id][which] ==
-					dev->curmap[dwe->id][which]) {
+					dev->curmap[dwe->id][which] &&
+					!READ_ONCE(dwe->core->lut.pending[dwe->id])) {
 				lut_status = 0;
 			} else {
 				lut_status = 1;
@@ -139,24 +147,12 @@ static int dwe_core_match(struct dwe_devcore *core, struct resource *res)
 			core->end == res->end;
 }
 
-static int dwe_core_get_index(struct dwe_ic_dev *dev, struct vb2_dc_buf *buf)
-{
-	struct dwe_devcore *core =
-			container_of(dev, struct dwe_devcore, ic_dev);
-	int i;
-
-	for (i = 0; i < MAX_DWE_NUM; ++i)
-		if (core->src_pads[i] == buf->pad)
-			return i;
-	return -1;
-}
-
 struct dwe_devcore *dwe_devcore_init(struct dwe_device *dwe,
 				struct resource *res)
 {
 	struct dwe_devcore *core, *found = NULL;
 	unsigned long flags;
-	int rc;
+	int rc, i, j;
 
 	spin_lock_irqsave(&devcore_list_lock, flags);
 	if (!list_empty(&devcore_list)) {
@@ -198,6 +194,7 @@ struct dwe_devcore *dwe_devcore_init(struct dwe_device *dwe,
 	vvbuf_ctx_init(&core->bctx[DWE_PAD_SINK]);
 	core->ic_dev.sink_bctx = &core->bctx[DWE_PAD_SINK];
 	core->irq = dwe->irq;
+	core->ic_dev.irq = dwe->irq;
 	pr_debug("request_irq num:%d, rc:%d\n", dwe->irq, rc);
 
 	spin_lock_init(&core->ic_dev.irqlock);
@@ -206,11 +203,17 @@ struct dwe_devcore *dwe_devcore_init(struct dwe_device *dwe,
 	core->src_pads[dwe->id] = &dwe->pads[DWE_PAD_SINK];
 	core->ic_dev.src_bctx[dwe->id] = &dwe->bctx[DWE_PAD_SOURCE];
 	core->ic_dev.state[dwe->id] = &dwe->state;
-	core->ic_dev.get_index = dwe_core_get_index;
+	dwe_sched_init(&core->ic_dev);
+	for (i = 0; i < MAX_DWE_NUM; i++)
+		for (j = 0; j < MAX_CFG_NUM; j++)
+			dwe_compile_params(&core->ic_dev.info[i][j],
+					&core->ic_dev.image[i][j]);
+	core->ic_dev.hw_tag = DWE_HW_TAG_NONE;
 
 	tasklet_init(&core->ic_dev.tasklet, dwe_isr_tasklet, (unsigned long)(&core->ic_dev));
 
 	mutex_init(&core->mutex);
+	dwe_lut_init(core, dwe->sd.dev);
 	refcount_set(&core->refcount, 1);
 
 	spin_lock_irqsave(&devcore_list_lock, flags);
@@ -233,6 +236,7 @@ void dwe_devcore_deinit(struct dwe_device *dwe)
 
 	if (refcount_dec_and_test(&core->refcount)) {
 		tasklet_kill(&core->ic_dev.tasklet);
+		dwe_lut_deinit(core);
 		spin_lock_irqsave(&devcore_list_lock, flags);
 		list_del(&core->entry);
 		spin_unlock_irqrestore(&devcore_list_lock, flags);
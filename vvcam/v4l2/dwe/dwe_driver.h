@@ -55,6 +55,25 @@
 
 #include "dwe_dev.h"
 #include "video/vvbuf.h"
+#include "dwe_ioctl.h"
+
+#define DWE_LUT_CACHE_NUM (8)
+
+/* kernel generated dewarp maps, most recently used first */
+struct dwe_lut_cache {
+	struct device *dev;
+	struct mutex lock;
+	struct list_head lru;
+	u32 num;
+	spinlock_t req_lock;
+	struct dwe_lut_gen req[MAX_DWE_NUM];	/* latest async request */
+	bool pending[MAX_DWE_NUM];
+	struct work_struct work;
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+	struct vvlat_hist gen;
+};
 
 struct dwe_devcore {
 	struct vvbuf_ctx bctx[DWE_PADS_NUM];
@@ -68,6 +87,8 @@ struct dwe_devcore {
 	int (*match)(struct dwe_devcore *core, struct resource *res);
 	int irq;
 	struct list_head entry;
+	struct proc_dir_entry *pde;
+	struct dwe_lut_cache lut;
 };
 
 struct dwe_device {
@@ -80,6 +101,7 @@ struct dwe_device {
 	int state;
 	int id;
 	int irq;
+	int irq_cpu;
 	struct clk *clk_core;
 	struct clk *clk_axi;
 	struct clk *clk_ahb;
@@ -90,4 +112,8 @@ struct dwe_devcore *dwe_devcore_init(struct dwe_device *dwe,
 				struct resource *res);
 void dwe_devcore_deinit(struct dwe_device *dwe);
 long dwe_devcore_ioctl(struct dwe_device *dwe, unsigned int cmd, void *args);
+
+void dwe_lut_init(struct dwe_devcore *core, struct device *dev);
+void dwe_lut_deinit(struct dwe_devcore *core);
+long dwe_lut_gen(struct dwe_device *dwe, void *args);
 #endif /* _DWE_DRIVER_H_ */
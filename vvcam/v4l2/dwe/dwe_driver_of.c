@@ -53,11 +53,16 @@
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
 #include <linux/version.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <media/v4l2-event.h>
 
 #include "dwe_driver.h"
 #include "dwe_ioctl.h"
 
+#define CREATE_TRACE_POINTS
+#include "dwe_trace.h"
+
 #define DEWARP_NODE_NUM  (2)
 
 static struct dwe_device *pdwe_dev[DEWARP_NODE_NUM] = {NULL};
@@ -160,11 +165,14 @@ int dwe_set_stream(struct v4l2_subdev *sd, int enable)
 	}
 
 	if (!enable) {
+		/* before the flush, the staged dst goes back on this queue */
+		dwe_release_stream(&dwe_dev->core->ic_dev, dwe_dev->id);
 		ctx = &dwe_dev->bctx[DWE_PAD_SOURCE];
 		spin_lock_irqsave(&ctx->irqlock, flags);
 		if (!list_empty(&ctx->dmaqueue))
 			list_del_init(&ctx->dmaqueue);
 		spin_unlock_irqrestore(&ctx->irqlock, flags);
+		dwe_sched_flush(&dwe_dev->core->ic_dev, dwe_dev->id);
 	}
 	return 0;
 }
@@ -200,6 +208,7 @@ static void dwe_src_buf_notify(struct vvbuf_ctx *ctx, struct vb2_dc_buf *buf)
 {
 	struct v4l2_subdev *sd;
 	struct dwe_device *dwe;
+	struct dwe_ic_dev *ic_dev;
 
 	if (unlikely(!ctx || !buf))
 		return;
@@ -211,12 +220,14 @@ static void dwe_src_buf_notify(struct vvbuf_ctx *ctx, struct vb2_dc_buf *buf)
 		return;
 	}
 
-	ctx = &dwe->core->bctx[DWE_PAD_SINK];
-	vvbuf_push_buf(ctx, buf);
-	if ((dwe->core->ic_dev.hardware_status == HARDWARE_IDLE) &&
+	ic_dev = &dwe->core->ic_dev;
+	dwe_sched_push(ic_dev, dwe->id, buf);
+	/* also wake the tasklet to stage a job behind the running one */
+	if ((ic_dev->hardware_status == HARDWARE_IDLE ||
+	     !READ_ONCE(ic_dev->next.src)) &&
 	    (dwe->state == (STATE_DRIVER_STARTED | STATE_STREAM_STARTED))) {
-		dwe->core->ic_dev.hardware_status = HARDWARE_BUSY;
-		tasklet_schedule(&dwe->core->ic_dev.tasklet);
+		ic_dev->hardware_status = HARDWARE_BUSY;
+		dwe_isr_schedule(ic_dev);
 	}
 }
 
@@ -268,9 +279,10 @@ static int dwe_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 	if ((pdwe_dev[0]->refcnt + pdwe_dev[1]->refcnt) == 0) {
 		msleep(1);
 		dwe_clear_interrupts(&pdwe_dev[0]->core->ic_dev);
-		if (devm_request_irq(pdwe_dev[0]->sd.dev,
-					pdwe_dev[0]->irq,
-					dwe_hw_isr, IRQF_SHARED,
+		if (devm_request_threaded_irq(pdwe_dev[0]->sd.dev,
+					pdwe_dev[0]->irq, dwe_hw_isr,
+					pdwe_dev[0]->core->ic_dev.irq_thread ?
+					dwe_isr_thread : NULL, IRQF_SHARED,
 					dev_name(pdwe_dev[0]->sd.dev),
 					&pdwe_dev[0]->core->ic_dev) != 0) {
 			pr_err("failed to request irq.\n");
@@ -278,6 +290,9 @@ static int dwe_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 			ret = -1;
 			goto unlock;
 		}
+		if (pdwe_dev[0]->irq_cpu >= 0)
+			irq_set_affinity_hint(pdwe_dev[0]->irq,
+					cpumask_of(pdwe_dev[0]->irq_cpu));
 	}
 
 unlock:
@@ -311,6 +326,8 @@ static int dwe_close(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 		goto exit;
 	}
 	dwe_priv_ioctl(&pdwe_dev[0]->core->ic_dev, DWEIOC_STOP, NULL);
+	if (pdwe_dev[0]->irq_cpu >= 0)
+		irq_set_affinity_hint(pdwe_dev[0]->irq, NULL);
 	devm_free_irq(pdwe_dev[0]->sd.dev, pdwe_dev[0]->irq, &pdwe_dev[0]->core->ic_dev);
 	dwe_clear_interrupts(&pdwe_dev[0]->core->ic_dev);
 	pdwe_dev[0]->core->state = 0;
@@ -332,6 +349,113 @@ static const struct v4l2_subdev_internal_ops dwe_internal_ops = {
 struct v4l2_subdev *g_dwe_subdev[DEWARP_NODE_NUM] = {NULL};
 EXPORT_SYMBOL_GPL(g_dwe_subdev);
 
+static int dwe_info_procfs_show(struct seq_file *sfile, void *offset)
+{
+	struct dwe_devcore *core = (struct dwe_devcore *) sfile->private;
+	struct dwe_sched_queue *sq;
+	char name[16];
+	int i;
+
+	seq_printf(sfile, "/********************************VSI DWE INFO********************************/\n");
+	for (i = 0; i < MAX_DWE_NUM; i++) {
+		snprintf(name, sizeof(name), "dwe%d_out", i);
+		vvlat_hist_show(sfile, name, &core->ic_dev.lat[i]);
+	}
+	for (i = 0; i < MAX_DWE_NUM; i++) {
+		sq = &core->ic_dev.sq[i];
+		seq_printf(sfile, "dwe%d sched\t weight %u deadline(us) %llu depth %u max %u jobs %llu drops %llu overdue %llu flushed %llu\n",
+				i, sq->weight, div_u64(sq->deadline_ns, NSEC_PER_USEC),
+				sq->depth, sq->max_depth, sq->jobs, sq->drops,
+				sq->overdue, sq->flushed);
+		snprintf(name, sizeof(name), "dwe%d_wait", i);
+		vvlat_hist_show(sfile, name, &sq->wait);
+	}
+	seq_printf(sfile, "dwe lut\t cached %u hits %llu misses %llu evictions %llu\n",
+			core->lut.num, core->lut.hits, core->lut.misses,
+			core->lut.evictions);
+	vvlat_hist_show(sfile, "dwe_lut_gen", &core->lut.gen);
+	seq_printf(sfile, "dwe jobs\t irq kicks %llu tasklet kicks %llu programming full %llu partial %llu\n",
+			core->ic_dev.kick_irq, core->ic_dev.kick_tasklet,
+			core->ic_dev.prog_full, core->ic_dev.prog_partial);
+	return 0;
+}
+
+static int dwe_procfs_open(struct inode *inode, struct file *file)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 17, 0)
+	return single_open(file, dwe_info_procfs_show, PDE_DATA(inode));
+#else
+	return single_open(file, dwe_info_procfs_show, pde_data(inode));
+#endif
+}
+
+static ssize_t dwe_procfs_write(struct file *file,
+		const char __user *buffer, size_t count, loff_t *ppos)
+{
+	struct dwe_devcore *core;
+	struct dwe_sched_queue *sq;
+	unsigned long flags;
+	char strbuf[128];
+	char str[128] = "";
+	int i, id = -1;
+	u32 val = 0;
+
+	if (count >= 128)
+		return count;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 17, 0)
+	core = (struct dwe_devcore *) PDE_DATA(file_inode(file));
+#else
+	core = (struct dwe_devcore *) pde_data(file_inode(file));
+#endif
+
+	if (copy_from_user(strbuf, buffer, count))
+		return -EFAULT;
+	strbuf[count] = '\0';
+	sscanf(strbuf, "%s %d %u", str, &id, &val);
+
+	spin_lock_irqsave(&core->ic_dev.sched_lock, flags);
+	if (!strcmp("clear", str) || !strlen(str)) {
+		memset(core->ic_dev.lat, 0, sizeof(core->ic_dev.lat));
+		for (i = 0; i < MAX_DWE_NUM; i++) {
+			sq = &core->ic_dev.sq[i];
+			sq->max_depth = sq->depth;
+			sq->jobs = 0;
+			sq->drops = 0;
+			sq->overdue = 0;
+			sq->flushed = 0;
+			memset(&sq->wait, 0, sizeof(sq->wait));
+		}
+		core->ic_dev.kick_irq = 0;
+		core->ic_dev.kick_tasklet = 0;
+		core->ic_dev.prog_full = 0;
+		core->ic_dev.prog_partial = 0;
+		core->lut.hits = 0;
+		core->lut.misses = 0;
+		core->lut.evictions = 0;
+		memset(&core->lut.gen, 0, sizeof(core->lut.gen));
+	} else if (id >= 0 && id < MAX_DWE_NUM) {
+		/* "weight <stream> <frames>" or "deadline <stream> <us>" */
+		sq = &core->ic_dev.sq[id];
+		if (!strcmp("weight", str)) {
+			sq->weight = max_t(u32, val, 1);
+			sq->credit = min(sq->credit, sq->weight);
+		} else if (!strcmp("deadline", str)) {
+			sq->deadline_ns = (u64)val * NSEC_PER_USEC;
+		}
+	}
+	spin_unlock_irqrestore(&core->ic_dev.sched_lock, flags);
+	return count;
+}
+
+static const struct proc_ops dwe_procfs_ops = {
+	.proc_open = dwe_procfs_open,
+	.proc_release = seq_release,
+	.proc_read = seq_read,
+	.proc_write = dwe_procfs_write,
+	.proc_lseek = seq_lseek,
+};
+
 int dwe_hw_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -340,6 +464,8 @@ int dwe_hw_probe(struct platform_device *pdev)
 	int irq;
 	int rc, i, index;
 	int dev_id;
+	u32 cpu, val;
+	struct dwe_sched_queue *sq;
 
 	dev_info(dev, "Probing vvcam dwe driver\n");
 
@@ -437,16 +563,47 @@ int dwe_hw_probe(struct platform_device *pdev)
 		dwe_dev->irq = irq;
 
 		dwe_dev->core = dwe_devcore_init(dwe_dev, mem_res);
-		if (dev_id == 0)
+		if (!dwe_dev->core) {
+			rc = -ENOMEM;
+			goto dewarp_core_deinit;
+		}
+		if (dev_id == 0) {
 			dwe_dev->sd.fwnode = of_fwnode_handle(pdev->dev.of_node);
-		else
+			dwe_dev->core->ic_dev.irq_thread =
+				fwnode_property_read_bool(dwe_dev->sd.fwnode,
+						"vsi,irq-thread");
+			if (fwnode_property_read_u32(dwe_dev->sd.fwnode,
+					"vsi,irq-cpu", &cpu) ||
+					cpu >= nr_cpu_ids || !cpu_possible(cpu))
+				dwe_dev->irq_cpu = -1;
+			else
+				dwe_dev->irq_cpu = cpu;
+		} else
 			dwe_dev->sd.fwnode = &dwe_dev->fwnode;
 
+		/*
+		 * This node's frames per turn and head-of-line deadline. The
+		 * core and its queues are shared, so only touch our own.
+		 */
+		sq = &dwe_dev->core->ic_dev.sq[dwe_dev->id];
+		if (!fwnode_property_read_u32(dwe_dev->sd.fwnode,
+				"vsi,sched-weight", &val))
+			sq->weight = max_t(u32, val, 1);
+		if (!fwnode_property_read_u32(dwe_dev->sd.fwnode,
+				"vsi,sched-deadline-us", &val))
+			sq->deadline_ns = (u64)val * NSEC_PER_USEC;
+
 		rc = v4l2_async_register_subdev(&dwe_dev->sd);
 		if (rc < 0)
 			goto dewarp_core_deinit;
 		g_dwe_subdev[dev_id] = &dwe_dev->sd;
 	}
+
+	pdwe_dev[0]->core->pde = proc_create_data("vsidwe", 0444, NULL,
+			&dwe_procfs_ops, pdwe_dev[0]->core);
+	if (!pdwe_dev[0]->core->pde)
+		pr_warn("create dwe proc fs failed.\n");
+
 	pm_runtime_enable(&pdev->dev);
 	dev_info(dev, "Probe: Success\n");
 	return 0;
@@ -482,6 +639,7 @@ int dwe_hw_remove(struct platform_device *pdev)
 
 	pr_info("enter %s\n", __func__);
 	pm_runtime_disable(&pdev->dev);
+	proc_remove(pdwe_dev[0]->core->pde);
 	dwe_devcore_deinit(pdwe_dev[0]);
 
 	for (dev_id = 0; dev_id < DEWARP_NODE_NUM; dev_id++) {
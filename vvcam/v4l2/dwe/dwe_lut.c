@@ -0,0 +1,457 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#include <linux/dma-mapping.h>
+#include <linux/fixp-arith.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include "dwe_driver.h"
+#include "dwe_ioctl.h"
+
+/*
+ * The map is a grid of source positions, one vertex every DWE_LUT_BLOCK
+ * output pixels plus the closing row and column. Each vertex packs the
+ * source x in bits 15:0 and y in bits 31:16 as unsigned 12.4 fixed point.
+ */
+#define DWE_LUT_BLOCK		(16)
+#define DWE_LUT_MAX_SRC		(4096)
+#define DWE_LUT_MAX_DST		(0x1fff)
+
+#define DWE_LUT_ONE		(1LL << 16)	/* 1.0 in the Q16 math below */
+#define DWE_LUT_PI		(205887LL)	/* pi, Q16 */
+#define DWE_LUT_TAN_MAX		(256LL << 16)	/* clamp for rays at the horizon */
+#define DWE_LUT_RAY_SHIFT	(8)		/* view rays are Q8 pixels */
+#define DWE_LUT_MAX_FOCAL	(1ULL << 32)	/* 65536 px, Q16, keeps the math in s64 */
+#define DWE_LUT_TWOPI		(36000)		/* centidegrees for fixp_sin32_rad */
+
+struct dwe_lut_entry {
+	struct list_head list;
+	struct dwe_lens_view view;
+	u32 map_w, map_h;
+	size_t size;
+	u32 *map;
+	dma_addr_t dma;
+};
+
+/* atan(2^-i), Q16 radians */
+static const s32 dwe_lut_atan[] = {
+	51472, 30386, 16055, 8150, 4091, 2047, 1024, 512,
+	256, 128, 64, 32, 16, 8, 4, 2,
+};
+
+/* CORDIC atan2 for y >= 0, Q16 radians in [0, pi] */
+static s64 dwe_lut_atan2(s64 y, s64 x)
+{
+	bool back = x < 0;
+	s64 a = 0, t;
+	int i;
+
+	if (back)
+		x = -x;
+	x <<= 12;
+	y <<= 12;
+	for (i = 0; i < ARRAY_SIZE(dwe_lut_atan); i++) {
+		if (y > 0) {
+			t = x + (y >> i);
+			y -= x >> i;
+			a += dwe_lut_atan[i];
+		} else {
+			t = x - (y >> i);
+			y += x >> i;
+			a -= dwe_lut_atan[i];
+		}
+		x = t;
+	}
+	return back ? DWE_LUT_PI - a : a;
+}
+
+/* image radius in Q4 pixels of a ray with sin/cos (Q16) off the lens axis */
+static s64 dwe_lut_radius(const struct dwe_lens_view *v, s64 s, s64 c)
+{
+	s64 t;
+
+	switch (v->model) {
+	case DWE_LENS_EQUIDISTANT:
+		t = dwe_lut_atan2(s, c);
+		break;
+	case DWE_LENS_EQUISOLID:
+		/* 2 sin(theta / 2) == sqrt(2 (1 - cos(theta))) */
+		t = int_sqrt64((u64)(2 * (DWE_LUT_ONE - c)) << 16);
+		break;
+	case DWE_LENS_STEREOGRAPHIC:
+		/* 2 tan(theta / 2) == 2 sin(theta) / (1 + cos(theta)) */
+		t = div64_s64(s << 17, max_t(s64, DWE_LUT_ONE + c, 1));
+		break;
+	case DWE_LENS_ORTHOGRAPHIC:
+		t = s;
+		break;
+	default:
+		t = div64_s64(s << 16, max_t(s64, c, 1));
+		break;
+	}
+	t = min_t(s64, t, DWE_LUT_TAN_MAX);
+	return ((s64)v->focal * t) >> 28;
+}
+
+static void dwe_lut_rotation(const struct dwe_lens_view *v, s64 r[3][3])
+{
+	u32 pan = ((v->pan / 10) % DWE_LUT_TWOPI + DWE_LUT_TWOPI) % DWE_LUT_TWOPI;
+	u32 tilt = ((v->tilt / 10) % DWE_LUT_TWOPI + DWE_LUT_TWOPI) % DWE_LUT_TWOPI;
+	s64 sp = fixp_sin32_rad(pan, DWE_LUT_TWOPI);
+	s64 cp = fixp_cos32_rad(pan, DWE_LUT_TWOPI);
+	s64 st = fixp_sin32_rad(tilt, DWE_LUT_TWOPI);
+	s64 ct = fixp_cos32_rad(tilt, DWE_LUT_TWOPI);
+
+	/* tilt about x then pan about y, Q31 */
+	r[0][0] = cp;
+	r[0][1] = (sp * st) >> 31;
+	r[0][2] = (sp * ct) >> 31;
+	r[1][0] = 0;
+	r[1][1] = ct;
+	r[1][2] = -st;
+	r[2][0] = -sp;
+	r[2][1] = (cp * st) >> 31;
+	r[2][2] = (cp * ct) >> 31;
+}
+
+/*
+ * Fixed point map generation. The view ray of every vertex is affine in
+ * the column, so the inner loop is a multiply-add per component followed
+ * by the lens projection, with no state carried between vertices.
+ */
+static void dwe_lut_generate(const struct dwe_lens_view *v, u32 *map,
+				u32 map_w, u32 map_h)
+{
+	s64 r[3][3], row[3], step[3], ray[3];
+	s64 x0, y, z, rho2, rho, n, s, c, rad, sx, sy;
+	s64 cx = v->cx ? v->cx >> 12 : (s64)v->src_w << 3;
+	s64 cy = v->cy ? v->cy >> 12 : (s64)v->src_h << 3;
+	s64 max_x = (s64)(v->src_w - 1) << 4;
+	s64 max_y = (s64)(v->src_h - 1) << 4;
+	u64 zoom = v->zoom ? v->zoom : 1 << 16;
+	u32 i, j, k;
+
+	dwe_lut_rotation(v, r);
+	x0 = -((s64)v->dst_w << (DWE_LUT_RAY_SHIFT - 1));
+	z = (v->focal * zoom) >> (32 - DWE_LUT_RAY_SHIFT);
+	for (k = 0; k < 3; k++)
+		step[k] = r[k][0] * (DWE_LUT_BLOCK << DWE_LUT_RAY_SHIFT);
+
+	for (j = 0; j < map_h; j++) {
+		y = ((s64)j * DWE_LUT_BLOCK << DWE_LUT_RAY_SHIFT) -
+			((s64)v->dst_h << (DWE_LUT_RAY_SHIFT - 1));
+		for (k = 0; k < 3; k++)
+			row[k] = r[k][0] * x0 + r[k][1] * y + r[k][2] * z;
+
+		for (i = 0; i < map_w; i++) {
+			for (k = 0; k < 3; k++)
+				ray[k] = (row[k] + step[k] * i) >> 31;
+
+			rho2 = ray[0] * ray[0] + ray[1] * ray[1];
+			rho = int_sqrt64(rho2);
+			n = int_sqrt64(rho2 + ray[2] * ray[2]);
+			if (rho == 0 || n == 0) {
+				sx = cx;
+				sy = cy;
+			} else {
+				s = div64_s64(rho << 16, n);
+				c = div64_s64(ray[2] << 16, n);
+				rad = dwe_lut_radius(v, s, c);
+				sx = cx + div64_s64(rad * ray[0], rho);
+				sy = cy + div64_s64(rad * ray[1], rho);
+			}
+			sx = clamp_t(s64, sx, 0, max_x);
+			sy = clamp_t(s64, sy, 0, max_y);
+			map[j * map_w + i] = (u32)sx | ((u32)sy << 16);
+		}
+	}
+}
+
+static int dwe_lut_check(const struct dwe_lut_gen *gen)
+{
+	const struct dwe_lens_view *v = &gen->view;
+	u64 zoom = v->zoom ? v->zoom : 1 << 16;
+
+	if (gen->port >= MAX_CFG_NUM || v->model >= DWE_LENS_MODEL_NUM ||
+	    !v->focal || !v->src_w || !v->src_h || !v->dst_w || !v->dst_h ||
+	    v->src_w > DWE_LUT_MAX_SRC || v->src_h > DWE_LUT_MAX_SRC ||
+	    v->dst_w > DWE_LUT_MAX_DST || v->dst_h > DWE_LUT_MAX_DST ||
+	    (((u64)v->focal * zoom) >> 16) >= DWE_LUT_MAX_FOCAL)
+		return -EINVAL;
+	return 0;
+}
+
+/* a map is pinned while a stream points at it or the core last ran it */
+static bool dwe_lut_in_use(struct dwe_devcore *core, dma_addr_t dma)
+{
+	struct dwe_ic_dev *dev = &core->ic_dev;
+	unsigned long flags;
+	bool used = false;
+	int i, j;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	for (i = 0; i < MAX_DWE_NUM; i++)
+		for (j = 0; j < MAX_CFG_NUM; j++)
+			if (dev->dist_map[i][j] == dma || dev->curmap[i][j] == dma)
+				used = true;
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+	return used;
+}
+
+static void dwe_lut_free(struct dwe_lut_cache *lut, struct dwe_lut_entry *e)
+{
+	list_del(&e->list);
+	dma_free_coherent(lut->dev, e->size, e->map, e->dma);
+	kfree(e);
+	lut->num--;
+}
+
+/* drop least recently used maps nobody points at, caller holds lut->lock */
+static void dwe_lut_trim(struct dwe_devcore *core)
+{
+	struct dwe_lut_cache *lut = &core->lut;
+	struct dwe_lut_entry *e, *prev;
+
+	list_for_each_entry_safe_reverse(e, prev, &lut->lru, list) {
+		if (lut->num <= DWE_LUT_CACHE_NUM)
+			break;
+		if (dwe_lut_in_use(core, e->dma))
+			continue;
+		dwe_lut_free(lut, e);
+		lut->evictions++;
+	}
+}
+
+static struct dwe_lut_entry *dwe_lut_find(struct dwe_lut_cache *lut,
+				const struct dwe_lens_view *view)
+{
+	struct dwe_lut_entry *e;
+
+	list_for_each_entry(e, &lut->lru, list)
+		if (!memcmp(&e->view, view, sizeof(*view)))
+			return e;
+	return NULL;
+}
+
+/* find or build the map for a view, caller holds lut->lock */
+static struct dwe_lut_entry *dwe_lut_get(struct dwe_devcore *core,
+				const struct dwe_lens_view *view, bool *hit)
+{
+	struct dwe_lut_cache *lut = &core->lut;
+	struct dwe_lut_entry *e;
+	u64 start;
+
+	e = dwe_lut_find(lut, view);
+	if (e) {
+		list_move(&e->list, &lut->lru);
+		lut->hits++;
+		*hit = true;
+		return e;
+	}
+
+	*hit = false;
+	e = kzalloc(sizeof(*e), GFP_KERNEL);
+	if (!e)
+		return NULL;
+	e->view = *view;
+	e->map_w = DIV_ROUND_UP(view->dst_w, DWE_LUT_BLOCK) + 1;
+	e->map_h = DIV_ROUND_UP(view->dst_h, DWE_LUT_BLOCK) + 1;
+	e->size = e->map_w * e->map_h * sizeof(u32);
+	e->map = dma_alloc_coherent(lut->dev, e->size, &e->dma, GFP_KERNEL);
+	if (!e->map) {
+		kfree(e);
+		return NULL;
+	}
+
+	start = ktime_get_ns();
+	dwe_lut_generate(view, e->map, e->map_w, e->map_h);
+	vvlat_hist_add(&lut->gen, ktime_get_ns() - start);
+
+	list_add(&e->list, &lut->lru);
+	lut->num++;
+	lut->misses++;
+	return e;
+}
+
+/* the tasklet picks dist_map up when it starts the next frame of the stream */
+static void dwe_lut_swap(struct dwe_devcore *core, int id, u32 port,
+				dma_addr_t dma)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&core->ic_dev.irqlock, flags);
+	core->ic_dev.dist_map[id][port] = dma;
+	spin_unlock_irqrestore(&core->ic_dev.irqlock, flags);
+}
+
+static void dwe_lut_work(struct work_struct *work)
+{
+	struct dwe_lut_cache *lut =
+			container_of(work, struct dwe_lut_cache, work);
+	struct dwe_devcore *core = container_of(lut, struct dwe_devcore, lut);
+	struct dwe_lut_entry *e;
+	struct dwe_lut_gen gen;
+	unsigned long flags;
+	bool hit;
+	int id;
+
+	for (id = 0; id < MAX_DWE_NUM; id++) {
+		spin_lock_irqsave(&lut->req_lock, flags);
+		if (!lut->pending[id]) {
+			spin_unlock_irqrestore(&lut->req_lock, flags);
+			continue;
+		}
+		gen = lut->req[id];
+		spin_unlock_irqrestore(&lut->req_lock, flags);
+
+		mutex_lock(&lut->lock);
+		e = dwe_lut_get(core, &gen.view, &hit);
+		spin_lock_irqsave(&lut->req_lock, flags);
+		/* a newer request for the stream supersedes this one */
+		if (lut->pending[id] &&
+		    !memcmp(&lut->req[id], &gen, sizeof(gen))) {
+			lut->pending[id] = false;
+			if (e && !(gen.flags & DWE_LUT_PRELOAD))
+				dwe_lut_swap(core, id, gen.port, e->dma);
+		}
+		spin_unlock_irqrestore(&lut->req_lock, flags);
+		dwe_lut_trim(core);
+		mutex_unlock(&lut->lock);
+		if (!e)
+			pr_err("failed to generate dwe%d lut.\n", id);
+	}
+}
+
+long dwe_lut_gen(struct dwe_device *dwe, void *args)
+{
+	struct dwe_lut_cache *lut = &dwe->core->lut;
+	struct dwe_lut_entry *e;
+	struct dwe_lut_gen gen;
+	unsigned long flags;
+	bool hit;
+	int ret;
+
+	viv_check_retval(copy_from_user(&gen, args, sizeof(gen)));
+	ret = dwe_lut_check(&gen);
+	if (ret)
+		return ret;
+
+	gen.status = 0;
+	gen.addr = 0;
+	gen.map_w = DIV_ROUND_UP(gen.view.dst_w, DWE_LUT_BLOCK) + 1;
+	gen.map_h = DIV_ROUND_UP(gen.view.dst_h, DWE_LUT_BLOCK) + 1;
+
+	mutex_lock(&lut->lock);
+	/* in the background only a cache hit is served inline */
+	if ((gen.flags & DWE_LUT_ASYNC) && !dwe_lut_find(lut, &gen.view)) {
+		spin_lock_irqsave(&lut->req_lock, flags);
+		lut->req[dwe->id] = gen;
+		lut->pending[dwe->id] = true;
+		spin_unlock_irqrestore(&lut->req_lock, flags);
+		mutex_unlock(&lut->lock);
+		queue_work(system_unbound_wq, &lut->work);
+		gen.status = DWE_LUT_PENDING;
+		viv_check_retval(copy_to_user(args, &gen, sizeof(gen)));
+		return 0;
+	}
+
+	/* an older background request must not land after this one */
+	if (!(gen.flags & DWE_LUT_PRELOAD)) {
+		spin_lock_irqsave(&lut->req_lock, flags);
+		lut->pending[dwe->id] = false;
+		spin_unlock_irqrestore(&lut->req_lock, flags);
+	}
+
+	e = dwe_lut_get(dwe->core, &gen.view, &hit);
+	if (!e) {
+		mutex_unlock(&lut->lock);
+		return -ENOMEM;
+	}
+	if (!(gen.flags & DWE_LUT_PRELOAD))
+		dwe_lut_swap(dwe->core, dwe->id, gen.port, e->dma);
+	gen.status = hit ? DWE_LUT_HIT : 0;
+	gen.addr = e->dma;
+	dwe_lut_trim(dwe->core);
+	mutex_unlock(&lut->lock);
+
+	viv_check_retval(copy_to_user(args, &gen, sizeof(gen)));
+	return 0;
+}
+
+void dwe_lut_init(struct dwe_devcore *core, struct device *dev)
+{
+	struct dwe_lut_cache *lut = &core->lut;
+
+	lut->dev = dev;
+	mutex_init(&lut->lock);
+	INIT_LIST_HEAD(&lut->lru);
+	spin_lock_init(&lut->req_lock);
+	INIT_WORK(&lut->work, dwe_lut_work);
+}
+
+void dwe_lut_deinit(struct dwe_devcore *core)
+{
+	struct dwe_lut_cache *lut;
+	struct dwe_lut_entry *e, *next;
+
+	if (!core)
+		return;
+
+	lut = &core->lut;
+	cancel_work_sync(&lut->work);
+	mutex_lock(&lut->lock);
+	list_for_each_entry_safe(e, next, &lut->lru, list)
+		dwe_lut_free(lut, e);
+	mutex_unlock(&lut->lock);
+}
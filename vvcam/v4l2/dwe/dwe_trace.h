@@ -0,0 +1,101 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vvcam_dwe
+
+#if !defined(_DWE_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _DWE_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(dwe_start,
+	TP_PROTO(int index, u64 src, u64 dst),
+	TP_ARGS(index, src, dst),
+	TP_STRUCT__entry(
+		__field(int, index)
+		__field(u64, src)
+		__field(u64, dst)
+	),
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->src = src;
+		__entry->dst = dst;
+	),
+	TP_printk("dwe%d src=0x%llx dst=0x%llx",
+		__entry->index, __entry->src, __entry->dst)
+);
+
+TRACE_EVENT(dwe_done,
+	TP_PROTO(int index, u32 status, u64 latency_ns),
+	TP_ARGS(index, status, latency_ns),
+	TP_STRUCT__entry(
+		__field(int, index)
+		__field(u32, status)
+		__field(u64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->status = status;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("dwe%d status=0x%x latency_ns=%llu",
+		__entry->index, __entry->status, __entry->latency_ns)
+);
+
+#endif /* _DWE_TRACE_H_ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dwe_trace
+#include <trace/define_trace.h>
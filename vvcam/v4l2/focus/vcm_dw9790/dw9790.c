@@ -52,12 +52,15 @@
  *****************************************************************************/
 #include <linux/acpi.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/i2c.h>
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
+#include <media/v4l2-event.h>
 #include "vvfocus.h"
 
 #define DW9790_MIN_FOCUS_POS 0
@@ -69,6 +72,30 @@
 #define DW9790_LSB_ADDR 0x01
 #define DW9790_INIT_ADDR 0x02
 
+#define DW9790_STEP_US 5000     /* half period of a ~100Hz actuator */
+#define DW9790_SETTLE_US 8000
+
+/*
+ * A move in progress. The hrtimer only kicks the work item, which does
+ * the i2c writes under lock; next_ns lets a work item queued for a move
+ * that has since been replaced find nothing due and return.
+ */
+struct dw9790_move {
+    struct hrtimer timer;
+    struct work_struct work;
+    bool active;
+    int32_t pos[VVFOCUS_MAX_STEPS];
+    uint32_t nstep;
+    uint32_t step;
+    uint64_t step_ns;
+    uint64_t settle_ns;
+    uint64_t start_ns;
+    uint64_t next_ns;
+    uint32_t frame_id;
+    uint32_t frame_us;
+    uint32_t seq;
+};
+
 struct dw9790_device {
     uint32_t id;
     char name[16];
@@ -77,6 +104,7 @@ struct dw9790_device {
     struct v4l2_subdev sd;
     struct mutex lock;
     int32_t cur_pos;
+    struct dw9790_move move;
 };
 
 static inline struct dw9790_device *sd_to_dw9790_device(struct v4l2_subdev *subdev)
@@ -167,11 +195,24 @@ static int dw9790_get_range(struct dw9790_device *dw9790_dev, struct vvfocus_ran
     return 0;
 }
 
-static int dw9790_set_pos(struct dw9790_device *dw9790_dev, struct vvfocus_pos_s *pfocus_pos)
+static int dw9790_write_pos(struct dw9790_device *dw9790_dev, int32_t len_pos)
 {
     int ret = 0;
-    int32_t len_pos;
     uint8_t data[2];
+
+    data[0] = (len_pos & 0x3fc) >> 2;
+    data[1] = (len_pos & 0x03) << 6;
+    ret = dw9790_i2c_write(dw9790_dev, DW9790_MSB_ADDR, data, 2);
+    if (ret < 0)
+        dev_err(dw9790_dev->sd.dev, "%s set ctrl failed\n", __func__);
+    else
+        dw9790_dev->cur_pos = len_pos;
+    return ret;
+}
+
+static int dw9790_set_pos(struct dw9790_device *dw9790_dev, struct vvfocus_pos_s *pfocus_pos)
+{
+    int32_t len_pos;
     if (pfocus_pos->mode == VVFOCUS_MODE_ABSOLUTE) {
         len_pos = pfocus_pos->pos;
     } else {
@@ -182,14 +223,134 @@ static int dw9790_set_pos(struct dw9790_device *dw9790_dev, struct vvfocus_pos_s
         (len_pos < DW9790_MIN_FOCUS_POS))
         return -1;
 
-    data[0] = (len_pos & 0x3fc) >> 2;
-    data[1] = (len_pos & 0x03) << 6;
-    ret = dw9790_i2c_write(dw9790_dev, DW9790_MSB_ADDR, data, 2);
-    if (ret < 0)
-        dev_err(dw9790_dev->sd.dev, "%s set ctrl failed\n", __func__);
-    else
-        dw9790_dev->cur_pos = len_pos;
-    return ret;
+    /* a direct write ends any move in progress */
+    dw9790_dev->move.active = false;
+    return dw9790_write_pos(dw9790_dev, len_pos);
+}
+
+static void dw9790_post_settled(struct dw9790_device *dw9790_dev, uint64_t now)
+{
+    struct dw9790_move *move = &dw9790_dev->move;
+    struct vvfocus_settled_s *settled;
+    struct v4l2_event event;
+    uint64_t frame_ns = (uint64_t)move->frame_us * NSEC_PER_USEC;
+
+    if (!dw9790_dev->sd.devnode)
+        return;
+
+    memset(&event, 0, sizeof(event));
+    event.type = VVFOCUS_EVENT_SETTLED;
+    settled = (struct vvfocus_settled_s *)event.u.data;
+    settled->seq = move->seq;
+    settled->pos = dw9790_dev->cur_pos;
+    settled->frame_id = move->frame_id;
+    if (frame_ns)
+        settled->frame_id += (uint32_t)div64_u64(now - move->start_ns +
+                frame_ns - 1, frame_ns);
+    settled->move_us = (uint32_t)div_u64(now - move->start_ns, NSEC_PER_USEC);
+    v4l2_event_queue(dw9790_dev->sd.devnode, &event);
+}
+
+/* runs the step that is due, called with lock held */
+static void dw9790_move_step(struct dw9790_device *dw9790_dev)
+{
+    struct dw9790_move *move = &dw9790_dev->move;
+    uint64_t now = ktime_get_ns();
+
+    if (!move->active || now < move->next_ns)
+        return;
+
+    if (move->step == move->nstep) {
+        move->active = false;
+        dw9790_post_settled(dw9790_dev, now);
+        return;
+    }
+
+    if (dw9790_write_pos(dw9790_dev, move->pos[move->step]) < 0) {
+        move->active = false;
+        return;
+    }
+    move->step++;
+    move->next_ns = now + (move->step < move->nstep ?
+            move->step_ns : move->settle_ns);
+    hrtimer_start(&move->timer, ns_to_ktime(move->next_ns - now),
+            HRTIMER_MODE_REL);
+}
+
+static void dw9790_move_work(struct work_struct *work)
+{
+    struct dw9790_move *move = container_of(work, struct dw9790_move, work);
+    struct dw9790_device *dw9790_dev =
+            container_of(move, struct dw9790_device, move);
+
+    mutex_lock(&dw9790_dev->lock);
+    dw9790_move_step(dw9790_dev);
+    mutex_unlock(&dw9790_dev->lock);
+}
+
+static enum hrtimer_restart dw9790_move_timer(struct hrtimer *timer)
+{
+    struct dw9790_move *move = container_of(timer, struct dw9790_move, timer);
+
+    queue_work(system_highpri_wq, &move->work);
+    return HRTIMER_NORESTART;
+}
+
+/*
+ * The ringing profile is a zero vibration input shaper: steps of 1/2,
+ * 1/2 or 1/4, 1/2, 1/4 of the travel, half a resonance period apart,
+ * cancel the oscillation each step excites.
+ */
+static int dw9790_set_move(struct dw9790_device *dw9790_dev, struct vvfocus_move_s *req)
+{
+    struct dw9790_move *move = &dw9790_dev->move;
+    static const uint32_t zv[2][3] = { {1, 2, 2}, {1, 3, 4} };
+    int32_t from = dw9790_dev->cur_pos;
+    int32_t to, travel;
+    uint32_t i, n;
+
+    to = req->mode == VVFOCUS_MODE_ABSOLUTE ? req->pos : from + req->pos;
+    if ((to > DW9790_MAX_FOCUS_POS) || (to < DW9790_MIN_FOCUS_POS))
+        return -EINVAL;
+    travel = to - from;
+
+    switch (req->profile) {
+    case VVFOCUS_PROFILE_DIRECT:
+        n = 1;
+        move->pos[0] = to;
+        break;
+    case VVFOCUS_PROFILE_LINEAR:
+        n = clamp_t(uint32_t, req->steps, 1, VVFOCUS_MAX_STEPS);
+        for (i = 0; i < n; i++)
+            move->pos[i] = from + travel * (int32_t)(i + 1) / (int32_t)n;
+        break;
+    case VVFOCUS_PROFILE_RINGING:
+        n = clamp_t(uint32_t, req->steps, 2, 3);
+        for (i = 0; i < n; i++)
+            move->pos[i] = from + travel * (int32_t)zv[n - 2][i] /
+                    (int32_t)zv[n - 2][n - 1];
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    hrtimer_cancel(&move->timer);
+    move->nstep = n;
+    move->step = 0;
+    move->step_ns = (uint64_t)(req->step_us ? req->step_us : DW9790_STEP_US) *
+            NSEC_PER_USEC;
+    move->settle_ns = (uint64_t)(req->settle_us ? req->settle_us :
+            DW9790_SETTLE_US) * NSEC_PER_USEC;
+    move->frame_id = req->frame_id;
+    move->frame_us = req->frame_us;
+    move->start_ns = ktime_get_ns();
+    move->next_ns = 0;
+    move->seq++;
+    move->active = true;
+    req->seq = move->seq;
+
+    dw9790_move_step(dw9790_dev);
+    return move->active ? 0 : -EIO;
 }
 
 static int dw9790_get_pos(struct dw9790_device *dw9790_dev, struct vvfocus_pos_s *ppos)
@@ -208,6 +369,7 @@ static long dw9790_priv_ioctl(struct v4l2_subdev *sd,
     struct vvfocus_reg_s focus_reg;
     struct vvfocus_range_s focus_range;
     struct vvfocus_pos_s focus_pos;
+    struct vvfocus_move_s focus_move;
 
     if (!arg)
         return -ENOMEM;
@@ -229,6 +391,15 @@ static long dw9790_priv_ioctl(struct v4l2_subdev *sd,
             ret = copy_from_user(&focus_pos, arg, sizeof(struct vvfocus_pos_s));
             ret |= dw9790_set_pos(dw9790_dev, &focus_pos);
             break;
+        case VVFOCUSIOC_SET_MOVE:
+            if (copy_from_user(&focus_move, arg, sizeof(focus_move))) {
+                ret = -EFAULT;
+                break;
+            }
+            ret = dw9790_set_move(dw9790_dev, &focus_move);
+            if (!ret && copy_to_user(arg, &focus_move, sizeof(focus_move)))
+                ret = -EFAULT;
+            break;
         case VVFOCUSIOC_GET_REG:
             ret = copy_from_user(&focus_reg, arg, sizeof(struct vvfocus_reg_s));
             ret |= dw9790_i2c_read(dw9790_dev, focus_reg.addr, (uint8_t *)&focus_reg.value);
@@ -247,8 +418,18 @@ static long dw9790_priv_ioctl(struct v4l2_subdev *sd,
     return ret;
 }
 
+static int dw9790_subscribe_event(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+                                  struct v4l2_event_subscription *sub)
+{
+    if (sub->type != VVFOCUS_EVENT_SETTLED)
+        return -EINVAL;
+    return v4l2_event_subscribe(fh, sub, 4, NULL);
+}
+
 static struct v4l2_subdev_core_ops adw9790_core_ops = {
 	.ioctl = dw9790_priv_ioctl,
+	.subscribe_event = dw9790_subscribe_event,
+	.unsubscribe_event = v4l2_event_subdev_unsubscribe,
 };
 
 static const struct v4l2_subdev_ops dw9790_ops = {
@@ -290,6 +471,8 @@ static int dw9790_init_controls(struct dw9790_device *dw9790_dev)
     struct v4l2_ctrl_handler *handler = &dw9790_dev->ctrls_vcm;
     const struct v4l2_ctrl_ops *ops = &dw9790_vcm_ctrl_ops;
     v4l2_ctrl_handler_init(handler, 1);
+    /* s_ctrl moves the lens like the ioctls and the move work */
+    handler->lock = &dw9790_dev->lock;
     dw9790_dev->focus = v4l2_ctrl_new_std(handler, ops, V4L2_CID_FOCUS_ABSOLUTE,
 		DW9790_MIN_FOCUS_POS, DW9790_MAX_FOCUS_POS, DW9790_FOCUS_STEPS, DW9790_FOCUS_DEF);
     if (handler->error)
@@ -333,10 +516,22 @@ static int dw9790_probe(struct i2c_client *client,
     memcpy(dw9790_dev->name, dev->of_node->name, strlen(dev->of_node->name));
 
     v4l2_i2c_subdev_init(&dw9790_dev->sd, client, &dw9790_ops);
-    dw9790_dev->sd.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
+    dw9790_dev->sd.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE |
+            V4L2_SUBDEV_FL_HAS_EVENTS;
 	dw9790_dev->sd.internal_ops = &dw9790_int_ops;
 	dw9790_dev->sd.entity.function = MEDIA_ENT_F_LENS;
 
+    /* the controls and the subdev ioctls use these once registered */
+    mutex_init(&dw9790_dev->lock);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+    hrtimer_setup(&dw9790_dev->move.timer, dw9790_move_timer,
+            CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+    hrtimer_init(&dw9790_dev->move.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    dw9790_dev->move.timer.function = dw9790_move_timer;
+#endif
+    INIT_WORK(&dw9790_dev->move.work, dw9790_move_work);
+
     ret = dw9790_init_controls(dw9790_dev);
     if (ret < 0)
         goto err_cleanup;
@@ -354,15 +549,19 @@ static int dw9790_probe(struct i2c_client *client,
     ret = dw9790_init(dw9790_dev);
     if (ret < 0) {
         dev_err(&client->dev, "%s failed to power on dw9790 %d\n", __func__, ret);
-        goto err_cleanup;
+        goto err_unregister;
     }
-    mutex_init(&dw9790_dev->lock);
-
     return 0;
 
+err_unregister:
+    pm_runtime_disable(&client->dev);
+    v4l2_async_unregister_subdev(&dw9790_dev->sd);
+    hrtimer_cancel(&dw9790_dev->move.timer);
+    cancel_work_sync(&dw9790_dev->move.work);
 err_cleanup:
     v4l2_ctrl_handler_free(&dw9790_dev->ctrls_vcm);
     media_entity_cleanup(&dw9790_dev->sd.entity);
+    mutex_destroy(&dw9790_dev->lock);
     return ret;
 }
 
@@ -375,6 +574,11 @@ static void dw9790_remove(struct i2c_client *client)
     struct v4l2_subdev *sd = i2c_get_clientdata(client);
     struct dw9790_device *dw9790_dev = sd_to_dw9790_device(sd);
 
+    mutex_lock(&dw9790_dev->lock);
+    dw9790_dev->move.active = false;
+    mutex_unlock(&dw9790_dev->lock);
+    hrtimer_cancel(&dw9790_dev->move.timer);
+    cancel_work_sync(&dw9790_dev->move.work);
     v4l2_async_unregister_subdev(&dw9790_dev->sd);
     v4l2_ctrl_handler_free(&dw9790_dev->ctrls_vcm);
     media_entity_cleanup(&dw9790_dev->sd.entity);
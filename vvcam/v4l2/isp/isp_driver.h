@@ -56,6 +56,38 @@
 #include "ic_dev.h"
 #include "video/vvbuf.h"
 
+struct isp_stats_node {
+	struct video_device vdev;
+	struct vb2_queue queue;
+	struct media_pad pad;
+	struct mutex mlock;
+	spinlock_t lock;	/* protects buf_list */
+	struct list_head buf_list;
+	u64 drop_cnt;
+};
+
+struct isp_rdma_buffer;
+
+struct isp_rdma_node {
+	struct video_device vdev;
+	struct vb2_queue queue;
+	struct media_pad pad;
+	struct mutex mlock;
+	spinlock_t lock;	/* protects buf_list, active and streaming */
+	struct list_head buf_list;
+	struct isp_rdma_buffer *active;	/* job the read path is working on */
+	wait_queue_head_t idle_wq;
+	bool streaming;
+	struct v4l2_pix_format_mplane fmt;
+	u32 type;	/* ISP_PICBUF_TYPE_* of fmt */
+	u64 start_frame;	/* mp_end_frame when the active job started */
+	u64 start_ns;
+	u64 job_cnt;
+	u64 requeue_cnt;
+	u64 abort_cnt;
+	struct vvlat_hist lat;
+};
+
 struct isp_device {
 	struct vvbuf_ctx bctx;
 	/* Driver private data */
@@ -71,14 +103,25 @@ struct isp_device {
 	struct media_pad pads[ISP_PADS_NUM];
 	int state;
 	int irq;
+	int irq_cpu;
 	int num_domains;
 	int id;
 	struct mutex mlock;
 	struct proc_dir_entry *pde;
+	struct isp_stats_node stats;
+	struct isp_rdma_node rdma;
 };
 struct isp_pd {
 	struct device    **pd_dev;
 	struct device_link  **pd_dev_link;
 	int    num_domains;
 };
+int isp_stats_register(struct isp_device *isp_dev);
+void isp_stats_unregister(struct isp_device *isp_dev);
+void isp_stats_done(struct isp_ic_dev *dev, struct isp_stats_frame *frame);
+int isp_rdma_register(struct isp_device *isp_dev);
+void isp_rdma_unregister(struct isp_device *isp_dev);
+void isp_rdma_kick(struct isp_device *isp_dev);
+void isp_rdma_suspend(struct isp_device *isp_dev);
+void isp_rdma_done(struct isp_ic_dev *dev, u64 frame_id);
 #endif /* _ISP_DRIVER_H_ */
@@ -65,6 +65,10 @@
 #include "isp_ioctl.h"
 #include "mrv_all_bits.h"
 #include "viv_video_kevent.h"
+#include "vvsensor.h"
+
+#define CREATE_TRACE_POINTS
+#include "isp_trace.h"
 
 struct clk *clk_isp;
 
@@ -149,10 +153,93 @@ int isp_set_stream(struct v4l2_subdev *sd, int enable)
 
 	if (!enable) {
 		isp_dev->state &= ~STATE_STREAM_STARTED;
-	} else
+		isp_ae_flush(&isp_dev->ic_dev);
+		isp_rdma_suspend(isp_dev);
+	} else {
 		isp_dev->state |= STATE_STREAM_STARTED;
+		isp_rdma_kick(isp_dev);
+	}
+	return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+/* walk upstream from the sink, through the csi, to the sensor */
+static struct v4l2_subdev *__isp_find_sensor(struct isp_device *isp_dev)
+{
+	struct media_entity *entity = &isp_dev->sd.entity;
+	struct media_pad *remote_pad;
+	int depth, i;
+
+	for (depth = 0; depth < 4; depth++) {
+		remote_pad = NULL;
+		for (i = 0; i < entity->num_pads && !remote_pad; i++) {
+			if (!(entity->pads[i].flags & MEDIA_PAD_FL_SINK))
+				continue;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 19, 0)
+			remote_pad = media_entity_remote_pad(&entity->pads[i]);
+#else
+			remote_pad = media_pad_remote_pad_first(&entity->pads[i]);
+#endif
+			/* the rdma video node feeds a sink too */
+			if (remote_pad &&
+			    !is_media_entity_v4l2_subdev(remote_pad->entity))
+				remote_pad = NULL;
+		}
+		if (!remote_pad)
+			return NULL;
+		entity = remote_pad->entity;
+		if (entity->function == MEDIA_ENT_F_CAM_SENSOR)
+			return media_entity_to_v4l2_subdev(entity);
+	}
+	return NULL;
+}
+
+/* the links can change under link_setup, which runs with graph_mutex held */
+static struct v4l2_subdev *isp_find_sensor(struct isp_device *isp_dev)
+{
+	struct media_device *mdev = isp_dev->sd.entity.graph_obj.mdev;
+	struct v4l2_subdev *sensor;
+
+	if (!mdev)
+		return NULL;
+
+	mutex_lock(&mdev->graph_mutex);
+	sensor = __isp_find_sensor(isp_dev);
+	mutex_unlock(&mdev->graph_mutex);
+	return sensor;
+}
+
+static int isp_sensor_batch(struct isp_ic_dev *dev,
+		const struct isp_ae_entry *entry, u32 *delay_frm)
+{
+	struct isp_device *isp_dev =
+			container_of(dev, struct isp_device, ic_dev);
+	struct vvcam_exp_gain_batch_s batch;
+	struct v4l2_subdev *sensor;
+	int ret;
+
+	sensor = isp_find_sensor(isp_dev);
+	if (!sensor)
+		return -ENODEV;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.valid = entry->sensor_valid;
+	batch.long_exp = entry->long_exp;
+	batch.exp = entry->exp;
+	batch.vs_exp = entry->vs_exp;
+	batch.long_gain = entry->long_gain;
+	batch.gain = entry->gain;
+	batch.vs_gain = entry->vs_gain;
+	batch.vts = entry->vts;
+	ret = v4l2_subdev_call(sensor, core, command,
+			VVSENSORIOC_S_EXP_GAIN_BATCH, &batch);
+	if (ret)
+		return ret;
+
+	*delay_frm = batch.delay_frm;
 	return 0;
 }
+#endif
 
 static void isp_post_event(struct isp_ic_dev *dev, void *data, size_t size)
 {
@@ -305,8 +392,10 @@ static int isp_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 	if (isp_dev->refcnt == 1) {
 		msleep(1);
 		isp_clear_interrupts(&isp_dev->ic_dev);
-		if (devm_request_irq(sd->dev, isp_dev->irq,
-				isp_hw_isr,IRQF_TRIGGER_HIGH | IRQF_SHARED,
+		if (devm_request_threaded_irq(sd->dev, isp_dev->irq,
+				isp_hw_isr,
+				isp_dev->ic_dev.irq_thread ? isp_isr_thread : NULL,
+				IRQF_TRIGGER_HIGH | IRQF_SHARED,
 				dev_name(sd->dev), &isp_dev->ic_dev) != 0) {
 			pr_err("failed to request irq.\n");
 			isp_dev->refcnt = 0;
@@ -314,6 +403,10 @@ static int isp_open(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 			mutex_unlock(&isp_dev->mlock);
 			return -1;
 		}
+		/* the irq thread and the tasklet follow the irq affinity */
+		if (isp_dev->irq_cpu >= 0)
+			irq_set_affinity_hint(isp_dev->irq,
+					cpumask_of(isp_dev->irq_cpu));
 	}
 	mutex_unlock(&isp_dev->mlock);
 	return 0;
@@ -332,7 +425,12 @@ static int isp_close(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 		if (isp_dev->state & STATE_DRIVER_STARTED)
 			isp_mi_stop(&isp_dev->ic_dev);
 		isp_dev->state = STATE_STOPPED;
+		if (isp_dev->irq_cpu >= 0)
+			irq_set_affinity_hint(isp_dev->irq, NULL);
 		devm_free_irq(sd->dev, isp_dev->irq, &isp_dev->ic_dev);
+		isp_lsc_async_stop(&isp_dev->ic_dev);
+		isp_ae_flush(&isp_dev->ic_dev);
+		isp_shadow_invalidate(&isp_dev->ic_dev);
 		isp_priv_ioctl(&isp_dev->ic_dev, ISPIOC_RESET, NULL);
 		isp_clear_interrupts(&isp_dev->ic_dev);
 		msleep(5);
@@ -344,7 +442,32 @@ static int isp_close(struct v4l2_subdev *sd, struct v4l2_subdev_fh *fh)
 	return 0;
 }
 
+static int isp_registered(struct v4l2_subdev *sd)
+{
+	struct isp_device *isp_dev = v4l2_get_subdevdata(sd);
+	int rc;
+
+	rc = isp_stats_register(isp_dev);
+	if (rc)
+		return rc;
+
+	rc = isp_rdma_register(isp_dev);
+	if (rc)
+		isp_stats_unregister(isp_dev);
+	return rc;
+}
+
+static void isp_unregistered(struct v4l2_subdev *sd)
+{
+	struct isp_device *isp_dev = v4l2_get_subdevdata(sd);
+
+	isp_rdma_unregister(isp_dev);
+	isp_stats_unregister(isp_dev);
+}
+
 static struct v4l2_subdev_internal_ops isp_internal_ops = {
+	.registered = isp_registered,
+	.unregistered = isp_unregistered,
 	.open = isp_open,
 	.close = isp_close,
 };
@@ -353,6 +476,7 @@ static struct v4l2_subdev_internal_ops isp_internal_ops = {
 static int isp_info_procfs_show(struct seq_file *sfile, void *offset)
 {
 	struct isp_device *isp_dev;
+	int i;
 	isp_dev = (struct isp_device *) sfile->private;
 
 	seq_printf(sfile ,"/********************************VSI ISP%d INFO********************************/\n",
@@ -365,6 +489,57 @@ static int isp_info_procfs_show(struct seq_file *sfile, void *offset)
 				isp_dev->ic_dev.frame_loss_cnt[0],
 				isp_dev->ic_dev.fps[0] / 100, isp_dev->ic_dev.fps[0] % 100,
 				isp_dev->ic_dev.streaming ? "run" : "idle");
+	seq_puts(sfile, "mi_late\t");
+	for (i = 0; i < MI_PATH_NUM; i++)
+		seq_printf(sfile, " %lld\t", isp_dev->ic_dev.mi_late_cnt[i]);
+	seq_printf(sfile, " (%s)\n",
+				isp_dev->ic_dev.mi_irq_program ? "irq" : "tasklet");
+	seq_printf(sfile, "stats_drop\t %lld\n", isp_dev->stats.drop_cnt);
+	vvlat_hist_show(sfile, "mp_out", &isp_dev->ic_dev.out_lat[0]);
+	vvlat_hist_show(sfile, "sp_out", &isp_dev->ic_dev.out_lat[1]);
+	seq_printf(sfile, "lut(us)\t lsc\t gamma\t gcmono\t rgbgamma\t wdr\n");
+	seq_printf(sfile, "last\t %u\t %u\t %u\t %u\t\t %u\n",
+				isp_dev->ic_dev.lut_us[ISP_LUT_LSC],
+				isp_dev->ic_dev.lut_us[ISP_LUT_GAMMA_OUT],
+				isp_dev->ic_dev.lut_us[ISP_LUT_GCMONO],
+				isp_dev->ic_dev.lut_us[ISP_LUT_RGBGAMMA],
+				isp_dev->ic_dev.lut_us[ISP_LUT_WDR]);
+	seq_printf(sfile, "max\t %u\t %u\t %u\t %u\t\t %u\n",
+				isp_dev->ic_dev.lut_max_us[ISP_LUT_LSC],
+				isp_dev->ic_dev.lut_max_us[ISP_LUT_GAMMA_OUT],
+				isp_dev->ic_dev.lut_max_us[ISP_LUT_GCMONO],
+				isp_dev->ic_dev.lut_max_us[ISP_LUT_RGBGAMMA],
+				isp_dev->ic_dev.lut_max_us[ISP_LUT_WDR]);
+	seq_printf(sfile, "bench\t %u\t %u\t -\t -\t\t -\t (avg of %u)\n",
+				isp_dev->ic_dev.lut_bench_us[ISP_LUT_LSC],
+				isp_dev->ic_dev.lut_bench_us[ISP_LUT_GAMMA_OUT],
+				isp_dev->ic_dev.lut_bench_loops);
+	seq_printf(sfile, "bench max\t %u\t %u\t -\t -\t\t -\n",
+				isp_dev->ic_dev.lut_bench_max_us[ISP_LUT_LSC],
+				isp_dev->ic_dev.lut_bench_max_us[ISP_LUT_GAMMA_OUT]);
+	seq_printf(sfile, "replay\t count %u\t last %uus\t resume to frame %uus\n",
+				isp_dev->ic_dev.replay_cnt,
+				isp_dev->ic_dev.replay_us,
+				isp_dev->ic_dev.resume_frame_us);
+	seq_printf(sfile, "lsc seq\t submit %u\t done %u\n",
+				isp_dev->ic_dev.lsc_async.seq,
+				isp_dev->ic_dev.lsc_async.done_seq);
+	seq_printf(sfile, "reconfig\t count %u\t seq %u\t dropped %llu\n",
+				isp_dev->ic_dev.reconfig.cnt,
+				isp_dev->ic_dev.reconfig.done_seq,
+				isp_dev->ic_dev.reconfig.drop_cnt);
+	seq_printf(sfile, "ae queue\t applied %llu\t late %llu\t err %llu\t seq %u\n",
+				isp_dev->ic_dev.ae.applied_cnt,
+				isp_dev->ic_dev.ae.late_cnt,
+				isp_dev->ic_dev.ae.err_cnt,
+				isp_dev->ic_dev.ae.done_seq);
+	seq_printf(sfile, "rdma\t jobs %llu\t requeued %llu\t aborted %llu\t %ux%u\n",
+				isp_dev->rdma.job_cnt,
+				isp_dev->rdma.requeue_cnt,
+				isp_dev->rdma.abort_cnt,
+				isp_dev->rdma.fmt.width,
+				isp_dev->rdma.fmt.height);
+	vvlat_hist_show(sfile, "rdma_job", &isp_dev->rdma.lat);
 	return 0;
 }
 
@@ -383,6 +558,7 @@ static ssize_t isp_procfs_write(struct file *file,
 	struct isp_device *isp_dev;
 	char strbuf[128];
 	char str[128] = "";
+	unsigned int loops;
 	int i;
 
 	if (count >= 128) {
@@ -404,8 +580,31 @@ static ssize_t isp_procfs_write(struct file *file,
 		isp_dev->ic_dev.frame_in_cnt = 0;
 		for (i = 0; i < MI_PATH_NUM; i++) {
 			isp_dev->ic_dev.frame_loss_cnt[i] = 0;
+			isp_dev->ic_dev.mi_late_cnt[i] = 0;
 			isp_dev->ic_dev.fps[i] = 0;
+			memset(&isp_dev->ic_dev.out_lat[i], 0,
+					sizeof(isp_dev->ic_dev.out_lat[i]));
 		}
+		memset(isp_dev->ic_dev.lut_max_us, 0,
+				sizeof(isp_dev->ic_dev.lut_max_us));
+		isp_dev->ic_dev.reconfig.cnt = 0;
+		isp_dev->ic_dev.reconfig.drop_cnt = 0;
+		isp_dev->ic_dev.ae.applied_cnt = 0;
+		isp_dev->ic_dev.ae.late_cnt = 0;
+		isp_dev->ic_dev.ae.err_cnt = 0;
+		isp_dev->rdma.job_cnt = 0;
+		isp_dev->rdma.requeue_cnt = 0;
+		isp_dev->rdma.abort_cnt = 0;
+		memset(&isp_dev->rdma.lat, 0, sizeof(isp_dev->rdma.lat));
+	} else if (!strcmp("lutbench", str)) {
+		/* "lutbench [loops]" re-uploads the cached LUTs, isp running */
+		if (sscanf(strbuf, "%*s %u", &loops) != 1)
+			loops = 1000;
+		mutex_lock(&isp_dev->mlock);
+		i = isp_dev->refcnt ? isp_lut_bench(&isp_dev->ic_dev, loops) : -EBUSY;
+		mutex_unlock(&isp_dev->mlock);
+		if (i)
+			return i;
 	}
 	return count;
 }
@@ -542,6 +741,7 @@ int isp_hw_probe(struct platform_device *pdev)
 	int irq;
 	int rc;
 	int i;
+	u32 cpu;
 
 	dev_info(dev, "Probing vvcam isp driver\n");
 
@@ -631,6 +831,8 @@ int isp_hw_probe(struct platform_device *pdev)
 	vvbuf_ctx_init(&isp_dev->bctx);
 	isp_dev->bctx.ops = &isp_buf_ops;
 	isp_dev->ic_dev.bctx = &isp_dev->bctx;
+	isp_dev->ic_dev.mi_irq_program = fwnode_property_read_bool(
+			of_fwnode_handle(pdev->dev.of_node), "vsi,mi-irq-program");
 
 	isp_dev->ic_dev.alloc = isp_buf_alloc;
 	isp_dev->ic_dev.free = isp_buf_free;
@@ -641,6 +843,24 @@ int isp_hw_probe(struct platform_device *pdev)
 		isp_dev->ic_dev.fps[i] = 0;
 	}
 
+	/* 3A statistics ring, only written by the cpu in isp_hw_isr */
+	isp_dev->ic_dev.stats_size = PAGE_ALIGN(sizeof(struct isp_stats_ring));
+	isp_dev->ic_dev.stats = alloc_pages_exact(isp_dev->ic_dev.stats_size,
+			GFP_KERNEL | __GFP_ZERO);
+	if (!isp_dev->ic_dev.stats) {
+		pr_err("failed to alloc isp stats ring.\n");
+		rc = -ENOMEM;
+		goto end;
+	}
+	isp_dev->ic_dev.stats->num = ISP_STATS_RING_NUM;
+	isp_dev->ic_dev.stats_pa = virt_to_phys(isp_dev->ic_dev.stats);
+
+	rc = isp_shadow_init(&isp_dev->ic_dev);
+	if (rc) {
+		pr_err("failed to alloc isp register shadow.\n");
+		goto end;
+	}
+
 	irq = platform_get_irq(pdev, 0);
 	if (irq < 0) {
 		pr_err("failed to get irq number.\n");
@@ -648,10 +868,28 @@ int isp_hw_probe(struct platform_device *pdev)
 	}
 
 	isp_dev->irq = irq;
+	isp_dev->ic_dev.irq = irq;
+
+	isp_dev->ic_dev.irq_thread = fwnode_property_read_bool(
+			of_fwnode_handle(pdev->dev.of_node), "vsi,irq-thread");
+	if (fwnode_property_read_u32(of_fwnode_handle(pdev->dev.of_node),
+			"vsi,irq-cpu", &cpu) || cpu >= nr_cpu_ids ||
+			!cpu_possible(cpu))
+		isp_dev->irq_cpu = -1;
+	else
+		isp_dev->irq_cpu = cpu;
+
 	pr_debug("request_irq num:%d, rc:%d", irq, rc);
 	spin_lock_init(&isp_dev->ic_dev.lock);
 	spin_lock_init(&isp_dev->ic_dev.irqlock);
+	for (i = 0; i < MI_PATH_NUM; i++)
+		INIT_LIST_HEAD(&isp_dev->ic_dev.mi_drop_list[i]);
 	tasklet_init(&isp_dev->ic_dev.tasklet, isp_isr_tasklet, (unsigned long)(&isp_dev->ic_dev));
+	isp_lsc_async_init(&isp_dev->ic_dev);
+	isp_ae_init(&isp_dev->ic_dev);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	isp_dev->ic_dev.sensor_batch = isp_sensor_batch;
+#endif
 
 	platform_set_drvdata(pdev, isp_dev);
 
@@ -661,6 +899,8 @@ int isp_hw_probe(struct platform_device *pdev)
 	isp_dev->sd.entity.ops = &isp_media_ops;
 	isp_dev->pads[ISP_PAD_SOURCE].flags =
 			MEDIA_PAD_FL_SOURCE | MEDIA_PAD_FL_MUST_CONNECT;
+	isp_dev->pads[ISP_PAD_STATS].flags = MEDIA_PAD_FL_SOURCE;
+	isp_dev->pads[ISP_PAD_RDMA].flags = MEDIA_PAD_FL_SINK;
 	rc = media_entity_pads_init(&isp_dev->sd.entity,
 			ISP_PADS_NUM, isp_dev->pads);
 	if (rc)
@@ -686,6 +926,9 @@ end:
 	pm_runtime_disable(&pdev->dev);
 
 err_detach_domains:
+	if (isp_dev->ic_dev.stats)
+		free_pages_exact(isp_dev->ic_dev.stats, isp_dev->ic_dev.stats_size);
+	isp_shadow_free(&isp_dev->ic_dev);
 	vvbuf_ctx_deinit(&isp_dev->bctx);
 	isp_detach_pm_domains(isp_dev);
 
@@ -707,6 +950,8 @@ int isp_hw_remove(struct platform_device *pdev)
 		return -1;
 
 	tasklet_kill(&isp->ic_dev.tasklet);
+	cancel_work_sync(&isp->ic_dev.lsc_async.work);
+	cancel_work_sync(&isp->ic_dev.ae.work);
 	vvbuf_ctx_deinit(&isp->bctx);
 	media_entity_cleanup(&isp->sd.entity);
 	v4l2_async_unregister_subdev(&isp->sd);
@@ -720,6 +965,8 @@ int isp_hw_remove(struct platform_device *pdev)
 
 	proc_remove(isp->pde);
 	pm_runtime_disable(&pdev->dev);
+	free_pages_exact(isp->ic_dev.stats, isp->ic_dev.stats_size);
+	isp_shadow_free(&isp->ic_dev);
 	kfree(isp);
 
 	dev_info(&pdev->dev, "Remove: Success\n");
@@ -761,7 +1008,12 @@ static int isp_system_resume(struct device *dev)
 		return -1;
 	}
 
+	/* module registers are lost with the power domain */
+	if (isp->refcnt > 0)
+		isp_shadow_replay(&isp->ic_dev);
+
 	if(isp->ic_dev.streaming == true) {
+		isp->ic_dev.resume_ns = ktime_get_ns();
 		isp_start_stream(&isp->ic_dev, 1);
 	}
 	return 0;
@@ -0,0 +1,659 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/version.h>
+#include <media/v4l2-common.h>
+#include <media/v4l2-ioctl.h>
+#include <media/videobuf2-v4l2.h>
+#include <media/videobuf2-dma-contig.h>
+
+#include "isp_driver.h"
+#include "isp_ioctl.h"
+#include "isp_types.h"
+
+/*
+ * Memory to memory reprocessing through the isp dma read path.
+ *
+ * The rdma node takes raw bayer frames on an output queue and feeds them
+ * to the isp one at a time, the result comes out of the usual capture node
+ * of the main path. Userspace sets up the isp for a dma input (mux
+ * dma_read_switch, input window matching the rdma format) and streams the
+ * capture node as for a sensor. Plane 0 holds the frame, plane 1 an
+ * optional struct isp_params_buffer in the ISPIOC_S_PARAMS layout that is
+ * applied right before the frame is read, data_size 0 keeps the current
+ * parameters.
+ *
+ * A job completes once the main path frame end of its frame is handled,
+ * that is the first main path frame end after the job started. The output
+ * buffer carries the sequence of the capture buffer it turned into.
+ * Timestamps are copied from the output buffer untouched.
+ */
+
+#define ISP_RDMA_MIN_WIDTH		(64)
+#define ISP_RDMA_MAX_WIDTH		(4096)
+#define ISP_RDMA_MIN_HEIGHT		(64)
+#define ISP_RDMA_MAX_HEIGHT		(3072)
+#define ISP_RDMA_ALIGN			(16)	/* dma read start address */
+#define ISP_RDMA_BURST			(2)	/* 16 beat bursts */
+#define ISP_RDMA_PARAMS_SIZE \
+	(sizeof(struct isp_params_buffer) + ISP_PARAMS_MAX_SIZE)
+#define ISP_RDMA_STOP_TIMEOUT_MS	(500)
+#define ISP_RDMA_IDLE_POLL_NUM		(20)
+
+struct isp_rdma_buffer {
+	struct vb2_v4l2_buffer vb;
+	struct list_head entry;
+	u8 *params;	/* validated copy of the plane 1 blocks */
+	u32 params_size;
+};
+
+struct isp_rdma_format {
+	u32 fourcc;
+	u32 type;
+	u32 bpp;	/* bytes per pixel, raw10/12 are unpacked to 16 bits */
+};
+
+static const struct isp_rdma_format isp_rdma_formats[] = {
+	{ V4L2_PIX_FMT_SBGGR8,  ISP_PICBUF_TYPE_RAW8,  1 },
+	{ V4L2_PIX_FMT_SGBRG8,  ISP_PICBUF_TYPE_RAW8,  1 },
+	{ V4L2_PIX_FMT_SGRBG8,  ISP_PICBUF_TYPE_RAW8,  1 },
+	{ V4L2_PIX_FMT_SRGGB8,  ISP_PICBUF_TYPE_RAW8,  1 },
+	{ V4L2_PIX_FMT_SBGGR10, ISP_PICBUF_TYPE_RAW10, 2 },
+	{ V4L2_PIX_FMT_SGBRG10, ISP_PICBUF_TYPE_RAW10, 2 },
+	{ V4L2_PIX_FMT_SGRBG10, ISP_PICBUF_TYPE_RAW10, 2 },
+	{ V4L2_PIX_FMT_SRGGB10, ISP_PICBUF_TYPE_RAW10, 2 },
+	{ V4L2_PIX_FMT_SBGGR12, ISP_PICBUF_TYPE_RAW12, 2 },
+	{ V4L2_PIX_FMT_SGBRG12, ISP_PICBUF_TYPE_RAW12, 2 },
+	{ V4L2_PIX_FMT_SGRBG12, ISP_PICBUF_TYPE_RAW12, 2 },
+	{ V4L2_PIX_FMT_SRGGB12, ISP_PICBUF_TYPE_RAW12, 2 },
+};
+
+static const struct isp_rdma_format *isp_rdma_find_format(u32 fourcc)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(isp_rdma_formats); i++) {
+		if (isp_rdma_formats[i].fourcc == fourcc)
+			return &isp_rdma_formats[i];
+	}
+	return NULL;
+}
+
+/* the read path derives the line length from the width, no padding */
+static const struct isp_rdma_format *isp_rdma_try_fmt(
+		struct v4l2_pix_format_mplane *pix)
+{
+	const struct isp_rdma_format *fmt;
+
+	fmt = isp_rdma_find_format(pix->pixelformat);
+	if (!fmt)
+		fmt = &isp_rdma_formats[0];
+
+	v4l_bound_align_image(&pix->width, ISP_RDMA_MIN_WIDTH,
+			ISP_RDMA_MAX_WIDTH, 4, &pix->height,
+			ISP_RDMA_MIN_HEIGHT, ISP_RDMA_MAX_HEIGHT, 1, 0);
+
+	memset(pix->reserved, 0, sizeof(pix->reserved));
+	memset(pix->plane_fmt, 0, sizeof(pix->plane_fmt));
+	pix->pixelformat = fmt->fourcc;
+	pix->field = V4L2_FIELD_NONE;
+	pix->colorspace = V4L2_COLORSPACE_RAW;
+	pix->ycbcr_enc = V4L2_YCBCR_ENC_DEFAULT;
+	pix->quantization = V4L2_QUANTIZATION_DEFAULT;
+	pix->xfer_func = V4L2_XFER_FUNC_NONE;
+	pix->flags = 0;
+	pix->num_planes = 2;
+	pix->plane_fmt[0].bytesperline = pix->width * fmt->bpp;
+	pix->plane_fmt[0].sizeimage =
+			pix->plane_fmt[0].bytesperline * pix->height;
+	pix->plane_fmt[1].sizeimage = ISP_RDMA_PARAMS_SIZE;
+	return fmt;
+}
+
+static int isp_rdma_queue_setup(struct vb2_queue *vq,
+		unsigned int *nbuffers, unsigned int *nplanes,
+		unsigned int sizes[], struct device *alloc_devs[])
+{
+	struct isp_rdma_node *node = vb2_get_drv_priv(vq);
+	struct v4l2_pix_format_mplane *pix = &node->fmt;
+
+	if (*nplanes) {
+		if (*nplanes != 2 ||
+		    sizes[0] < pix->plane_fmt[0].sizeimage ||
+		    sizes[1] < sizeof(struct isp_params_buffer))
+			return -EINVAL;
+		return 0;
+	}
+
+	*nplanes = 2;
+	sizes[0] = pix->plane_fmt[0].sizeimage;
+	sizes[1] = pix->plane_fmt[1].sizeimage;
+	return 0;
+}
+
+/* runs in process context, so the params plane is parsed here */
+static int isp_rdma_prepare_params(struct isp_rdma_buffer *buf)
+{
+	struct vb2_buffer *vb = &buf->vb.vb2_buf;
+	struct isp_params_buffer header;
+	unsigned long payload;
+	void *vaddr;
+	int rc;
+
+	kfree(buf->params);
+	buf->params = NULL;
+	buf->params_size = 0;
+
+	payload = vb2_get_plane_payload(vb, 1);
+	if (payload < sizeof(header))
+		return 0;
+
+	vaddr = vb2_plane_vaddr(vb, 1);
+	if (!vaddr)
+		return -EINVAL;
+
+	memcpy(&header, vaddr, sizeof(header));
+	if (header.data_size == 0)
+		return 0;
+	if (header.version != ISP_PARAMS_VERSION ||
+	    header.data_size > ISP_PARAMS_MAX_SIZE ||
+	    header.data_size > payload - sizeof(header))
+		return -EINVAL;
+
+	buf->params = kmemdup((u8 *)vaddr + sizeof(header),
+			header.data_size, GFP_KERNEL);
+	if (!buf->params)
+		return -ENOMEM;
+
+	rc = isp_params_validate(buf->params, header.data_size);
+	if (rc) {
+		kfree(buf->params);
+		buf->params = NULL;
+		return rc;
+	}
+	buf->params_size = header.data_size;
+	return 0;
+}
+
+static int isp_rdma_buf_prepare(struct vb2_buffer *vb)
+{
+	struct isp_rdma_node *node = vb2_get_drv_priv(vb->vb2_queue);
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct isp_rdma_buffer *buf =
+			container_of(vbuf, struct isp_rdma_buffer, vb);
+	u32 sizeimage = node->fmt.plane_fmt[0].sizeimage;
+
+	if (vb2_plane_size(vb, 0) < sizeimage ||
+	    vb2_get_plane_payload(vb, 0) < sizeimage)
+		return -EINVAL;
+
+	if (!IS_ALIGNED(vb2_dma_contig_plane_dma_addr(vb, 0),
+			ISP_RDMA_ALIGN)) {
+		pr_err("rdma buffer %u not %u byte aligned\n",
+				vb->index, ISP_RDMA_ALIGN);
+		return -EINVAL;
+	}
+
+	return isp_rdma_prepare_params(buf);
+}
+
+static void isp_rdma_buf_cleanup(struct vb2_buffer *vb)
+{
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct isp_rdma_buffer *buf =
+			container_of(vbuf, struct isp_rdma_buffer, vb);
+
+	kfree(buf->params);
+	buf->params = NULL;
+	buf->params_size = 0;
+}
+
+static void isp_rdma_buf_queue(struct vb2_buffer *vb)
+{
+	struct isp_rdma_node *node = vb2_get_drv_priv(vb->vb2_queue);
+	struct isp_device *isp_dev =
+			container_of(node, struct isp_device, rdma);
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct isp_rdma_buffer *buf =
+			container_of(vbuf, struct isp_rdma_buffer, vb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&node->lock, flags);
+	list_add_tail(&buf->entry, &node->buf_list);
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	isp_rdma_kick(isp_dev);
+}
+
+static int isp_rdma_start_streaming(struct vb2_queue *vq, unsigned int count)
+{
+	struct isp_rdma_node *node = vb2_get_drv_priv(vq);
+	struct isp_device *isp_dev =
+			container_of(node, struct isp_device, rdma);
+	unsigned long flags;
+
+	spin_lock_irqsave(&node->lock, flags);
+	node->streaming = true;
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	isp_rdma_kick(isp_dev);
+	return 0;
+}
+
+static bool isp_rdma_idle(struct isp_rdma_node *node)
+{
+	unsigned long flags;
+	bool idle;
+
+	spin_lock_irqsave(&node->lock, flags);
+	idle = !node->active;
+	spin_unlock_irqrestore(&node->lock, flags);
+	return idle;
+}
+
+/*
+ * Take the active job away from the isr and stop the read path, so its
+ * buffer can be released. Process context only.
+ */
+static struct isp_rdma_buffer *isp_rdma_cancel(struct isp_device *isp_dev)
+{
+	struct isp_rdma_node *node = &isp_dev->rdma;
+	struct isp_ic_dev *dev = &isp_dev->ic_dev;
+	struct isp_rdma_buffer *buf;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&node->lock, flags);
+	buf = node->active;
+	node->active = NULL;
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	if (!buf)
+		return NULL;
+
+	spin_lock_irqsave(&dev->irqlock, flags);
+	isp_stop_dma_read(dev);
+	spin_unlock_irqrestore(&dev->irqlock, flags);
+
+	for (i = 0; i < ISP_RDMA_IDLE_POLL_NUM && isp_dma_read_active(dev); i++)
+		usleep_range(1000, 2000);
+	if (i == ISP_RDMA_IDLE_POLL_NUM)
+		pr_warn("isp rdma read still active after stop\n");
+
+	return buf;
+}
+
+static void isp_rdma_stop_streaming(struct vb2_queue *vq)
+{
+	struct isp_rdma_node *node = vb2_get_drv_priv(vq);
+	struct isp_device *isp_dev =
+			container_of(node, struct isp_device, rdma);
+	struct isp_rdma_buffer *buf, *next;
+	unsigned long flags;
+	LIST_HEAD(done_list);
+
+	spin_lock_irqsave(&node->lock, flags);
+	node->streaming = false;
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	/* let the frame being read finish, then stop the read path */
+	if (!wait_event_timeout(node->idle_wq, isp_rdma_idle(node),
+			msecs_to_jiffies(ISP_RDMA_STOP_TIMEOUT_MS)))
+		pr_warn("isp rdma job did not complete, aborting it\n");
+
+	buf = isp_rdma_cancel(isp_dev);
+
+	spin_lock_irqsave(&node->lock, flags);
+	if (buf) {
+		list_add(&buf->entry, &node->buf_list);
+		node->abort_cnt++;
+	}
+	list_splice_init(&node->buf_list, &done_list);
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	list_for_each_entry_safe(buf, next, &done_list, entry) {
+		list_del(&buf->entry);
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+	}
+}
+
+static const struct vb2_ops isp_rdma_vb2_ops = {
+	.queue_setup = isp_rdma_queue_setup,
+	.buf_prepare = isp_rdma_buf_prepare,
+	.buf_cleanup = isp_rdma_buf_cleanup,
+	.buf_queue = isp_rdma_buf_queue,
+	.start_streaming = isp_rdma_start_streaming,
+	.stop_streaming = isp_rdma_stop_streaming,
+};
+
+/*
+ * Start the next job if the read path is free and the isp stream is up.
+ * Called from buf_queue, stream on and the frame end bottom half.
+ */
+void isp_rdma_kick(struct isp_device *isp_dev)
+{
+	struct isp_rdma_node *node = &isp_dev->rdma;
+	struct isp_ic_dev *dev = &isp_dev->ic_dev;
+	struct isp_rdma_buffer *buf;
+	struct isp_dma_context dma;
+	dma_addr_t addr;
+	unsigned long flags;
+
+	spin_lock_irqsave(&node->lock, flags);
+	if (!node->streaming || node->active ||
+	    list_empty(&node->buf_list) ||
+	    isp_dev->state != (STATE_DRIVER_STARTED | STATE_STREAM_STARTED)) {
+		spin_unlock_irqrestore(&node->lock, flags);
+		return;
+	}
+
+	buf = list_first_entry(&node->buf_list, struct isp_rdma_buffer, entry);
+	list_del(&buf->entry);
+	node->active = buf;
+	node->start_frame = READ_ONCE(dev->mp_end_frame);
+	node->start_ns = ktime_get_ns();
+
+	/* the isp is idle between jobs, so the blocks latch right away */
+	if (buf->params)
+		isp_stage_params(dev, buf->params, buf->params_size, true);
+
+	addr = vb2_dma_contig_plane_dma_addr(&buf->vb.vb2_buf, 0);
+#ifdef ISP_MP_34BIT
+	addr >>= 2;
+#endif
+	memset(&dma, 0, sizeof(dma));
+	dma.type = node->type;
+	dma.base = (u32)addr;
+	dma.width = node->fmt.width;
+	dma.height = node->fmt.height;
+	dma.burst_y = ISP_RDMA_BURST;
+	dma.burst_c = ISP_RDMA_BURST;
+	/* the isr rewrites the same irq mask and ctrl registers */
+	spin_lock(&dev->irqlock);
+	isp_start_dma_read(dev, &dma);
+	spin_unlock(&dev->irqlock);
+	spin_unlock_irqrestore(&node->lock, flags);
+}
+
+/* the isp stream stops under the active job, run it again on restart */
+void isp_rdma_suspend(struct isp_device *isp_dev)
+{
+	struct isp_rdma_node *node = &isp_dev->rdma;
+	struct isp_rdma_buffer *buf;
+	unsigned long flags;
+
+	buf = isp_rdma_cancel(isp_dev);
+	if (!buf)
+		return;
+
+	spin_lock_irqsave(&node->lock, flags);
+	list_add(&buf->entry, &node->buf_list);
+	node->requeue_cnt++;
+	spin_unlock_irqrestore(&node->lock, flags);
+	wake_up(&node->idle_wq);
+}
+
+/*
+ * Called after every mi frame end with the frame of the last main path
+ * frame end. The active job is done once that moved on from where it was
+ * at kick time, a self path frame end or a repeated call leaves it alone.
+ * Compared for change rather than order, procfs clear resets the count.
+ */
+void isp_rdma_done(struct isp_ic_dev *dev, u64 frame_id)
+{
+	struct isp_device *isp_dev = container_of(dev, struct isp_device, ic_dev);
+	struct isp_rdma_node *node = &isp_dev->rdma;
+	struct isp_rdma_buffer *buf = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&node->lock, flags);
+	if (node->active && frame_id != node->start_frame) {
+		buf = node->active;
+		node->active = NULL;
+		node->job_cnt++;
+		vvlat_hist_add(&node->lat, ktime_get_ns() - node->start_ns);
+	}
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	if (!buf)
+		return;
+
+	buf->vb.sequence = (u32)frame_id;
+	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+	wake_up(&node->idle_wq);
+
+	isp_rdma_kick(isp_dev);
+}
+
+static int isp_rdma_querycap(struct file *file, void *fh,
+		struct v4l2_capability *cap)
+{
+	struct isp_rdma_node *node = video_drvdata(file);
+
+	strscpy(cap->driver, ISP_DEVICE_NAME, sizeof(cap->driver));
+	strscpy(cap->card, node->vdev.name, sizeof(cap->card));
+	snprintf(cap->bus_info, sizeof(cap->bus_info), "platform:%s",
+			dev_name(node->queue.dev));
+	return 0;
+}
+
+static int isp_rdma_enum_fmt(struct file *file, void *fh,
+		struct v4l2_fmtdesc *f)
+{
+	if (f->index >= ARRAY_SIZE(isp_rdma_formats))
+		return -EINVAL;
+
+	f->pixelformat = isp_rdma_formats[f->index].fourcc;
+	return 0;
+}
+
+static int isp_rdma_g_fmt(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct isp_rdma_node *node = video_drvdata(file);
+
+	f->fmt.pix_mp = node->fmt;
+	return 0;
+}
+
+static int isp_rdma_try_fmt_vid_out(struct file *file, void *fh,
+		struct v4l2_format *f)
+{
+	isp_rdma_try_fmt(&f->fmt.pix_mp);
+	return 0;
+}
+
+static int isp_rdma_s_fmt(struct file *file, void *fh, struct v4l2_format *f)
+{
+	struct isp_rdma_node *node = video_drvdata(file);
+	const struct isp_rdma_format *fmt;
+
+	if (vb2_is_busy(&node->queue))
+		return -EBUSY;
+
+	fmt = isp_rdma_try_fmt(&f->fmt.pix_mp);
+	node->fmt = f->fmt.pix_mp;
+	node->type = fmt->type;
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops isp_rdma_ioctl_ops = {
+	.vidioc_querycap = isp_rdma_querycap,
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 3, 0)
+	.vidioc_enum_fmt_vid_out_mplane = isp_rdma_enum_fmt,
+#else
+	.vidioc_enum_fmt_vid_out = isp_rdma_enum_fmt,
+#endif
+	.vidioc_g_fmt_vid_out_mplane = isp_rdma_g_fmt,
+	.vidioc_s_fmt_vid_out_mplane = isp_rdma_s_fmt,
+	.vidioc_try_fmt_vid_out_mplane = isp_rdma_try_fmt_vid_out,
+	.vidioc_reqbufs = vb2_ioctl_reqbufs,
+	.vidioc_create_bufs = vb2_ioctl_create_bufs,
+	.vidioc_prepare_buf = vb2_ioctl_prepare_buf,
+	.vidioc_querybuf = vb2_ioctl_querybuf,
+	.vidioc_qbuf = vb2_ioctl_qbuf,
+	.vidioc_dqbuf = vb2_ioctl_dqbuf,
+	.vidioc_expbuf = vb2_ioctl_expbuf,
+	.vidioc_streamon = vb2_ioctl_streamon,
+	.vidioc_streamoff = vb2_ioctl_streamoff,
+};
+
+static const struct v4l2_file_operations isp_rdma_fops = {
+	.owner = THIS_MODULE,
+	.open = v4l2_fh_open,
+	.release = vb2_fop_release,
+	.unlocked_ioctl = video_ioctl2,
+	.poll = vb2_fop_poll,
+	.mmap = vb2_fop_mmap,
+};
+
+int isp_rdma_register(struct isp_device *isp_dev)
+{
+	struct isp_rdma_node *node = &isp_dev->rdma;
+	struct video_device *vdev = &node->vdev;
+	struct vb2_queue *q = &node->queue;
+	const struct isp_rdma_format *fmt;
+	int rc;
+
+	mutex_init(&node->mlock);
+	spin_lock_init(&node->lock);
+	INIT_LIST_HEAD(&node->buf_list);
+	init_waitqueue_head(&node->idle_wq);
+	node->active = NULL;
+	node->streaming = false;
+	node->job_cnt = 0;
+	node->requeue_cnt = 0;
+	node->abort_cnt = 0;
+	memset(&node->lat, 0, sizeof(node->lat));
+
+	memset(&node->fmt, 0, sizeof(node->fmt));
+	node->fmt.width = 1920;
+	node->fmt.height = 1080;
+	node->fmt.pixelformat = V4L2_PIX_FMT_SRGGB10;
+	fmt = isp_rdma_try_fmt(&node->fmt);
+	node->type = fmt->type;
+
+	q->type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+	q->io_modes = VB2_MMAP | VB2_DMABUF;
+	q->drv_priv = node;
+	q->ops = &isp_rdma_vb2_ops;
+	q->mem_ops = &vb2_dma_contig_memops;
+	q->buf_struct_size = sizeof(struct isp_rdma_buffer);
+	q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
+	q->lock = &node->mlock;
+	q->dev = isp_dev->sd.dev;
+	rc = vb2_queue_init(q);
+	if (rc) {
+		pr_err("can't init isp rdma vb queue\n");
+		goto err_mutex;
+	}
+
+	snprintf(vdev->name, sizeof(vdev->name), "%s.%d.rdma",
+			ISP_DEVICE_NAME, isp_dev->id);
+	vdev->fops = &isp_rdma_fops;
+	vdev->ioctl_ops = &isp_rdma_ioctl_ops;
+	vdev->release = video_device_release_empty;
+	vdev->lock = &node->mlock;
+	vdev->queue = q;
+	vdev->v4l2_dev = isp_dev->sd.v4l2_dev;
+	vdev->vfl_dir = VFL_DIR_TX;
+#if LINUX_VERSION_CODE > KERNEL_VERSION(5, 0, 0)
+	vdev->device_caps = V4L2_CAP_VIDEO_OUTPUT_MPLANE | V4L2_CAP_STREAMING;
+#endif
+	video_set_drvdata(vdev, node);
+
+	node->pad.flags = MEDIA_PAD_FL_SOURCE;
+	rc = media_entity_pads_init(&vdev->entity, 1, &node->pad);
+	if (rc)
+		goto err_mutex;
+
+#if LINUX_VERSION_CODE > KERNEL_VERSION(5, 10, 0)
+	rc = video_register_device(vdev, VFL_TYPE_VIDEO, -1);
+#else
+	rc = video_register_device(vdev, VFL_TYPE_GRABBER, -1);
+#endif
+	if (rc) {
+		pr_err("failed to register isp rdma node\n");
+		goto err_entity;
+	}
+
+	rc = media_create_pad_link(&vdev->entity, 0,
+			&isp_dev->sd.entity, ISP_PAD_RDMA,
+			MEDIA_LNK_FL_ENABLED | MEDIA_LNK_FL_IMMUTABLE);
+	if (rc)
+		goto err_video;
+
+	isp_dev->ic_dev.rdma_done = isp_rdma_done;
+	return 0;
+
+err_video:
+	video_unregister_device(vdev);
+err_entity:
+	media_entity_cleanup(&vdev->entity);
+err_mutex:
+	mutex_destroy(&node->mlock);
+	return rc;
+}
+
+void isp_rdma_unregister(struct isp_device *isp_dev)
+{
+	struct isp_rdma_node *node = &isp_dev->rdma;
+
+	if (!video_is_registered(&node->vdev))
+		return;
+
+	isp_dev->ic_dev.rdma_done = NULL;
+	video_unregister_device(&node->vdev);
+	media_entity_cleanup(&node->vdev.entity);
+	mutex_destroy(&node->mlock);
+}
@@ -0,0 +1,291 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#include <linux/module.h>
+#include <linux/version.h>
+#include <media/v4l2-ioctl.h>
+#include <media/videobuf2-v4l2.h>
+#include <media/videobuf2-vmalloc.h>
+
+#include "isp_driver.h"
+#include "viv_video_kevent.h"
+
+struct isp_stats_buffer {
+	struct vb2_v4l2_buffer vb;
+	struct list_head entry;
+};
+
+static int isp_stats_queue_setup(struct vb2_queue *vq,
+		unsigned int *nbuffers, unsigned int *nplanes,
+		unsigned int sizes[], struct device *alloc_devs[])
+{
+	if (*nplanes)
+		return sizes[0] < sizeof(struct isp_stats_frame) ? -EINVAL : 0;
+
+	*nplanes = 1;
+	sizes[0] = sizeof(struct isp_stats_frame);
+	return 0;
+}
+
+static int isp_stats_buf_prepare(struct vb2_buffer *vb)
+{
+	if (vb2_plane_size(vb, 0) < sizeof(struct isp_stats_frame))
+		return -EINVAL;
+
+	vb2_set_plane_payload(vb, 0, sizeof(struct isp_stats_frame));
+	return 0;
+}
+
+static void isp_stats_buf_queue(struct vb2_buffer *vb)
+{
+	struct isp_stats_node *node = vb2_get_drv_priv(vb->vb2_queue);
+	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
+	struct isp_stats_buffer *buf =
+			container_of(vbuf, struct isp_stats_buffer, vb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&node->lock, flags);
+	list_add_tail(&buf->entry, &node->buf_list);
+	spin_unlock_irqrestore(&node->lock, flags);
+}
+
+static void isp_stats_stop_streaming(struct vb2_queue *vq)
+{
+	struct isp_stats_node *node = vb2_get_drv_priv(vq);
+	struct isp_stats_buffer *buf, *next;
+	unsigned long flags;
+	LIST_HEAD(done_list);
+
+	spin_lock_irqsave(&node->lock, flags);
+	list_splice_init(&node->buf_list, &done_list);
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	list_for_each_entry_safe(buf, next, &done_list, entry) {
+		list_del(&buf->entry);
+		vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+	}
+}
+
+static const struct vb2_ops isp_stats_vb2_ops = {
+	.queue_setup = isp_stats_queue_setup,
+	.buf_prepare = isp_stats_buf_prepare,
+	.buf_queue = isp_stats_buf_queue,
+	.stop_streaming = isp_stats_stop_streaming,
+};
+
+/* called from isp_hw_isr once the stats of a frame are published */
+void isp_stats_done(struct isp_ic_dev *dev, struct isp_stats_frame *frame)
+{
+	struct isp_device *isp_dev = container_of(dev, struct isp_device, ic_dev);
+	struct isp_stats_node *node = &isp_dev->stats;
+	struct isp_stats_buffer *buf;
+	unsigned long flags;
+
+	spin_lock_irqsave(&node->lock, flags);
+	buf = list_first_entry_or_null(&node->buf_list,
+			struct isp_stats_buffer, entry);
+	if (buf)
+		list_del(&buf->entry);
+	else if (vb2_is_streaming(&node->queue))
+		node->drop_cnt++;
+	spin_unlock_irqrestore(&node->lock, flags);
+
+	if (!buf)
+		return;
+
+	memcpy(vb2_plane_vaddr(&buf->vb.vb2_buf, 0), frame, sizeof(*frame));
+	buf->vb.sequence = (u32)frame->frame_id;
+	buf->vb.vb2_buf.timestamp = frame->timestamp;
+	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+}
+
+static int isp_stats_querycap(struct file *file, void *fh,
+		struct v4l2_capability *cap)
+{
+	struct isp_stats_node *node = video_drvdata(file);
+
+	strscpy(cap->driver, ISP_DEVICE_NAME, sizeof(cap->driver));
+	strscpy(cap->card, node->vdev.name, sizeof(cap->card));
+	snprintf(cap->bus_info, sizeof(cap->bus_info), "platform:%s",
+			dev_name(node->queue.dev));
+	return 0;
+}
+
+static int isp_stats_enum_fmt(struct file *file, void *fh,
+		struct v4l2_fmtdesc *f)
+{
+	if (f->index > 0)
+		return -EINVAL;
+
+	f->pixelformat = V4L2_META_FMT_VIV_ISP_STATS;
+	return 0;
+}
+
+static int isp_stats_g_fmt(struct file *file, void *fh, struct v4l2_format *f)
+{
+	f->fmt.meta.dataformat = V4L2_META_FMT_VIV_ISP_STATS;
+	f->fmt.meta.buffersize = sizeof(struct isp_stats_frame);
+	return 0;
+}
+
+static const struct v4l2_ioctl_ops isp_stats_ioctl_ops = {
+	.vidioc_querycap = isp_stats_querycap,
+	.vidioc_enum_fmt_meta_cap = isp_stats_enum_fmt,
+	.vidioc_g_fmt_meta_cap = isp_stats_g_fmt,
+	.vidioc_s_fmt_meta_cap = isp_stats_g_fmt,
+	.vidioc_try_fmt_meta_cap = isp_stats_g_fmt,
+	.vidioc_reqbufs = vb2_ioctl_reqbufs,
+	.vidioc_create_bufs = vb2_ioctl_create_bufs,
+	.vidioc_prepare_buf = vb2_ioctl_prepare_buf,
+	.vidioc_querybuf = vb2_ioctl_querybuf,
+	.vidioc_qbuf = vb2_ioctl_qbuf,
+	.vidioc_dqbuf = vb2_ioctl_dqbuf,
+	.vidioc_expbuf = vb2_ioctl_expbuf,
+	.vidioc_streamon = vb2_ioctl_streamon,
+	.vidioc_streamoff = vb2_ioctl_streamoff,
+};
+
+static const struct v4l2_file_operations isp_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = v4l2_fh_open,
+	.release = vb2_fop_release,
+	.unlocked_ioctl = video_ioctl2,
+	.poll = vb2_fop_poll,
+	.mmap = vb2_fop_mmap,
+};
+
+int isp_stats_register(struct isp_device *isp_dev)
+{
+	struct isp_stats_node *node = &isp_dev->stats;
+	struct video_device *vdev = &node->vdev;
+	struct vb2_queue *q = &node->queue;
+	int rc;
+
+	mutex_init(&node->mlock);
+	spin_lock_init(&node->lock);
+	INIT_LIST_HEAD(&node->buf_list);
+	node->drop_cnt = 0;
+
+	q->type = V4L2_BUF_TYPE_META_CAPTURE;
+	q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_DMABUF;
+	q->drv_priv = node;
+	q->ops = &isp_stats_vb2_ops;
+	q->mem_ops = &vb2_vmalloc_memops;
+	q->buf_struct_size = sizeof(struct isp_stats_buffer);
+	q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+	q->lock = &node->mlock;
+	q->dev = isp_dev->sd.dev;
+	rc = vb2_queue_init(q);
+	if (rc) {
+		pr_err("can't init isp stats vb queue\n");
+		goto err_mutex;
+	}
+
+	snprintf(vdev->name, sizeof(vdev->name), "%s.%d.stats",
+			ISP_DEVICE_NAME, isp_dev->id);
+	vdev->fops = &isp_stats_fops;
+	vdev->ioctl_ops = &isp_stats_ioctl_ops;
+	vdev->release = video_device_release_empty;
+	vdev->lock = &node->mlock;
+	vdev->queue = q;
+	vdev->v4l2_dev = isp_dev->sd.v4l2_dev;
+	vdev->vfl_dir = VFL_DIR_RX;
+#if LINUX_VERSION_CODE > KERNEL_VERSION(5, 0, 0)
+	vdev->device_caps = V4L2_CAP_META_CAPTURE | V4L2_CAP_STREAMING;
+#endif
+	video_set_drvdata(vdev, node);
+
+	node->pad.flags = MEDIA_PAD_FL_SINK;
+	rc = media_entity_pads_init(&vdev->entity, 1, &node->pad);
+	if (rc)
+		goto err_mutex;
+
+#if LINUX_VERSION_CODE > KERNEL_VERSION(5, 10, 0)
+	rc = video_register_device(vdev, VFL_TYPE_VIDEO, -1);
+#else
+	rc = video_register_device(vdev, VFL_TYPE_GRABBER, -1);
+#endif
+	if (rc) {
+		pr_err("failed to register isp stats node\n");
+		goto err_entity;
+	}
+
+	rc = media_create_pad_link(&isp_dev->sd.entity, ISP_PAD_STATS,
+			&vdev->entity, 0,
+			MEDIA_LNK_FL_ENABLED | MEDIA_LNK_FL_IMMUTABLE);
+	if (rc)
+		goto err_video;
+
+	isp_dev->ic_dev.stats_done = isp_stats_done;
+	return 0;
+
+err_video:
+	video_unregister_device(vdev);
+err_entity:
+	media_entity_cleanup(&vdev->entity);
+err_mutex:
+	mutex_destroy(&node->mlock);
+	return rc;
+}
+
+void isp_stats_unregister(struct isp_device *isp_dev)
+{
+	struct isp_stats_node *node = &isp_dev->stats;
+
+	if (!video_is_registered(&node->vdev))
+		return;
+
+	isp_dev->ic_dev.stats_done = NULL;
+	video_unregister_device(&node->vdev);
+	media_entity_cleanup(&node->vdev.entity);
+	mutex_destroy(&node->mlock);
+}
@@ -0,0 +1,118 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vvcam_isp
+
+#if !defined(_ISP_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _ISP_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(isp_frame_in,
+	TP_PROTO(int id, u64 frame),
+	TP_ARGS(id, frame),
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u64, frame)
+	),
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->frame = frame;
+	),
+	TP_printk("isp%d frame=%llu", __entry->id, __entry->frame)
+);
+
+TRACE_EVENT(isp_frame_end,
+	TP_PROTO(int id, int path, u64 frame, u64 latency_ns),
+	TP_ARGS(id, path, frame, latency_ns),
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(int, path)
+		__field(u64, frame)
+		__field(u64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->path = path;
+		__entry->frame = frame;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("isp%d path=%d frame=%llu latency_ns=%llu",
+		__entry->id, __entry->path, __entry->frame,
+		__entry->latency_ns)
+);
+
+TRACE_EVENT(isp_buf_program,
+	TP_PROTO(int id, int path, u64 dma),
+	TP_ARGS(id, path, dma),
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(int, path)
+		__field(u64, dma)
+	),
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->path = path;
+		__entry->dma = dma;
+	),
+	TP_printk("isp%d path=%d dma=0x%llx",
+		__entry->id, __entry->path, __entry->dma)
+);
+
+#endif /* _ISP_TRACE_H_ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE isp_trace
+#include <trace/define_trace.h>
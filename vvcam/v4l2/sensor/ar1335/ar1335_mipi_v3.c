@@ -30,6 +30,7 @@
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include "vvsensor.h"
+#include "vvsensor_seq.h"
 #include "ar1335_regs_1080p.h"
 #include "ar1335_regs_1080p60.h"
 #include "ar1335_regs_12MP.h"
@@ -45,6 +46,8 @@
 #define AR1335_CHIP_ID                  0x153
 #define AR1335_CHIP_VERSION_REG 		0x3000
 #define AR1335_RESET_REG                0x301A
+#define AR1335_GROUP_HOLD_REG           0x0104
+#define AR1335_GROUP_MAX                4	/* registers per group hold write */
 
 #define AR1335_SENS_PAD_SOURCE	0
 #define AR1335_SENS_PADS_NUM	1
@@ -85,6 +88,8 @@ struct ar1335 {
 	u32 stream_status;
 	u32 resume_status;
 	vvcam_lens_t focus_lens;
+	struct vvsensor_seq_set seqs;
+	u32 seq_mode;	/* seqs slot of cur_mode */
 };
 
 static struct vvcam_mode_info_s par1335_mode_info[] = {
@@ -310,6 +315,57 @@ static s32 ar1335_read_reg(struct ar1335 *sensor, u16 reg, u16 *val)
 	return 0;
 }
 
+/*
+ * Write the 16 bit regs as a single i2c_transfer inside a grouped
+ * parameter hold, so the sensor latches them on the same frame. The hold
+ * register itself is 8 bit wide.
+ */
+static int ar1335_write_group(struct ar1335 *sensor,
+			      const struct vvcam_sccb_data_s *regs, u32 count)
+{
+	struct i2c_client *client = sensor->i2c_client;
+	struct i2c_msg msgs[AR1335_GROUP_MAX + 2];
+	u8 buf[AR1335_GROUP_MAX * 4 + 2 * 3];
+	u32 i, nmsg = 0, len = 0;
+	int ret;
+
+	if (count > AR1335_GROUP_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < count + 2; i++) {
+		msgs[nmsg].addr  = client->addr;
+		msgs[nmsg].flags = client->flags;
+		msgs[nmsg].buf   = &buf[len];
+		if (i == 0 || i == count + 1) {
+			buf[len++] = AR1335_GROUP_HOLD_REG >> 8;
+			buf[len++] = AR1335_GROUP_HOLD_REG & 0xff;
+			buf[len++] = i == 0 ? 0x01 : 0x00;
+			msgs[nmsg++].len = 3;
+			continue;
+		}
+		buf[len++] = (regs[i - 1].addr >> 8) & 0xff;
+		buf[len++] = regs[i - 1].addr & 0xff;
+		buf[len++] = (regs[i - 1].data >> 8) & 0xff;
+		buf[len++] = regs[i - 1].data & 0xff;
+		msgs[nmsg++].len = 4;
+	}
+
+	ret = i2c_transfer(client->adapter, msgs, nmsg);
+	if (ret != nmsg) {
+		pr_err("%s:i2c transfer error %d\n", __func__, ret);
+		return ret < 0 ? ret : -EIO;
+	}
+	return 0;
+}
+
+static inline void ar1335_group_add(struct vvcam_sccb_data_s *regs,
+				    u32 *n, u16 addr, u16 val)
+{
+	regs[*n].addr = addr;
+	regs[*n].data = val;
+	(*n)++;
+}
+
 
 static int ar1335_stream_on(struct ar1335 *sensor)
 {
@@ -339,29 +395,29 @@ static int ar1335_stream_off(struct ar1335 *sensor)
 	return ret;
 }
 
-static int ar1335_write_reg_arry(struct ar1335 *sensor,
-				    struct vvcam_sccb_data_s *mode_setting,
-				    s32 size)
+static int ar1335_compile_sequences(struct ar1335 *sensor)
 {
-	register u16 reg_addr = 0;
-	register u16 data = 0;
-	int i, retval = 0;
-
-	for (i = 0; i < size; ++i, ++mode_setting) {
+	struct vvsensor_seq *seq;
+	int i, ret;
 
-		reg_addr = mode_setting->addr;
-		data = mode_setting->data;
+	ret = vvsensor_seq_set_init(sensor->i2c_client, &sensor->seqs,
+				    ARRAY_SIZE(par1335_mode_info), "ar1335");
+	if (ret)
+		return ret;
 
-		retval = ar1335_write_reg(sensor, reg_addr, data);
-		if (retval < 0)
-			break;
-		if (reg_addr == 0x301A  && i == 0)
-			msleep(100);
+	for (i = 0; i < ARRAY_SIZE(par1335_mode_info); i++) {
+		seq = &sensor->seqs.seq[i];
+		snprintf(seq->name, sizeof(seq->name), "mode%u",
+			 par1335_mode_info[i].index);
+		ret = vvsensor_compile_sequence(sensor->i2c_client, seq,
+			(struct vvcam_sccb_data_s *)par1335_mode_info[i].preg_data,
+			par1335_mode_info[i].reg_data_count, 2);
+		if (ret) {
+			vvsensor_seq_set_release(&sensor->seqs);
+			return ret;
+		}
 	}
-
-    ar1335_stream_off(sensor);
-
-	return retval;
+	return 0;
 }
 
 static int ar1335_query_capability(struct ar1335 *sensor, void *arg)
@@ -440,6 +496,7 @@ static int ar1335_set_sensor_mode(struct ar1335 *sensor, void* pmode)
 		if (par1335_mode_info[i].index == sensor_mode.index) 
         {
 			memcpy(&sensor->cur_mode, &par1335_mode_info[i],sizeof(struct vvcam_mode_info_s));
+			sensor->seq_mode = i;
 			return 0;
 		}
 	}
@@ -454,9 +511,8 @@ static int ar1335_set_exp(struct ar1335 *sensor, u32 exp)
 	return ret;
 }
 
-static int ar1335_set_gain(struct ar1335 *sensor, u32 gain)
+static u16 ar1335_calc_gain(u32 gain)
 {
-	int ret = 0;
 	u16 new_gain = 0;
 	u32 div = 0;
 
@@ -481,8 +537,29 @@ static int ar1335_set_gain(struct ar1335 *sensor, u32 gain)
 		new_gain = 0x633F;
 	}
 
-	ret = ar1335_write_reg(sensor, 0x305E, new_gain);
-    return ret;
+	return new_gain;
+}
+
+static int ar1335_set_gain(struct ar1335 *sensor, u32 gain)
+{
+	return ar1335_write_reg(sensor, 0x305E, ar1335_calc_gain(gain));
+}
+
+static void ar1335_update_vts(struct ar1335 *sensor, u32 vts)
+{
+	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
+		sensor->cur_mode.ae_info.max_integration_line = vts - 1;
+	} else {
+		if (sensor->cur_mode.stitching_mode ==
+		    SENSOR_STITCHING_DUAL_DCG){
+			sensor->cur_mode.ae_info.max_vsintegration_line = 44;
+			sensor->cur_mode.ae_info.max_integration_line = vts -
+				4 - sensor->cur_mode.ae_info.max_vsintegration_line;
+		} else {
+			sensor->cur_mode.ae_info.max_integration_line = vts - 1;
+		}
+	}
+	sensor->cur_mode.ae_info.curr_frm_len_lines = vts;
 }
 
 static int ar1335_set_fps(struct ar1335 *sensor, u32 fps)
@@ -501,21 +578,56 @@ static int ar1335_set_fps(struct ar1335 *sensor, u32 fps)
 
 	ret |= ar1335_write_reg(sensor, 0x3012, vts);
 	sensor->cur_mode.ae_info.cur_fps = fps;
+	ar1335_update_vts(sensor, vts);
+	return ret;
+}
 
-	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
-		sensor->cur_mode.ae_info.max_integration_line = vts - 1;
-	} else {
-		if (sensor->cur_mode.stitching_mode ==
-		    SENSOR_STITCHING_DUAL_DCG){
-			sensor->cur_mode.ae_info.max_vsintegration_line = 44;
-			sensor->cur_mode.ae_info.max_integration_line = vts -
-				4 - sensor->cur_mode.ae_info.max_vsintegration_line;
-		} else {
-			sensor->cur_mode.ae_info.max_integration_line = vts - 1;
-		}
+#define AR1335_BATCH_FIELDS \
+	(VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_GAIN | VVSENSOR_BATCH_VTS)
+
+static int ar1335_set_exp_gain_batch(struct ar1335 *sensor,
+				     struct vvcam_exp_gain_batch_s *batch)
+{
+	struct vvcam_ae_info_s *pae_info = &sensor->cur_mode.ae_info;
+	struct vvcam_sccb_data_s regs[AR1335_GROUP_MAX];
+	u32 n = 0;
+	int ret;
+
+	/* linear modes only */
+	if (batch->valid & ~AR1335_BATCH_FIELDS)
+		return -EINVAL;
+	if ((batch->valid & VVSENSOR_BATCH_VTS) && !batch->vts)
+		return -EINVAL;
+
+	/* FRAME_LENGTH_LINES, as in the mode register tables */
+	if (batch->valid & VVSENSOR_BATCH_VTS)
+		ar1335_group_add(regs, &n, 0x0340, batch->vts);
+	if (batch->valid & VVSENSOR_BATCH_EXP)
+		ar1335_group_add(regs, &n, 0x0202, batch->exp);
+	if (batch->valid & VVSENSOR_BATCH_GAIN)
+		ar1335_group_add(regs, &n, 0x305E,
+				 ar1335_calc_gain(batch->gain));
+	if (n == 0)
+		return 0;
+
+	ret = ar1335_write_group(sensor, regs, n);
+	if (ret)
+		return ret;
+
+	if (batch->valid & VVSENSOR_BATCH_VTS) {
+		/* the inverse of ar1335_set_fps, so G_FPS follows the vts */
+		pae_info->cur_fps = pae_info->max_fps *
+				    pae_info->def_frm_len_lines / batch->vts;
+		ar1335_update_vts(sensor, batch->vts);
 	}
-	sensor->cur_mode.ae_info.curr_frm_len_lines = vts;
-	return ret;
+
+	batch->delay_frm = 0;
+	if (batch->valid & (VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_VTS))
+		batch->delay_frm = pae_info->int_update_delay_frm;
+	if (batch->valid & VVSENSOR_BATCH_GAIN)
+		batch->delay_frm = max_t(u32, batch->delay_frm,
+					 pae_info->gain_update_delay_frm);
+	return 0;
 }
 
 static int ar1335_get_fps(struct ar1335 *sensor, u32 *pfps)
@@ -682,15 +794,14 @@ static int ar1335_set_fmt(struct v4l2_subdev *sd,
 		return -EINVAL;
 	}
 	
-	ret |= ar1335_write_reg_arry(sensor,
-		sensor->cur_mode.preg_data,
-		sensor->cur_mode.reg_data_count);
-	
+	ret = vvsensor_apply_sequence(client,
+				      &sensor->seqs.seq[sensor->seq_mode]);
 	if (ret < 0) {
-		pr_err("%s:ar1335_write_reg_arry error\n",__func__);
+		pr_err("%s:vvsensor_apply_sequence error\n",__func__);
 		mutex_unlock(&sensor->lock);
 		return -EINVAL;
 	}
+	ar1335_stream_off(sensor);
 	ar1335_get_format_code(sensor, &fmt->format.code);
 	fmt->format.field = V4L2_FIELD_NONE;
 	sensor->format = fmt->format;
@@ -725,6 +836,7 @@ static long ar1335_priv_ioctl(struct v4l2_subdev *sd,
 	struct ar1335 *sensor = client_to_ar1335(client);
 	long ret = 0;
 	struct vvcam_sccb_data_s sensor_reg;
+	struct vvcam_exp_gain_batch_s batch;
 	uint32_t value = 0;
 
 	mutex_lock(&sensor->lock);
@@ -786,6 +898,15 @@ static long ar1335_priv_ioctl(struct v4l2_subdev *sd,
 		ret = copy_from_user(&value, arg, sizeof(value));
 		ret |= ar1335_set_fps(sensor, value);
 		break;
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		if (copy_from_user(&batch, arg, sizeof(batch))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = ar1335_set_exp_gain_batch(sensor, &batch);
+		if (!ret && copy_to_user(arg, &batch, sizeof(batch)))
+			ret = -EFAULT;
+		break;
 	case VVSENSORIOC_G_FPS:
 		ret = ar1335_get_fps(sensor, &value);
 		ret |= copy_to_user(arg, &value, sizeof(value));
@@ -815,9 +936,34 @@ static const struct v4l2_subdev_pad_ops ar1335_subdev_pad_ops = {
 	.get_fmt = ar1335_get_fmt,
 };
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+/* requests from other drivers, arg is a kernel pointer */
+static long ar1335_command(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct ar1335 *sensor = client_to_ar1335(client);
+	long ret;
+
+	mutex_lock(&sensor->lock);
+	switch (cmd) {
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		ret = ar1335_set_exp_gain_batch(sensor, arg);
+		break;
+	default:
+		ret = -ENOIOCTLCMD;
+		break;
+	}
+	mutex_unlock(&sensor->lock);
+	return ret;
+}
+#endif
+
 static struct v4l2_subdev_core_ops ar1335_subdev_core_ops = {
 	.s_power = ar1335_s_power,
 	.ioctl = ar1335_priv_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	.command = ar1335_command,
+#endif
 };
 
 static struct v4l2_subdev_ops ar1335_subdev_ops = {
@@ -1126,6 +1272,12 @@ static int ar1335_probe(struct i2c_client *client,
         goto probe_err_power_off;
     }
 
+	retval = ar1335_compile_sequences(sensor);
+	if (retval < 0) {
+		dev_err(dev, "%s: compile register sequences fail\n", __func__);
+		goto probe_err_power_off;
+	}
+
 	sd = &sensor->subdev;
 	v4l2_i2c_subdev_init(sd, client, &ar1335_subdev_ops);
 	sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
@@ -1137,7 +1289,7 @@ static int ar1335_probe(struct i2c_client *client,
 				AR1335_SENS_PADS_NUM,
 				sensor->pads);
 	if (retval < 0)
-		goto probe_err_power_off;
+		goto probe_err_seq_release;
 
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 12, 0)
 	retval = v4l2_async_register_subdev_sensor(sd);
@@ -1162,6 +1314,9 @@ static int ar1335_probe(struct i2c_client *client,
 probe_err_free_entiny:
 	media_entity_cleanup(&sd->entity);
 
+probe_err_seq_release:
+	vvsensor_seq_set_release(&sensor->seqs);
+
 probe_err_power_off:
 	ar1335_power_off(sensor);
 
@@ -1184,6 +1339,7 @@ static void ar1335_remove(struct i2c_client *client)
 
 	v4l2_async_unregister_subdev(sd);
 	media_entity_cleanup(&sd->entity);
+	vvsensor_seq_set_release(&sensor->seqs);
 	ar1335_power_off(sensor);
 	ar1335_regulator_disable(sensor);
 	mutex_destroy(&sensor->lock);
@@ -30,6 +30,7 @@
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include "vvsensor.h"
+#include "vvsensor_seq.h"
 
 #include <asm/unaligned.h>
 #include <linux/pm_runtime.h>
@@ -44,6 +45,9 @@
 #define IMX219_MODE_STANDBY		0x00
 #define IMX219_MODE_STREAMING		0x01
 
+#define IMX219_REG_GROUP_HOLD		0x0104
+#define IMX219_GROUP_MAX		8	/* registers per group hold write */
+
 /* Chip ID */
 #define IMX219_REG_CHIP_ID		0x0000
 #define IMX219_CHIP_ID			0x0219
@@ -230,6 +234,8 @@ struct imx219 {
 	struct mutex lock;
 	u32 stream_status;
 	u32 resume_status;
+	struct vvsensor_seq_set seqs;
+	u32 seq_mode;	/* seqs slot of cur_mode */
 
 	/* V4L2 Controls */
 	
@@ -544,28 +550,113 @@ static int imx219_write_reg(struct imx219 *sensor, u16 reg, u32 len, u32 val)
 }
 #endif
 
-/* Write a list of registers */
-static int imx219_write_regs(struct imx219 *sensor,
-				const struct vvcam_sccb_data_s *sensor_reg_cfg , u32 len)
+/*
+ * Write regs as a single i2c_transfer inside a grouped parameter hold,
+ * so the sensor latches them on the same frame. Runs of consecutive
+ * addresses share one message.
+ */
+static int imx219_write_group(struct imx219 *sensor,
+			      const struct vvcam_sccb_data_s *regs, u32 count)
 {
 	struct i2c_client *client = sensor->i2c_client;
-	unsigned int i;
+	struct vvcam_sccb_data_s seq[IMX219_GROUP_MAX + 2];
+	struct i2c_msg msgs[IMX219_GROUP_MAX + 2];
+	u8 buf[(IMX219_GROUP_MAX + 2) * 3];
+	u32 i, n = 0, nmsg = 0, len = 0;
 	int ret;
 
-	for (i = 0; i < len; i++) {
-		ret = imx219_write_reg(sensor, sensor_reg_cfg[i].addr, 1, sensor_reg_cfg[i].data);
-		if (ret) {
-			dev_err_ratelimited(&client->dev,
-					    "Failed to write reg 0x%4.4x. error = %d\n",
-					    sensor_reg_cfg[i].addr, ret);
+	if (count > IMX219_GROUP_MAX)
+		return -EINVAL;
 
-			return ret;
+	seq[n].addr = IMX219_REG_GROUP_HOLD;
+	seq[n++].data = 0x01;
+	memcpy(&seq[n], regs, count * sizeof(*regs));
+	n += count;
+	seq[n].addr = IMX219_REG_GROUP_HOLD;
+	seq[n++].data = 0x00;
+
+	for (i = 0; i < n; i++) {
+		if (i == 0 || seq[i].addr != seq[i - 1].addr + 1) {
+			msgs[nmsg].addr  = client->addr;
+			msgs[nmsg].flags = client->flags;
+			msgs[nmsg].buf   = &buf[len];
+			msgs[nmsg].len   = 2;
+			buf[len++] = (seq[i].addr >> 8) & 0xff;
+			buf[len++] = seq[i].addr & 0xff;
+			nmsg++;
 		}
+		buf[len++] = seq[i].data & 0xff;
+		msgs[nmsg - 1].len++;
 	}
 
+	ret = i2c_transfer(client->adapter, msgs, nmsg);
+	if (ret != nmsg) {
+		pr_err("%s:i2c transfer error %d\n", __func__, ret);
+		return ret < 0 ? ret : -EIO;
+	}
 	return 0;
 }
 
+static inline void imx219_group_add(struct vvcam_sccb_data_s *regs,
+				    u32 *n, u16 addr, u8 val)
+{
+	regs[*n].addr = addr;
+	regs[*n].data = val;
+	(*n)++;
+}
+
+/* one sequence per mode, followed by the raw8 and raw10 frame formats */
+#define IMX219_SEQ_RAW8		ARRAY_SIZE(pimx219_mode_info)
+#define IMX219_SEQ_RAW10	(IMX219_SEQ_RAW8 + 1)
+#define IMX219_SEQ_NUM		(IMX219_SEQ_RAW10 + 1)
+
+static int imx219_compile_seq(struct imx219 *sensor, u32 slot,
+			      const char *name,
+			      const struct vvcam_sccb_data_s *regs, u32 count)
+{
+	struct vvsensor_seq *seq = &sensor->seqs.seq[slot];
+
+	snprintf(seq->name, sizeof(seq->name), "%s", name);
+	return vvsensor_compile_sequence(sensor->i2c_client, seq,
+					 regs, count, 1);
+}
+
+static int imx219_compile_sequences(struct imx219 *sensor)
+{
+	char name[16];
+	int i, ret;
+
+	ret = vvsensor_seq_set_init(sensor->i2c_client, &sensor->seqs,
+				    IMX219_SEQ_NUM, "imx219");
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ARRAY_SIZE(pimx219_mode_info); i++) {
+		snprintf(name, sizeof(name), "mode%u",
+			 pimx219_mode_info[i].index);
+		ret = imx219_compile_seq(sensor, i, name,
+			(struct vvcam_sccb_data_s *)pimx219_mode_info[i].preg_data,
+			pimx219_mode_info[i].reg_data_count);
+		if (ret)
+			goto err;
+	}
+	ret = imx219_compile_seq(sensor, IMX219_SEQ_RAW8, "raw8",
+				 raw8_framefmt_regs,
+				 ARRAY_SIZE(raw8_framefmt_regs));
+	if (ret)
+		goto err;
+	ret = imx219_compile_seq(sensor, IMX219_SEQ_RAW10, "raw10",
+				 raw10_framefmt_regs,
+				 ARRAY_SIZE(raw10_framefmt_regs));
+	if (ret)
+		goto err;
+	return 0;
+
+err:
+	vvsensor_seq_set_release(&sensor->seqs);
+	return ret;
+}
+
 static int imx219_query_capability(struct imx219 *sensor, void *arg)
 {
 	struct v4l2_capability *pcap = (struct v4l2_capability *)arg;
@@ -650,6 +741,7 @@ static int imx219_set_sensor_mode(struct imx219 *sensor, void* pmode)
 		if (pimx219_mode_info[i].index == sensor_mode.index) {
 			memcpy(&sensor->cur_mode, &pimx219_mode_info[i],
 				sizeof(struct vvcam_mode_info_s));
+			sensor->seq_mode = i;
 			return 0;
 		}
 	}
@@ -693,52 +785,39 @@ static int imx219_set_lgain(struct imx219 *sensor, u32 gain)
 	return ret;
 }
 
-static int imx219_set_gain(struct imx219 *sensor, u32 gain)
-{
 /*
-#define ANA_GAIN_GLOBAL_A		0x157
-#define DIG_GAIN_GLOBAL_A_UP   0x0158 
-#define DIG_GAIN_GLOBAL_A_LOW 0x0159
-*/
-	int ret = 0;
-
-#if 1
-	u32 again, dgain; 
+ * Split gain into the analog gain code and the 8.8 digital gain: the
+ * analog part is 256/(256-x) up to 10x, the rest goes to digital gain.
+ */
+static void imx219_calc_gain(u32 gain, u32 *again, u32 *dgain)
+{
+	u32 ag, dg;
 
-	//pr_info("%s gain=0x%x\n",__func__,gain);
 	if (gain > (10 * (1 << SENSOR_FIX_FRACBITS))) {
-		again = 10 * (1 << SENSOR_FIX_FRACBITS);
-		dgain = gain / 10;
-	}
-	else {
-		again = gain;
-		dgain = 1 << SENSOR_FIX_FRACBITS;
+		ag = 10 * (1 << SENSOR_FIX_FRACBITS);
+		dg = gain / 10;
+	} else {
+		ag = gain;
+		dg = 1 << SENSOR_FIX_FRACBITS;
 	}
+	/* below 1x the code would divide by zero */
+	if (ag < (1 << SENSOR_FIX_FRACBITS))
+		ag = 1 << SENSOR_FIX_FRACBITS;
 
-	// set dgain
-	if (dgain == (1 << SENSOR_FIX_FRACBITS)) {
-		imx219_write_reg(sensor, DIG_GAIN_GLOBAL_A_UP, 1, 1);
-		imx219_write_reg(sensor, DIG_GAIN_GLOBAL_A_LOW, 1, 0);
-	}
-	else {
-		/*gain * 256 = (up + low/256) * 256
-		gain * (1 << SENSOR_FIX_FRACBITS) /4 = 256 * up + low 
-		up = dgain // 4 // 256;
-		low = dgain / 4 - (256 * up)   */
-		// assert(SENSOR_FIX_FRACBITS == 1024);
-		imx219_write_reg(sensor, DIG_GAIN_GLOBAL_A_UP, 1, dgain / /*4/256*/ 1024);
-		imx219_write_reg(sensor, DIG_GAIN_GLOBAL_A_LOW, 1, dgain / 4 - (dgain / /*4 /256*/1024 * 256 ));
-	}
+	*again = 256 - (256 / (ag / (1 << SENSOR_FIX_FRACBITS)));
+	*dgain = dg >> (SENSOR_FIX_FRACBITS - 8);
+}
 
-	// set again
-	/* gain =  256/(256-x)
-		gain * 	(1 << SENSOR_FIX_FRACBITS) = 256 /(256-x) * (1 << SENSOR_FIX_FRACBITS)
-		x = 256 -( 256 / (again / (1 << SENSOR_FIX_FRACBITS)))
-	*/
-	imx219_write_reg(sensor, ANA_GAIN_GLOBAL_A, 1, 256 -( 256 / (again / (1 << SENSOR_FIX_FRACBITS))));
-#endif
-	
-	return ret;
+static int imx219_set_gain(struct imx219 *sensor, u32 gain)
+{
+	u32 again, dgain;
+
+	imx219_calc_gain(gain, &again, &dgain);
+	imx219_write_reg(sensor, DIG_GAIN_GLOBAL_A_UP, 1, (dgain >> 8) & 0xff);
+	imx219_write_reg(sensor, DIG_GAIN_GLOBAL_A_LOW, 1, dgain & 0xff);
+	imx219_write_reg(sensor, ANA_GAIN_GLOBAL_A, 1, again);
+
+	return 0;
 }
 
 static int imx219_set_vsgain(struct imx219 *sensor, u32 gain)
@@ -747,6 +826,49 @@ static int imx219_set_vsgain(struct imx219 *sensor, u32 gain)
 	//pr_info("%s gain=0x%x\n",__func__,gain);
 	return ret;
 }
+
+#define IMX219_BATCH_FIELDS	(VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_GAIN)
+
+static int imx219_set_exp_gain_batch(struct imx219 *sensor,
+				     struct vvcam_exp_gain_batch_s *batch)
+{
+	struct vvcam_ae_info_s *pae_info = &sensor->cur_mode.ae_info;
+	struct vvcam_sccb_data_s regs[IMX219_GROUP_MAX];
+	u32 n = 0, again, dgain;
+	int ret;
+
+	/* linear only, and the frame length is fixed, see S_FPS */
+	if (batch->valid & ~IMX219_BATCH_FIELDS)
+		return -EINVAL;
+
+	if (batch->valid & VVSENSOR_BATCH_GAIN) {
+		imx219_calc_gain(batch->gain, &again, &dgain);
+		imx219_group_add(regs, &n, ANA_GAIN_GLOBAL_A, again);
+		imx219_group_add(regs, &n, DIG_GAIN_GLOBAL_A_UP,
+				 (dgain >> 8) & 0xff);
+		imx219_group_add(regs, &n, DIG_GAIN_GLOBAL_A_LOW, dgain & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_EXP) {
+		imx219_group_add(regs, &n, COARSE_INTEGRATION_TIME_A_UP,
+				 (batch->exp >> 8) & 0xff);
+		imx219_group_add(regs, &n, COARSE_INTEGRATION_TIME_A_LOW,
+				 batch->exp & 0xff);
+	}
+	if (n == 0)
+		return 0;
+
+	ret = imx219_write_group(sensor, regs, n);
+	if (ret)
+		return ret;
+
+	batch->delay_frm = 0;
+	if (batch->valid & VVSENSOR_BATCH_EXP)
+		batch->delay_frm = pae_info->int_update_delay_frm;
+	if (batch->valid & VVSENSOR_BATCH_GAIN)
+		batch->delay_frm = max_t(u32, batch->delay_frm,
+					 pae_info->gain_update_delay_frm);
+	return 0;
+}
 #if 0
 static int imx219_set_fps(struct imx219 *sensor, u32 fps)
 {
@@ -897,15 +1019,15 @@ static int imx219_set_framefmt(struct imx219 *sensor)
    case MEDIA_BUS_FMT_SGRBG8_1X8:
    case MEDIA_BUS_FMT_SGBRG8_1X8:
    case MEDIA_BUS_FMT_SBGGR8_1X8:
-	   return imx219_write_regs(sensor, raw8_framefmt_regs,
-				   ARRAY_SIZE(raw8_framefmt_regs));
+	   return vvsensor_apply_sequence(sensor->i2c_client,
+				&sensor->seqs.seq[IMX219_SEQ_RAW8]);
 
    case MEDIA_BUS_FMT_SRGGB10_1X10:
    case MEDIA_BUS_FMT_SGRBG10_1X10:
    case MEDIA_BUS_FMT_SGBRG10_1X10:
    case MEDIA_BUS_FMT_SBGGR10_1X10:
-	   return imx219_write_regs(sensor, raw10_framefmt_regs,
-				   ARRAY_SIZE(raw10_framefmt_regs));
+	   return vvsensor_apply_sequence(sensor->i2c_client,
+				&sensor->seqs.seq[IMX219_SEQ_RAW10]);
    }
 
    return -EINVAL;
@@ -915,15 +1037,11 @@ static int imx219_start_streaming(struct imx219 *sensor)
 	struct i2c_client *client = sensor->i2c_client;
 	int ret;
 	
-	struct vvcam_sccb_data_s *sensor_reg_cfg;
-	u32 sensor_reg_size = 0;
 	//pr_info("enter %s ===\n", __func__);
 
-	sensor_reg_cfg =
-		(struct vvcam_sccb_data_s *)sensor->cur_mode.preg_data;
-	sensor_reg_size = sensor->cur_mode.reg_data_count;
 	/* Apply default values of current mode */
-	ret = imx219_write_regs(sensor, sensor_reg_cfg, sensor_reg_size);
+	ret = vvsensor_apply_sequence(client,
+				      &sensor->seqs.seq[sensor->seq_mode]);
 	if (ret) {
 		dev_err(&client->dev, "%s failed to set mode\n", __func__);
 		return ret;
@@ -1154,6 +1272,7 @@ static long imx219_priv_ioctl(struct v4l2_subdev *sd,
 	uint32_t value = 0;
 	sensor_blc_t blc;
 	sensor_expand_curve_t expand_curve;
+	struct vvcam_exp_gain_batch_s batch;
 	//pr_info("== enter %s cmd=0x%x VIDIOC_QUERYCAP=0x%lx\n", __func__,cmd, VIDIOC_QUERYCAP); 
 
 	mutex_lock(&sensor->lock);
@@ -1230,6 +1349,15 @@ static long imx219_priv_ioctl(struct v4l2_subdev *sd,
 		ret = copy_from_user(&value, arg, sizeof(value));
 		ret |= imx219_set_vsgain(sensor, value);
 		break;
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		if (copy_from_user(&batch, arg, sizeof(batch))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = imx219_set_exp_gain_batch(sensor, &batch);
+		if (!ret && copy_to_user(arg, &batch, sizeof(batch)))
+			ret = -EFAULT;
+		break;
 	case VVSENSORIOC_S_FPS:
 		ret = copy_from_user(&value, arg, sizeof(value));
 		//ret |= imx219_set_fps(sensor, value); //imx219 not support
@@ -1274,9 +1402,34 @@ static const struct v4l2_subdev_pad_ops imx219_subdev_pad_ops = {
 	.get_fmt = imx219_get_fmt,
 };
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+/* requests from other drivers, arg is a kernel pointer */
+static long imx219_command(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct imx219 *sensor = client_to_imx219(client);
+	long ret;
+
+	mutex_lock(&sensor->lock);
+	switch (cmd) {
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		ret = imx219_set_exp_gain_batch(sensor, arg);
+		break;
+	default:
+		ret = -ENOIOCTLCMD;
+		break;
+	}
+	mutex_unlock(&sensor->lock);
+	return ret;
+}
+#endif
+
 static struct v4l2_subdev_core_ops imx219_subdev_core_ops = {
 	.s_power = imx219_s_power,
 	.ioctl = imx219_priv_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	.command = imx219_command,
+#endif
 };
 
 static struct v4l2_subdev_ops imx219_subdev_ops = {
@@ -1520,6 +1673,12 @@ static int imx219_probe(struct i2c_client *client)
 
 	imx219_set_default_format(sensor);
 
+	retval = imx219_compile_sequences(sensor);
+	if (retval < 0) {
+		dev_err(dev, "%s: compile register sequences fail\n", __func__);
+		goto probe_err_power_off;
+	}
+
 	sd = &sensor->subdev;
 	v4l2_i2c_subdev_init(sd, client, &imx219_subdev_ops);
 
@@ -1533,7 +1692,7 @@ static int imx219_probe(struct i2c_client *client)
 				IMX219_SENS_PADS_NUM,
 				sensor->pads);
 	if (retval < 0)
-		goto probe_err_power_off;
+		goto probe_err_seq_release;
 
 	
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 12, 0)
@@ -1563,6 +1722,9 @@ static int imx219_probe(struct i2c_client *client)
 probe_err_free_entiny:
 	media_entity_cleanup(&sd->entity);
 
+probe_err_seq_release:
+	vvsensor_seq_set_release(&sensor->seqs);
+
 probe_err_power_off:
 	imx219_power_off(sensor);
 
@@ -1578,6 +1740,7 @@ static void imx219_remove(struct i2c_client *client)
 
 	v4l2_async_unregister_subdev(sd);
 	media_entity_cleanup(&sd->entity);
+	vvsensor_seq_set_release(&sensor->seqs);
 
 	pm_runtime_disable(&client->dev);
 	if (!pm_runtime_status_suspended(&client->dev))
@@ -23,6 +23,7 @@
 #include <linux/of_gpio.h>
 #include <linux/pinctrl/consumer.h>
 #include <linux/regulator/consumer.h>
+#include <linux/slab.h>
 #include <linux/v4l2-mediabus.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-ctrls.h>
@@ -30,6 +31,7 @@
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include "vvsensor.h"
+#include "vvsensor_seq.h"
 
 #include "os08a20_regs_1080p.h"
 #include "os08a20_regs_1080p_hdr.h"
@@ -46,6 +48,8 @@
 #define OS08A20_SENS_PAD_SOURCE	0
 #define OS08A20_SENS_PADS_NUM	1
 
+#define OS08A20_GROUP_MAX	16	/* registers per group hold write */
+
 #define client_to_os08a20(client)\
 	container_of(i2c_get_clientdata(client), struct os08a20, subdev)
 
@@ -121,6 +125,8 @@ struct os08a20 {
 	struct mutex lock;
 	u32 stream_status;
 	u32 resume_status;
+	struct vvsensor_seq_set seqs;
+	u32 seq_mode;	/* OS08A20_SEQ() slot of cur_mode */
 };
 
 static struct vvcam_mode_info_s pos08a20_mode_info[] = {
@@ -412,64 +418,131 @@ static int os08a20_read_reg(struct os08a20 *sensor, u16 reg, u8 *val)
 	return 0;
 }
 
-static int os08a20_write_reg_arry(struct os08a20 *sensor,
-				  struct vvcam_sccb_data_s *reg_arry,
-				  u32 size)
+/*
+ * Every mode has two slots: the full table, and the same table without
+ * the stream and software reset writes for switching modes while
+ * streaming.
+ */
+#define OS08A20_SEQ(sensor, seamless) \
+	(&(sensor)->seqs.seq[(sensor)->seq_mode * 2 + (seamless)])
+
+static int os08a20_compile_switch(struct os08a20 *sensor,
+				  struct vvsensor_seq *seq,
+				  const struct vvcam_sccb_data_s *regs, u32 count)
 {
-	int i = 0;
-	int ret = 0;
-	struct i2c_msg msg;
-	u8 *send_buf;
-	u32 send_buf_len = 0;
-	struct i2c_client *i2c_client = sensor->i2c_client;
+	struct vvcam_sccb_data_s *sw;
+	u32 i, n = 0;
+	int ret;
 
-	send_buf = (u8 *)kmalloc(size + 2, GFP_KERNEL);
-	if (!send_buf)
+	sw = kmalloc_array(count, sizeof(*sw), GFP_KERNEL);
+	if (!sw)
 		return -ENOMEM;
 
-	send_buf[send_buf_len++] = (reg_arry[0].addr >> 8) & 0xff;
-	send_buf[send_buf_len++] = reg_arry[0].addr & 0xff;
-	send_buf[send_buf_len++] = reg_arry[0].data & 0xff;
-	for (i=1; i < size; i++) {
-		if (reg_arry[i].addr == (reg_arry[i-1].addr + 1)){
-			send_buf[send_buf_len++] = reg_arry[i].data & 0xff;
-		} else {
-			msg.addr  = i2c_client->addr;
-			msg.flags = i2c_client->flags;
-			msg.buf   = send_buf;
-			msg.len   = send_buf_len;
-			ret = i2c_transfer(i2c_client->adapter, &msg, 1);
-			if (ret < 0) {
-				pr_err("%s:i2c transfer error\n",__func__);
-				kfree(send_buf);
-				return ret;
-			}
-			send_buf_len = 0;
-			send_buf[send_buf_len++] =
-				(reg_arry[i].addr >> 8) & 0xff;
-			send_buf[send_buf_len++] =
-				reg_arry[i].addr & 0xff;
-			send_buf[send_buf_len++] =
-				reg_arry[i].data & 0xff;
-		}
+	for (i = 0; i < count; i++) {
+		if (regs[i].addr == 0x0100 || regs[i].addr == 0x0103)
+			continue;
+		sw[n++] = regs[i];
 	}
+	ret = vvsensor_compile_sequence(sensor->i2c_client, seq, sw, n, 1);
+	kfree(sw);
+	return ret;
+}
 
-	if (send_buf_len > 0) {
-		msg.addr  = i2c_client->addr;
-		msg.flags = i2c_client->flags;
-		msg.buf   = send_buf;
-		msg.len   = send_buf_len;
-		ret = i2c_transfer(i2c_client->adapter, &msg, 1);
-		if (ret < 0)
-			pr_err("%s:i2c transfer end meg error\n",__func__);
-		else
-			ret = 0;
+static int os08a20_compile_sequences(struct os08a20 *sensor)
+{
+	const struct vvcam_sccb_data_s *regs;
+	struct vvsensor_seq *seq;
+	u32 count;
+	int i, ret;
+
+	ret = vvsensor_seq_set_init(sensor->i2c_client, &sensor->seqs,
+				    ARRAY_SIZE(pos08a20_mode_info) * 2, "os08a20");
+	if (ret)
+		return ret;
 
+	for (i = 0; i < ARRAY_SIZE(pos08a20_mode_info); i++) {
+		regs = pos08a20_mode_info[i].preg_data;
+		count = pos08a20_mode_info[i].reg_data_count;
+
+		seq = &sensor->seqs.seq[i * 2];
+		snprintf(seq->name, sizeof(seq->name), "mode%u",
+			 pos08a20_mode_info[i].index);
+		ret = vvsensor_compile_sequence(sensor->i2c_client, seq,
+						regs, count, 1);
+		if (ret)
+			goto err;
+
+		seq = &sensor->seqs.seq[i * 2 + 1];
+		snprintf(seq->name, sizeof(seq->name), "mode%u-switch",
+			 pos08a20_mode_info[i].index);
+		ret = os08a20_compile_switch(sensor, seq, regs, count);
+		if (ret)
+			goto err;
 	}
-	kfree(send_buf);
+	return 0;
+
+err:
+	vvsensor_seq_set_release(&sensor->seqs);
 	return ret;
 }
 
+/*
+ * Write regs as a single i2c_transfer inside a group hold window (group
+ * 0, quick launch), so the sensor latches them together. Runs of
+ * consecutive addresses share one message.
+ */
+static int os08a20_write_group(struct os08a20 *sensor,
+			       const struct vvcam_sccb_data_s *regs, u32 count)
+{
+	struct i2c_client *i2c_client = sensor->i2c_client;
+	struct vvcam_sccb_data_s seq[OS08A20_GROUP_MAX + 3];
+	struct i2c_msg msgs[OS08A20_GROUP_MAX + 3];
+	u8 buf[(OS08A20_GROUP_MAX + 3) * 3];
+	u32 i, n = 0, nmsg = 0, len = 0;
+	int ret;
+
+	if (count > OS08A20_GROUP_MAX)
+		return -EINVAL;
+
+	seq[n].addr = 0x3208;
+	seq[n++].data = 0x00;
+	memcpy(&seq[n], regs, count * sizeof(*regs));
+	n += count;
+	seq[n].addr = 0x3208;
+	seq[n++].data = 0x10;
+	seq[n].addr = 0x3208;
+	seq[n++].data = 0xa0;
+
+	for (i = 0; i < n; i++) {
+		if (i == 0 || seq[i].addr != seq[i - 1].addr + 1) {
+			msgs[nmsg].addr  = i2c_client->addr;
+			msgs[nmsg].flags = i2c_client->flags;
+			msgs[nmsg].buf   = &buf[len];
+			msgs[nmsg].len   = 2;
+			buf[len++] = (seq[i].addr >> 8) & 0xff;
+			buf[len++] = seq[i].addr & 0xff;
+			nmsg++;
+		}
+		buf[len++] = seq[i].data & 0xff;
+		msgs[nmsg - 1].len++;
+	}
+
+	ret = i2c_transfer(i2c_client->adapter, msgs, nmsg);
+	if (ret != nmsg) {
+		pr_err("%s:i2c transfer error %d\n", __func__, ret);
+		return ret < 0 ? ret : -EIO;
+	}
+	return 0;
+}
+
+static inline void os08a20_group_add(struct vvcam_sccb_data_s *regs,
+				     u32 *n, u16 addr, u8 val)
+{
+	regs[*n].addr = addr;
+	regs[*n].data = val;
+	(*n)++;
+}
+
 static int os08a20_query_capability(struct os08a20 *sensor, void *arg)
 {
 	struct v4l2_capability *pcap = (struct v4l2_capability *)arg;
@@ -549,6 +622,7 @@ static int os08a20_set_sensor_mode(struct os08a20 *sensor, void* pmode)
 		if (pos08a20_mode_info[i].index == sensor_mode.index) {
 			memcpy(&sensor->cur_mode, &pos08a20_mode_info[i],
 				sizeof(struct vvcam_mode_info_s));
+			sensor->seq_mode = i;
 			return 0;
 		}
 	}
@@ -576,31 +650,36 @@ static int os08a20_set_vsexp(struct os08a20 *sensor, u32 exp)
 	return ret;
 }
 
-static int os08a20_set_gain(struct os08a20 *sensor, u32 total_gain)
+static void os08a20_calc_gain(u32 total_gain, u32 *again, u32 *dgain)
 {
-	int ret = 0;
-	u32 again = 0;
-	u32 dgain = 0;
-
 	if (total_gain < (1 << SENSOR_FIX_FRACBITS)) {
-		again = 0x80;
-		dgain = 0x400;
+		*again = 0x80;
+		*dgain = 0x400;
 	} else if (total_gain < 2 * (1 << SENSOR_FIX_FRACBITS)) {
-		again = ((total_gain * 16) / 0x400) * 8;
-		dgain =  total_gain * 128 / again;
+		*again = ((total_gain * 16) / 0x400) * 8;
+		*dgain =  total_gain * 128 / *again;
 	} else if (total_gain < 4 * (1 << SENSOR_FIX_FRACBITS)) {
-		again = ((total_gain * 8) / 0x400) * 16;
-		dgain =  total_gain * 128 / again;
+		*again = ((total_gain * 8) / 0x400) * 16;
+		*dgain =  total_gain * 128 / *again;
 	} else if (total_gain < 8 * (1 << SENSOR_FIX_FRACBITS)) {
-		again = ((total_gain * 4) / 0x400) * 32;
-		dgain =  total_gain * 128 / again;
+		*again = ((total_gain * 4) / 0x400) * 32;
+		*dgain =  total_gain * 128 / *again;
 	} else if (total_gain < 16 * (1 << SENSOR_FIX_FRACBITS)){
-		again = ((total_gain * 2) / 0x400) * 64;
-		dgain =  total_gain * 128 / again;
+		*again = ((total_gain * 2) / 0x400) * 64;
+		*dgain =  total_gain * 128 / *again;
 	} else {
-		again = 0x7c0;
-		dgain =  total_gain * 128 / again;
+		*again = 0x7c0;
+		*dgain =  total_gain * 128 / *again;
 	}
+}
+
+static int os08a20_set_gain(struct os08a20 *sensor, u32 total_gain)
+{
+	int ret = 0;
+	u32 again = 0;
+	u32 dgain = 0;
+
+	os08a20_calc_gain(total_gain, &again, &dgain);
 
 	ret |= os08a20_write_reg(sensor, 0x3508, (again >> 8) & 0xff);
 	ret |= os08a20_write_reg(sensor, 0x3509, again & 0xff);
@@ -617,25 +696,7 @@ static int os08a20_set_vsgain(struct os08a20 *sensor, u32 total_gain)
 	u32 again = 0;
 	u32 dgain = 0;
 
-	if (total_gain < (1 << SENSOR_FIX_FRACBITS)) {
-		again = 0x80;
-		dgain = 0x400;
-	} else if (total_gain < 2 * (1 << SENSOR_FIX_FRACBITS)) {
-		again = ((total_gain * 16) / 0x400) * 8;
-		dgain =  total_gain * 128 / again;
-	} else if (total_gain < 4 * (1 << SENSOR_FIX_FRACBITS)) {
-		again = ((total_gain * 8) / 0x400) * 16;
-		dgain =  total_gain * 128 / again;
-	} else if (total_gain < 8 * (1 << SENSOR_FIX_FRACBITS)) {
-		again = ((total_gain * 4) / 0x400) * 32;
-		dgain =  total_gain * 128 / again;
-	} else if (total_gain < 16 * (1 << SENSOR_FIX_FRACBITS)){
-		again = ((total_gain * 2) / 0x400) * 64;
-		dgain =  total_gain * 128 / again;
-	} else {
-		again = 0x7c0;
-		dgain =  total_gain * 128 / again;
-	}
+	os08a20_calc_gain(total_gain, &again, &dgain);
 
 	ret |= os08a20_write_reg(sensor, 0x350c, (again >> 8) & 0xff);
 	ret |= os08a20_write_reg(sensor, 0x350d, again & 0xff);
@@ -646,6 +707,17 @@ static int os08a20_set_vsgain(struct os08a20 *sensor, u32 total_gain)
 	return ret;
 }
 
+static void os08a20_update_vts(struct os08a20 *sensor, u32 vts)
+{
+	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
+		sensor->cur_mode.ae_info.max_integration_line = vts - 8;
+	} else {
+		sensor->cur_mode.ae_info.max_integration_line =
+			vts - sensor->cur_mode.ae_info.max_vsintegration_line - 8;
+	}
+	sensor->cur_mode.ae_info.curr_frm_len_lines = vts;
+}
+
 static int os08a20_set_fps(struct os08a20 *sensor, u32 fps)
 {
 	u32 vts;
@@ -664,15 +736,76 @@ static int os08a20_set_fps(struct os08a20 *sensor, u32 fps)
 	ret |= os08a20_write_reg(sensor, 0x380f, (u8)(vts & 0xff));
 
 	sensor->cur_mode.ae_info.cur_fps = fps;
+	os08a20_update_vts(sensor, vts);
+	return ret;
+}
 
-	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
-		sensor->cur_mode.ae_info.max_integration_line = vts - 8;
-	} else {
-		sensor->cur_mode.ae_info.max_integration_line =
-			vts - sensor->cur_mode.ae_info.max_vsintegration_line - 8;
+#define OS08A20_BATCH_FIELDS \
+	(VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_VS_EXP | VVSENSOR_BATCH_GAIN | \
+	 VVSENSOR_BATCH_VS_GAIN | VVSENSOR_BATCH_VTS)
+
+static int os08a20_set_exp_gain_batch(struct os08a20 *sensor,
+				      struct vvcam_exp_gain_batch_s *batch)
+{
+	struct vvcam_ae_info_s *pae_info = &sensor->cur_mode.ae_info;
+	struct vvcam_sccb_data_s regs[OS08A20_GROUP_MAX];
+	u32 n = 0, again, dgain;
+	int ret;
+
+	/* no separate long frame on this sensor */
+	if (batch->valid & ~OS08A20_BATCH_FIELDS)
+		return -EINVAL;
+	if ((batch->valid & VVSENSOR_BATCH_VTS) && !batch->vts)
+		return -EINVAL;
+
+	if (batch->valid & VVSENSOR_BATCH_EXP) {
+		os08a20_group_add(regs, &n, 0x3501, (batch->exp >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x3502, batch->exp & 0xff);
 	}
-	sensor->cur_mode.ae_info.curr_frm_len_lines = vts;
-	return ret;
+	if (batch->valid & VVSENSOR_BATCH_GAIN) {
+		os08a20_calc_gain(batch->gain, &again, &dgain);
+		os08a20_group_add(regs, &n, 0x3508, (again >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x3509, again & 0xff);
+		os08a20_group_add(regs, &n, 0x350a, (dgain >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x350b, dgain & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_VS_GAIN) {
+		os08a20_calc_gain(batch->vs_gain, &again, &dgain);
+		os08a20_group_add(regs, &n, 0x350c, (again >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x350d, again & 0xff);
+		os08a20_group_add(regs, &n, 0x350e, (dgain >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x350f, dgain & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_VS_EXP) {
+		os08a20_group_add(regs, &n, 0x3511, (batch->vs_exp >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x3512, batch->vs_exp & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_VTS) {
+		os08a20_group_add(regs, &n, 0x380e, (batch->vts >> 8) & 0xff);
+		os08a20_group_add(regs, &n, 0x380f, batch->vts & 0xff);
+	}
+	if (n == 0)
+		return 0;
+
+	ret = os08a20_write_group(sensor, regs, n);
+	if (ret)
+		return ret;
+
+	if (batch->valid & VVSENSOR_BATCH_VTS) {
+		/* the inverse of os08a20_set_fps, so G_FPS follows the vts */
+		pae_info->cur_fps = pae_info->max_fps *
+				    pae_info->def_frm_len_lines / batch->vts;
+		os08a20_update_vts(sensor, batch->vts);
+	}
+
+	batch->delay_frm = 0;
+	if (batch->valid & (VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_VS_EXP |
+			    VVSENSOR_BATCH_VTS))
+		batch->delay_frm = pae_info->int_update_delay_frm;
+	if (batch->valid & (VVSENSOR_BATCH_GAIN | VVSENSOR_BATCH_VS_GAIN))
+		batch->delay_frm = max_t(u32, batch->delay_frm,
+					 pae_info->gain_update_delay_frm);
+	return 0;
 }
 
 static int os08a20_get_fps(struct os08a20 *sensor, u32 *pfps)
@@ -794,6 +927,57 @@ static int os08a20_get_format_code(struct os08a20 *sensor, u32 *code)
 	}
 	return 0;
 }
+
+/*
+ * Standby takes effect at the end of the frame being read out, so the
+ * new mode starts on the next frame without a reset or a stream restart
+ * further down the pipeline.
+ */
+static int os08a20_set_sensor_mode_seamless(struct os08a20 *sensor,
+					    void *pmode)
+{
+	struct vvcam_mode_info_s sensor_mode;
+	u32 cur_fps = sensor->cur_mode.ae_info.cur_fps;
+	u32 frame_us;
+	int ret = 0;
+	int i;
+
+	if (copy_from_user(&sensor_mode, pmode, sizeof(sensor_mode)))
+		return -EFAULT;
+
+	for (i = 0; i < ARRAY_SIZE(pos08a20_mode_info); i++) {
+		if (pos08a20_mode_info[i].index == sensor_mode.index)
+			break;
+	}
+	if (i == ARRAY_SIZE(pos08a20_mode_info))
+		return -ENXIO;
+
+	memcpy(&sensor->cur_mode, &pos08a20_mode_info[i],
+		sizeof(struct vvcam_mode_info_s));
+	sensor->seq_mode = i;
+	if (!sensor->stream_status)
+		return 0;
+
+	/* standby only takes effect once the frame being read out ends */
+	ret = os08a20_write_reg(sensor, 0x0100, 0x00);
+	if (ret)
+		return -EIO;
+	frame_us = cur_fps ? (u32)div_u64((u64)USEC_PER_SEC <<
+			SENSOR_FIX_FRACBITS, cur_fps) : 100000;
+	usleep_range(frame_us, frame_us + 1000);
+
+	ret |= vvsensor_apply_sequence(sensor->i2c_client,
+				       OS08A20_SEQ(sensor, 1));
+	ret |= os08a20_write_reg(sensor, 0x0100, 0x01);
+	if (ret)
+		return -EIO;
+
+	sensor->format.width = sensor->cur_mode.size.bounds_width;
+	sensor->format.height = sensor->cur_mode.size.bounds_height;
+	os08a20_get_format_code(sensor, &sensor->format.code);
+	return 0;
+}
+
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 12, 0)
 static int os08a20_enum_mbus_code(struct v4l2_subdev *sd,
 				struct v4l2_subdev_state *state,
@@ -843,11 +1027,9 @@ static int os08a20_set_fmt(struct v4l2_subdev *sd,
 	os08a20_write_reg(sensor, 0x103, 0x01);
 	msleep(20);
 
-	ret = os08a20_write_reg_arry(sensor,
-		(struct vvcam_sccb_data_s *)sensor->cur_mode.preg_data,
-		sensor->cur_mode.reg_data_count);
+	ret = vvsensor_apply_sequence(client, OS08A20_SEQ(sensor, 0));
 	if (ret < 0) {
-		pr_err("%s:os08a20_write_reg_arry error\n",__func__);
+		pr_err("%s:vvsensor_apply_sequence error\n",__func__);
 		mutex_unlock(&sensor->lock);
 		return -EINVAL;
 	}
@@ -885,6 +1067,7 @@ static long os08a20_priv_ioctl(struct v4l2_subdev *sd,
 	struct os08a20 *sensor = client_to_os08a20(client);
 	long ret = 0;
 	struct vvcam_sccb_data_s sensor_reg;
+	struct vvcam_exp_gain_batch_s batch;
 	void *arg = arg_user;
 
 	mutex_lock(&sensor->lock);
@@ -921,6 +1104,9 @@ static long os08a20_priv_ioctl(struct v4l2_subdev *sd,
 	case VVSENSORIOC_S_SENSOR_MODE:
 		ret = os08a20_set_sensor_mode(sensor, arg);
 		break;
+	case VVSENSORIOC_S_SENSOR_MODE_SEAMLESS:
+		ret = os08a20_set_sensor_mode_seamless(sensor, arg);
+		break;
 	case VVSENSORIOC_S_STREAM:
 		USER_TO_KERNEL(int);
 		ret = os08a20_s_stream(&sensor->subdev, *(int *)arg);
@@ -959,6 +1145,15 @@ static long os08a20_priv_ioctl(struct v4l2_subdev *sd,
 		USER_TO_KERNEL(u32);
 		ret = os08a20_set_fps(sensor, *(u32 *)arg);
 		break;
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		if (copy_from_user(&batch, arg, sizeof(batch))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = os08a20_set_exp_gain_batch(sensor, &batch);
+		if (!ret && copy_to_user(arg, &batch, sizeof(batch)))
+			ret = -EFAULT;
+		break;
 	case VVSENSORIOC_G_FPS:
 		USER_TO_KERNEL(u32);
 		ret = os08a20_get_fps(sensor, (u32 *)arg);
@@ -989,9 +1184,34 @@ static const struct v4l2_subdev_pad_ops os08a20_subdev_pad_ops = {
 	.get_fmt = os08a20_get_fmt,
 };
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+/* requests from other drivers, arg is a kernel pointer */
+static long os08a20_command(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct os08a20 *sensor = client_to_os08a20(client);
+	long ret;
+
+	mutex_lock(&sensor->lock);
+	switch (cmd) {
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		ret = os08a20_set_exp_gain_batch(sensor, arg);
+		break;
+	default:
+		ret = -ENOIOCTLCMD;
+		break;
+	}
+	mutex_unlock(&sensor->lock);
+	return ret;
+}
+#endif
+
 static struct v4l2_subdev_core_ops os08a20_subdev_core_ops = {
 	.s_power = os08a20_s_power,
 	.ioctl = os08a20_priv_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	.command = os08a20_command,
+#endif
 };
 
 static struct v4l2_subdev_ops os08a20_subdev_ops = {
@@ -1296,6 +1516,12 @@ static int os08a20_probe(struct i2c_client *client,
 		goto probe_err_power_off;
 	}
 
+	retval = os08a20_compile_sequences(sensor);
+	if (retval < 0) {
+		dev_err(dev, "%s: compile register sequences fail\n", __func__);
+		goto probe_err_power_off;
+	}
+
 	sd = &sensor->subdev;
 	v4l2_i2c_subdev_init(sd, client, &os08a20_subdev_ops);
 	sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
@@ -1307,7 +1533,7 @@ static int os08a20_probe(struct i2c_client *client,
 				OS08A20_SENS_PADS_NUM,
 				sensor->pads);
 	if (retval < 0)
-		goto probe_err_power_off;
+		goto probe_err_seq_release;
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 12, 0)
 	retval = v4l2_async_register_subdev_sensor(sd);
 #else
@@ -1330,6 +1556,9 @@ static int os08a20_probe(struct i2c_client *client,
 probe_err_free_entiny:
 	media_entity_cleanup(&sd->entity);
 
+probe_err_seq_release:
+	vvsensor_seq_set_release(&sensor->seqs);
+
 probe_err_power_off:
 	os08a20_power_off(sensor);
 
@@ -1352,6 +1581,7 @@ static void os08a20_remove(struct i2c_client *client)
 
 	v4l2_async_unregister_subdev(sd);
 	media_entity_cleanup(&sd->entity);
+	vvsensor_seq_set_release(&sensor->seqs);
 	os08a20_power_off(sensor);
 	os08a20_regulator_disable(sensor);
 	mutex_destroy(&sensor->lock);
@@ -30,6 +30,7 @@
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include "vvsensor.h"
+#include "vvsensor_seq.h"
 
 #include "ov2775_regs_1080p.h"
 #include "ov2775_regs_1080p_hdr.h"
@@ -50,6 +51,8 @@
 #define OV2775_RESERVE_ID 0X2770
 #define DCG_CONVERSION_GAIN 11
 
+#define OV2775_GROUP_MAX	16	/* registers per group hold write */
+
 #define client_to_ov2775(client)\
 	container_of(i2c_get_clientdata(client), struct ov2775, subdev)
 
@@ -84,6 +87,8 @@ struct ov2775 {
 	u32 resume_status;
 	u32 hcg_again;
 	u32 hcg_dgain;
+	struct vvsensor_seq_set seqs;
+	u32 seq_mode;	/* OV2775_SEQ() slot of cur_mode */
 };
 
 static struct vvcam_mode_info_s pov2775_mode_info[] = {
@@ -444,61 +449,133 @@ static int ov2775_read_reg(struct ov2775 *sensor, u16 reg, u8 *val)
 	return 0;
 }
 
-static int ov2775_write_reg_arry(struct ov2775 *sensor,
-				 struct vvcam_sccb_data_s *reg_arry,
-				 u32 size)
+/*
+ * Write regs as a single i2c_transfer inside the group hold window the
+ * single-value setters use, so the sensor latches them together. Runs
+ * of consecutive addresses share one message.
+ */
+static int ov2775_write_group(struct ov2775 *sensor,
+			      const struct vvcam_sccb_data_s *regs, u32 count)
 {
-	int i = 0;
-	int ret = 0;
-	struct i2c_msg msg;
-	u8 *send_buf;
-	u32 send_buf_len = 0;
+	static const struct vvcam_sccb_data_s hold_start[] = {
+		{ 0x3467, 0x00 }, { 0x3464, 0x04 },
+	};
+	static const struct vvcam_sccb_data_s hold_end[] = {
+		{ 0x3464, 0x14 }, { 0x3467, 0x01 },
+	};
 	struct i2c_client *i2c_client = sensor->i2c_client;
+	struct vvcam_sccb_data_s seq[OV2775_GROUP_MAX + 4];
+	struct i2c_msg msgs[OV2775_GROUP_MAX + 4];
+	u8 buf[(OV2775_GROUP_MAX + 4) * 3];
+	u32 i, n = 0, nmsg = 0, len = 0;
+	int ret;
 
-	send_buf = (u8 *)kmalloc(size + 2, GFP_KERNEL);
-	if (!send_buf)
-		return -ENOMEM;
+	if (count > OV2775_GROUP_MAX)
+		return -EINVAL;
 
-	send_buf[send_buf_len++] = (reg_arry[0].addr >> 8) & 0xff;
-	send_buf[send_buf_len++] = reg_arry[0].addr & 0xff;
-	send_buf[send_buf_len++] = reg_arry[0].data & 0xff;
-	for (i=1; i < size; i++) {
-		if (reg_arry[i].addr == (reg_arry[i-1].addr + 1)){
-			send_buf[send_buf_len++] = reg_arry[i].data & 0xff;
-		} else {
-			msg.addr  = i2c_client->addr;
-			msg.flags = i2c_client->flags;
-			msg.buf   = send_buf;
-			msg.len   = send_buf_len;
-			ret = i2c_transfer(i2c_client->adapter, &msg, 1);
-			if (ret < 0) {
-				pr_err("%s:i2c transfer error\n",__func__);
-				kfree(send_buf);
-				return ret;
-			}
-			send_buf_len = 0;
-			send_buf[send_buf_len++] =
-				(reg_arry[i].addr >> 8) & 0xff;
-			send_buf[send_buf_len++] =
-				reg_arry[i].addr & 0xff;
-			send_buf[send_buf_len++] =
-				reg_arry[i].data & 0xff;
+	memcpy(&seq[n], hold_start, sizeof(hold_start));
+	n += ARRAY_SIZE(hold_start);
+	memcpy(&seq[n], regs, count * sizeof(*regs));
+	n += count;
+	memcpy(&seq[n], hold_end, sizeof(hold_end));
+	n += ARRAY_SIZE(hold_end);
+
+	for (i = 0; i < n; i++) {
+		if (i == 0 || seq[i].addr != seq[i - 1].addr + 1) {
+			msgs[nmsg].addr  = i2c_client->addr;
+			msgs[nmsg].flags = i2c_client->flags;
+			msgs[nmsg].buf   = &buf[len];
+			msgs[nmsg].len   = 2;
+			buf[len++] = (seq[i].addr >> 8) & 0xff;
+			buf[len++] = seq[i].addr & 0xff;
+			nmsg++;
 		}
+		buf[len++] = seq[i].data & 0xff;
+		msgs[nmsg - 1].len++;
 	}
 
-	if (send_buf_len > 0) {
-		msg.addr  = i2c_client->addr;
-		msg.flags = i2c_client->flags;
-		msg.buf   = send_buf;
-		msg.len   = send_buf_len;
-		ret = i2c_transfer(i2c_client->adapter, &msg, 1);
-		if (ret < 0)
-			pr_err("%s:i2c transfer end meg error\n",__func__);
-		else
-			ret = 0;
+	ret = i2c_transfer(i2c_client->adapter, msgs, nmsg);
+	if (ret != nmsg) {
+		pr_err("%s:i2c transfer error %d\n", __func__, ret);
+		return ret < 0 ? ret : -EIO;
+	}
+	return 0;
+}
+
+static inline void ov2775_group_add(struct vvcam_sccb_data_s *regs,
+				    u32 *n, u16 addr, u8 val)
+{
+	regs[*n].addr = addr;
+	regs[*n].data = val;
+	(*n)++;
+}
+
+/*
+ * Every mode and the low pixel clock variant of the HDR mode get two
+ * sequences: the full init table and its 0x7000+ part, which is lost in
+ * standby and resent before streaming restarts.
+ */
+#define OV2775_SEQ_LOW_FREQ	ARRAY_SIZE(pov2775_mode_info)
+#define OV2775_SEQ_MODES	(OV2775_SEQ_LOW_FREQ + 1)
+#define OV2775_SEQ(sensor, restream) \
+	(&(sensor)->seqs.seq[(sensor)->seq_mode * 2 + (restream)])
+
+static int ov2775_compile_mode(struct ov2775 *sensor, u32 slot,
+			       const struct vvcam_sccb_data_s *regs, u32 count)
+{
+	struct i2c_client *client = sensor->i2c_client;
+	struct vvsensor_seq *seq = &sensor->seqs.seq[slot * 2];
+	struct vvcam_sccb_data_s *restream;
+	u32 i, n = 0;
+	int ret;
+
+	snprintf(seq[0].name, sizeof(seq[0].name), "mode%u%s",
+		 slot == OV2775_SEQ_LOW_FREQ ? 1 : slot,
+		 slot == OV2775_SEQ_LOW_FREQ ? " low_freq" : "");
+	snprintf(seq[1].name, sizeof(seq[1].name), "%s restream",
+		 seq[0].name);
+	ret = vvsensor_compile_sequence(client, &seq[0], regs, count, 1);
+	if (ret)
+		return ret;
+
+	restream = kmalloc_array(count, sizeof(*restream), GFP_KERNEL);
+	if (!restream)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		if (regs[i].addr >= 0x7000)
+			restream[n++] = regs[i];
+	}
+	if (n)
+		ret = vvsensor_compile_sequence(client, &seq[1], restream, n, 1);
+	kfree(restream);
+	return ret;
+}
+
+static int ov2775_compile_sequences(struct ov2775 *sensor)
+{
+	int i, ret;
 
+	ret = vvsensor_seq_set_init(sensor->i2c_client, &sensor->seqs,
+				    OV2775_SEQ_MODES * 2, "ov2775");
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ARRAY_SIZE(pov2775_mode_info); i++) {
+		ret = ov2775_compile_mode(sensor, i,
+			(struct vvcam_sccb_data_s *)pov2775_mode_info[i].preg_data,
+			pov2775_mode_info[i].reg_data_count);
+		if (ret)
+			goto err;
 	}
-	kfree(send_buf);
+	ret = ov2775_compile_mode(sensor, OV2775_SEQ_LOW_FREQ,
+				  ov2775_init_setting_1080p_hdr_low_freq,
+				  ARRAY_SIZE(ov2775_init_setting_1080p_hdr_low_freq));
+	if (ret)
+		goto err;
+	return 0;
+
+err:
+	vvsensor_seq_set_release(&sensor->seqs);
 	return ret;
 }
 
@@ -582,8 +659,10 @@ static int ov2775_set_sensor_mode(struct ov2775 *sensor, void* pmode)
 		if (pov2775_mode_info[i].index == sensor_mode.index) {
 			memcpy(&sensor->cur_mode, &pov2775_mode_info[i],
 				sizeof(struct vvcam_mode_info_s));
+			sensor->seq_mode = i;
 			if ((pov2775_mode_info[i].index == 1) &&
 			    (sensor->ocp.max_pixel_frequency == 266000000)) {
+				sensor->seq_mode = OV2775_SEQ_LOW_FREQ;
 				sensor->cur_mode.preg_data =
 					ov2775_init_setting_1080p_hdr_low_freq;
 				sensor->cur_mode.reg_data_count =
@@ -657,6 +736,20 @@ static int ov2775_set_lgain(struct ov2775 *sensor, u32 gain)
 	return 0;
 }
 
+static void ov2775_calc_gain(u32 gain, u32 *again, u32 *dgain)
+{
+	if (gain < (3 << 10))
+		gain = 3 << 10;
+
+	if (gain < (6 << 10))
+		*again = 1;
+	else if (gain < (12 << 10))
+		*again = 2;
+	else
+		*again = 3;
+	*dgain = (gain * 0x100) / ((1 << *again) << 10);
+}
+
 static int ov2775_set_gain(struct ov2775 *sensor, u32 gain)
 {
 	int ret = 0;
@@ -664,20 +757,7 @@ static int ov2775_set_gain(struct ov2775 *sensor, u32 gain)
 	u32 dgain = 0;
 	u8 reg_val;
 
-	if (gain < (3 << 10)){
-		gain = 3  << 10;
-	}
-
-	if (gain < (3 << 10)) {
-		again = 0;
-	} else if (gain < (6 << 10)) {
-		again = 1;
-	} else if (gain < (12 << 10)) {
-		again = 2;
-	} else {
-		again = 3;
-	}
-	dgain = (gain * 0x100) / (( 1<< again) << 10);
+	ov2775_calc_gain(gain, &again, &dgain);
 
 	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
 		ret = ov2775_read_reg(sensor, 0x30bb, &reg_val);
@@ -727,20 +807,7 @@ static int ov2775_set_vsgain(struct ov2775 *sensor, u32 gain)
 	u32 dgain = 0;
 	u8 reg_val;
 
-	if (gain < (3 << 10)) {
-		gain = (3 << 10);
-	}
-
-	if (gain < (3 << 10)) {
-		again = 0;
-	} else if (gain < (6 << 10)) {
-		again = 1;
-	} else if (gain < (12 << 10)) {
-		again = 2;
-	} else {
-		again = 3;
-	}
-	dgain = (gain * 0x100) / ((1 << again) << 10);
+	ov2775_calc_gain(gain, &again, &dgain);
 
 	ret = ov2775_read_reg(sensor, 0x30bb, &reg_val);
 	reg_val &= ~0x30;
@@ -759,6 +826,23 @@ static int ov2775_set_vsgain(struct ov2775 *sensor, u32 gain)
 	return ret;
 }
 
+static void ov2775_update_vts(struct ov2775 *sensor, u32 vts)
+{
+	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
+		sensor->cur_mode.ae_info.max_integration_line = vts - 4;
+	} else {
+		if (sensor->cur_mode.stitching_mode ==
+		    SENSOR_STITCHING_DUAL_DCG){
+			sensor->cur_mode.ae_info.max_vsintegration_line = 44;
+			sensor->cur_mode.ae_info.max_integration_line = vts -
+				4 - sensor->cur_mode.ae_info.max_vsintegration_line;
+		} else {
+			sensor->cur_mode.ae_info.max_integration_line = vts - 4;
+		}
+	}
+	sensor->cur_mode.ae_info.curr_frm_len_lines = vts;
+}
+
 static int ov2775_set_fps(struct ov2775 *sensor, u32 fps)
 {
 	u32 vts;
@@ -777,21 +861,111 @@ static int ov2775_set_fps(struct ov2775 *sensor, u32 fps)
 	ret |= ov2775_write_reg(sensor, 0x30B3, (u8)(vts & 0xff));
 
 	sensor->cur_mode.ae_info.cur_fps = fps;
+	ov2775_update_vts(sensor, vts);
+	return ret;
+}
 
-	if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
-		sensor->cur_mode.ae_info.max_integration_line = vts - 4;
-	} else {
-		if (sensor->cur_mode.stitching_mode ==
-		    SENSOR_STITCHING_DUAL_DCG){
-			sensor->cur_mode.ae_info.max_vsintegration_line = 44;
-			sensor->cur_mode.ae_info.max_integration_line = vts -
-				4 - sensor->cur_mode.ae_info.max_vsintegration_line;
+#define OV2775_BATCH_FIELDS \
+	(VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_VS_EXP | VVSENSOR_BATCH_LONG_GAIN | \
+	 VVSENSOR_BATCH_GAIN | VVSENSOR_BATCH_VS_GAIN | VVSENSOR_BATCH_VTS)
+#define OV2775_BATCH_GAINS \
+	(VVSENSOR_BATCH_LONG_GAIN | VVSENSOR_BATCH_GAIN | VVSENSOR_BATCH_VS_GAIN)
+
+static int ov2775_set_exp_gain_batch(struct ov2775 *sensor,
+				     struct vvcam_exp_gain_batch_s *batch)
+{
+	struct vvcam_ae_info_s *pae_info = &sensor->cur_mode.ae_info;
+	struct vvcam_sccb_data_s regs[OV2775_GROUP_MAX];
+	u32 n = 0, again, dgain;
+	u8 reg_val = 0;
+	int ret;
+
+	/* the long exposure is fixed by the mode, see ov2775_set_lexp */
+	if (batch->valid & ~OV2775_BATCH_FIELDS)
+		return -EINVAL;
+	if ((batch->valid & VVSENSOR_BATCH_VTS) && !batch->vts)
+		return -EINVAL;
+
+	/* the long gain is the hcg gain, which only hdr modes have */
+	if ((batch->valid & VVSENSOR_BATCH_LONG_GAIN) &&
+	    sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR)
+		return -EINVAL;
+
+	if (batch->valid & OV2775_BATCH_GAINS) {
+		ret = ov2775_read_reg(sensor, 0x30bb, &reg_val);
+		if (ret)
+			return ret;
+	}
+	if (batch->valid & VVSENSOR_BATCH_LONG_GAIN)
+		ov2775_set_lgain(sensor, batch->long_gain);
+	/* in hdr 0x315a/b hold the hcg gain, rewritten with either gain */
+	if (sensor->cur_mode.hdr_mode != SENSOR_MODE_LINEAR &&
+	    (batch->valid & (VVSENSOR_BATCH_LONG_GAIN | VVSENSOR_BATCH_GAIN))) {
+		reg_val &= ~0x03;
+		reg_val |= sensor->hcg_again & 0x03;
+		ov2775_group_add(regs, &n, 0x315a,
+				 (sensor->hcg_dgain >> 8) & 0xff);
+		ov2775_group_add(regs, &n, 0x315b, sensor->hcg_dgain & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_GAIN) {
+		ov2775_calc_gain(batch->gain, &again, &dgain);
+		if (sensor->cur_mode.hdr_mode == SENSOR_MODE_LINEAR) {
+			reg_val &= ~0x03;
+			reg_val |= again & 0x03;
+			ov2775_group_add(regs, &n, 0x315a, (dgain >> 8) & 0xff);
+			ov2775_group_add(regs, &n, 0x315b, dgain & 0xff);
 		} else {
-			sensor->cur_mode.ae_info.max_integration_line = vts - 4;
+			reg_val &= ~0x0c;
+			reg_val |= (again & 0x03) << 2;
+			ov2775_group_add(regs, &n, 0x315c, (dgain >> 8) & 0xff);
+			ov2775_group_add(regs, &n, 0x315d, dgain & 0xff);
 		}
 	}
-	sensor->cur_mode.ae_info.curr_frm_len_lines = vts;
-	return ret;
+	if (batch->valid & VVSENSOR_BATCH_VS_GAIN) {
+		ov2775_calc_gain(batch->vs_gain, &again, &dgain);
+		reg_val &= ~0x30;
+		reg_val |= (again & 0x03) << 4;
+		ov2775_group_add(regs, &n, 0x315e, (dgain >> 8) & 0xff);
+		ov2775_group_add(regs, &n, 0x315f, dgain & 0xff);
+	}
+	if (batch->valid & OV2775_BATCH_GAINS)
+		ov2775_group_add(regs, &n, 0x30bb, reg_val);
+	if (batch->valid & VVSENSOR_BATCH_VTS) {
+		ov2775_group_add(regs, &n, 0x30b2, (batch->vts >> 8) & 0xff);
+		ov2775_group_add(regs, &n, 0x30b3, batch->vts & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_EXP) {
+		ov2775_group_add(regs, &n, 0x30b6, (batch->exp >> 8) & 0xff);
+		ov2775_group_add(regs, &n, 0x30b7, batch->exp & 0xff);
+	}
+	if (batch->valid & VVSENSOR_BATCH_VS_EXP) {
+		u32 vs_exp = batch->vs_exp == 0x16 ? 0x17 : batch->vs_exp;
+
+		ov2775_group_add(regs, &n, 0x30b8, (vs_exp >> 8) & 0xff);
+		ov2775_group_add(regs, &n, 0x30b9, vs_exp & 0xff);
+	}
+	if (n == 0)
+		return 0;
+
+	ret = ov2775_write_group(sensor, regs, n);
+	if (ret)
+		return ret;
+
+	if (batch->valid & VVSENSOR_BATCH_VTS) {
+		/* the inverse of ov2775_set_fps, so G_FPS follows the vts */
+		pae_info->cur_fps = pae_info->max_fps *
+				    pae_info->def_frm_len_lines / batch->vts;
+		ov2775_update_vts(sensor, batch->vts);
+	}
+
+	batch->delay_frm = 0;
+	if (batch->valid & (VVSENSOR_BATCH_EXP | VVSENSOR_BATCH_VS_EXP |
+			    VVSENSOR_BATCH_VTS))
+		batch->delay_frm = pae_info->int_update_delay_frm;
+	if (batch->valid & OV2775_BATCH_GAINS)
+		batch->delay_frm = max_t(u32, batch->delay_frm,
+					 pae_info->gain_update_delay_frm);
+	return 0;
 }
 
 static int ov2775_get_fps(struct ov2775 *sensor, u32 *pfps)
@@ -1090,13 +1264,6 @@ static int ov2775_s_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct ov2775 *sensor = client_to_ov2775(client);
-	struct i2c_msg msg;
-	u8 *i2c_send_buf;
-	u32 i2c_send_buf_len = 0;
-	struct vvcam_sccb_data_s *sensor_reg_cfg;
-	u32 sensor_reg_size = 0;
-	int i = 0;
-	int ret;
 
 	pr_debug("enter %s\n", __func__);
 	sensor->stream_status = enable;
@@ -1109,63 +1276,9 @@ static int ov2775_s_stream(struct v4l2_subdev *sd, int enable)
 		* all registers starting with 0x7000 must be resent
 		* before setting 0x3012[0]=1.
 		*/
-		sensor_reg_cfg =
-			(struct vvcam_sccb_data_s *)sensor->cur_mode.preg_data;
-		sensor_reg_size = sensor->cur_mode.reg_data_count;
-
-		i2c_send_buf = (u8 *)kmalloc(sensor_reg_size + 2, GFP_KERNEL);
-		if (!i2c_send_buf) {
-			pr_err("%s:kmalloc i2c_send_buf failed\n",__func__);
-			return -ENOMEM;
-		}
-		for (i = 0; i < sensor_reg_size; i++) {
-			if (sensor_reg_cfg[i].addr >= 0x7000) {
-				if (i2c_send_buf_len == 0) {
-					i2c_send_buf[i2c_send_buf_len++] =
-						(sensor_reg_cfg[i].addr >> 8) & 0xff;
-					i2c_send_buf[i2c_send_buf_len++] =
-						sensor_reg_cfg[i].addr & 0xff;
-					i2c_send_buf[i2c_send_buf_len++] =
-						sensor_reg_cfg[i].data & 0xff;
-				} else {
-					if (sensor_reg_cfg[i].addr == (sensor_reg_cfg[i-1].addr + 1)) {
-						i2c_send_buf[i2c_send_buf_len++] =
-							sensor_reg_cfg[i].data & 0xff;
-					} else {
-						msg.addr	= client->addr;
-						msg.flags	= client->flags;
-						msg.buf 	= i2c_send_buf;
-						msg.len 	= i2c_send_buf_len;
-						ret = i2c_transfer(client->adapter, &msg, 1);
-						if (ret < 0) {
-							kfree(i2c_send_buf);
-							pr_err("%s:i2c transfer error\n",__func__);
-							return -EBUSY;
-						}
-						i2c_send_buf_len = 0;
-						i2c_send_buf[i2c_send_buf_len++] =
-							(sensor_reg_cfg[i].addr >> 8) & 0xff;
-						i2c_send_buf[i2c_send_buf_len++] =
-							sensor_reg_cfg[i].addr & 0xff;
-						i2c_send_buf[i2c_send_buf_len++] =
-							sensor_reg_cfg[i].data & 0xff;
-					}
-				}
-			}
-		}
-		if (i2c_send_buf_len > 0) {
-			msg.addr	= client->addr;
-			msg.flags	= client->flags;
-			msg.buf 	= i2c_send_buf;
-			msg.len 	= i2c_send_buf_len;
-			ret = i2c_transfer(client->adapter, &msg, 1);
-			if (ret < 0) {
-				kfree(i2c_send_buf);
-				pr_err("%s:i2c transfer error\n",__func__);
-				return -EBUSY;
-			}
-		}
-		kfree(i2c_send_buf);
+		if (OV2775_SEQ(sensor, 1)->nregs &&
+		    vvsensor_apply_sequence(client, OV2775_SEQ(sensor, 1)))
+			return -EBUSY;
 	}
 
 	return 0;
@@ -1220,11 +1333,9 @@ static int ov2775_set_fmt(struct v4l2_subdev *sd,
 	ov2775_write_reg(sensor, 0x3013, 0x01);
 	msleep(20);
 
-	ret = ov2775_write_reg_arry(sensor,
-		(struct vvcam_sccb_data_s *)sensor->cur_mode.preg_data,
-		sensor->cur_mode.reg_data_count);
+	ret = vvsensor_apply_sequence(client, OV2775_SEQ(sensor, 0));
 	if (ret < 0) {
-		pr_err("%s:ov2775_write_reg_arry error\n",__func__);
+		pr_err("%s:vvsensor_apply_sequence error\n",__func__);
 		mutex_unlock(&sensor->lock);
 		return -EINVAL;
 	}
@@ -1266,6 +1377,7 @@ static long ov2775_priv_ioctl(struct v4l2_subdev *sd,
 	uint32_t value = 0;
 	sensor_blc_t blc;
 	sensor_expand_curve_t expand_curve;
+	struct vvcam_exp_gain_batch_s batch;
 
 	mutex_lock(&sensor->lock);
 	switch (cmd){
@@ -1345,6 +1457,15 @@ static long ov2775_priv_ioctl(struct v4l2_subdev *sd,
 		ret = copy_from_user(&value, arg, sizeof(value));
 		ret |= ov2775_set_fps(sensor, value);
 		break;
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		if (copy_from_user(&batch, arg, sizeof(batch))) {
+			ret = -EFAULT;
+			break;
+		}
+		ret = ov2775_set_exp_gain_batch(sensor, &batch);
+		if (!ret && copy_to_user(arg, &batch, sizeof(batch)))
+			ret = -EFAULT;
+		break;
 	case VVSENSORIOC_G_FPS:
 		ret = ov2775_get_fps(sensor, &value);
 		ret |= copy_to_user(arg, &value, sizeof(value));
@@ -1386,9 +1507,34 @@ static const struct v4l2_subdev_pad_ops ov2775_subdev_pad_ops = {
 	.get_fmt = ov2775_get_fmt,
 };
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+/* requests from other drivers, arg is a kernel pointer */
+static long ov2775_command(struct v4l2_subdev *sd, unsigned int cmd, void *arg)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct ov2775 *sensor = client_to_ov2775(client);
+	long ret;
+
+	mutex_lock(&sensor->lock);
+	switch (cmd) {
+	case VVSENSORIOC_S_EXP_GAIN_BATCH:
+		ret = ov2775_set_exp_gain_batch(sensor, arg);
+		break;
+	default:
+		ret = -ENOIOCTLCMD;
+		break;
+	}
+	mutex_unlock(&sensor->lock);
+	return ret;
+}
+#endif
+
 static struct v4l2_subdev_core_ops ov2775_subdev_core_ops = {
 	.s_power = ov2775_s_power,
 	.ioctl = ov2775_priv_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	.command = ov2775_command,
+#endif
 };
 
 static struct v4l2_subdev_ops ov2775_subdev_ops = {
@@ -1690,6 +1836,12 @@ static int ov2775_probe(struct i2c_client *client,
 		goto probe_err_power_off;
 	}
 
+	retval = ov2775_compile_sequences(sensor);
+	if (retval < 0) {
+		dev_err(dev, "%s: compile register sequences fail\n", __func__);
+		goto probe_err_power_off;
+	}
+
 	sd = &sensor->subdev;
 	v4l2_i2c_subdev_init(sd, client, &ov2775_subdev_ops);
 	sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
@@ -1701,7 +1853,7 @@ static int ov2775_probe(struct i2c_client *client,
 				OV2775_SENS_PADS_NUM,
 				sensor->pads);
 	if (retval < 0)
-		goto probe_err_power_off;
+		goto probe_err_seq_release;
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 12, 0)
 	retval = v4l2_async_register_subdev_sensor(sd);
 #else
@@ -1724,6 +1876,9 @@ static int ov2775_probe(struct i2c_client *client,
 probe_err_free_entiny:
 	media_entity_cleanup(&sd->entity);
 
+probe_err_seq_release:
+	vvsensor_seq_set_release(&sensor->seqs);
+
 probe_err_power_off:
 	ov2775_power_off(sensor);
 
@@ -1746,6 +1901,7 @@ static void ov2775_remove(struct i2c_client *client)
 
 	v4l2_async_unregister_subdev(sd);
 	media_entity_cleanup(&sd->entity);
+	vvsensor_seq_set_release(&sensor->seqs);
 	ov2775_power_off(sensor);
 	ov2775_regulator_disable(sensor);
 	mutex_destroy(&sensor->lock);
@@ -48,6 +48,7 @@
 #include "ov5695_regs_1080p.h"
 #include "ov5695_regs_init.h"
 #include "vvsensor.h"
+#include "vvsensor_seq.h"
 
 #ifndef V4L2_CID_DIGITAL_GAIN
     #define V4L2_CID_DIGITAL_GAIN V4L2_CID_GAIN
@@ -149,6 +150,9 @@ struct ov5695 {
 
     const struct ov5695_mode*
         legacy_mode; /*!< Old driver mode. TODO: Move it to vvcam mode. */
+
+    struct vvsensor_seq_set seqs; /*!< Compiled register tables */
+    u32 seq_mode;                 /*!< seqs slot of cur_mode */
 };
 
 static struct vvcam_mode_info_s ov5695_mode_info[] = {
@@ -503,16 +507,44 @@ static int ov5695_write_reg(struct i2c_client* client, u16 reg, u32 len,
     return 0;
 }
 
-static int ov5695_write_array(struct i2c_client* client,
-                              const struct vvcam_sccb_data_s* regs, u32 size)
+/* One sequence per mode, followed by the common init table */
+#define OV5695_SEQ_INIT ARRAY_SIZE(ov5695_mode_info)
+#define OV5695_SEQ_NUM  (OV5695_SEQ_INIT + 1)
+
+static int ov5695_compile_sequences(struct ov5695* ov5695)
 {
-    u32 i;
-    int ret = 0;
+    struct i2c_client* client = ov5695->i2c_client;
+    struct vvsensor_seq* seq;
+    int i, ret;
+
+    ret = vvsensor_seq_set_init(client, &ov5695->seqs, OV5695_SEQ_NUM,
+                                "ov5695");
+    if (ret)
+        return ret;
+
+    for (i = 0; i < ARRAY_SIZE(ov5695_mode_info); i++) {
+        seq = &ov5695->seqs.seq[i];
+        snprintf(seq->name, sizeof(seq->name), "mode%u",
+                 ov5695_mode_info[i].index);
+        ret = vvsensor_compile_sequence(
+            client, seq,
+            (struct vvcam_sccb_data_s*)ov5695_mode_info[i].preg_data,
+            ov5695_mode_info[i].reg_data_count, 1);
+        if (ret)
+            goto err;
+    }
 
-    for (i = 0; i < size; i++)
-        ret = ov5695_write_reg(client, regs[i].addr, OV5695_REG_VALUE_08BIT,
-                               regs[i].data);
+    seq = &ov5695->seqs.seq[OV5695_SEQ_INIT];
+    snprintf(seq->name, sizeof(seq->name), "init");
+    ret = vvsensor_compile_sequence(client, seq, ov5695_regs_init,
+                                    ARRAY_SIZE(ov5695_regs_init), 1);
+    if (ret)
+        goto err;
+
+    return 0;
 
+err:
+    vvsensor_seq_set_release(&ov5695->seqs);
     return ret;
 }
 
@@ -576,10 +608,12 @@ static int ov5695_set_fmt(struct v4l2_subdev* sd,
         return -EINVAL;
     }
 
-    ret = ov5695_write_array(ov5695->i2c_client, ov5695_regs_init,
-                             ARRAY_SIZE(ov5695_regs_init));
-    if (ret)
+    ret = vvsensor_apply_sequence(ov5695->i2c_client,
+                                  &ov5695->seqs.seq[OV5695_SEQ_INIT]);
+    if (ret) {
+        mutex_unlock(&ov5695->mutex);
         return ret;
+    }
 
     // Set number of lanes
     reg = OV5695_MIPI_SC_CTRL_PHY_RTS | OV5695_MIPI_SC_CTRL_MIPI_EN;
@@ -592,10 +626,8 @@ static int ov5695_set_fmt(struct v4l2_subdev* sd,
                            OV5695_REG_VALUE_08BIT, reg);
 
     // Set default mode
-    ret = ov5695_write_array(
-        ov5695->i2c_client,
-        (struct vvcam_sccb_data_s*)ov5695->cur_mode.preg_data,
-        ov5695->cur_mode.reg_data_count);
+    ret = vvsensor_apply_sequence(ov5695->i2c_client,
+                                  &ov5695->seqs.seq[ov5695->seq_mode]);
 
     fmt->format.code   = MEDIA_BUS_FMT_SBGGR10_1X10;
     fmt->format.field  = V4L2_FIELD_NONE;
@@ -1238,6 +1270,7 @@ static int ov5695_set_sensor_mode(struct ov5695* sensor, void* pmode)
         if (ov5695_mode_info[i].index == sensor_mode.index) {
             memcpy(&sensor->cur_mode, &ov5695_mode_info[i],
                    sizeof(struct vvcam_mode_info_s));
+            sensor->seq_mode = i;
 
             dev_info(&sensor->i2c_client->dev, "Set sensor mode: %d, %dx%d\n",
                      sensor->cur_mode.index, sensor->cur_mode.size.width,
@@ -1671,6 +1704,12 @@ static int ov5695_probe(struct i2c_client* client)
 
     print_version(ov5695);
 
+    ret = ov5695_compile_sequences(ov5695);
+    if (ret) {
+        dev_err(dev, "Failed to compile register sequences\n");
+        goto err_power_off;
+    }
+
     // sd->internal_ops = &ov5695_internal_ops;
     sd->flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
 
@@ -1680,7 +1719,7 @@ static int ov5695_probe(struct i2c_client* client)
     ret                 = media_entity_pads_init(&sd->entity, 1, &ov5695->pad);
 
     if (ret < 0)
-        goto err_power_off;
+        goto err_seq_release;
 
     ret = v4l2_async_register_subdev_sensor(sd);
 
@@ -1712,6 +1751,8 @@ err_clean_entity:
 #if defined(CONFIG_MEDIA_CONTROLLER)
     media_entity_cleanup(&sd->entity);
 #endif
+err_seq_release:
+    vvsensor_seq_set_release(&ov5695->seqs);
 err_power_off:
     __ov5695_power_off(ov5695);
     // regulator_bulk_disable(OV5695_NUM_SUPPLIES, ov5695->supplies);
@@ -1742,6 +1783,7 @@ static void ov5695_remove(struct i2c_client* client)
 #endif
     v4l2_ctrl_handler_free(&ov5695->ctrl_handler);
     mutex_destroy(&ov5695->mutex);
+    vvsensor_seq_set_release(&ov5695->seqs);
 
     pm_runtime_disable(&client->dev);
     if (!pm_runtime_status_suspended(&client->dev))
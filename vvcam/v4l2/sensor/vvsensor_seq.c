@@ -0,0 +1,279 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <asm/unaligned.h>
+
+#include "vvsensor_seq.h"
+
+/*
+ * Blob layout: a be16 header followed by its payload. A header with
+ * VVSENSOR_SEQ_HDR_DELAY set is a sleep of the low bits in ms and has no
+ * payload, otherwise it is the length of the i2c write that follows:
+ * the be16 start address and the values of consecutive registers.
+ */
+#define VVSENSOR_SEQ_HDR_DELAY	0x8000
+#define VVSENSOR_SEQ_MAX_DELAY	0x7fff
+#define VVSENSOR_SEQ_MAX_BURST	0x7fff
+#define VVSENSOR_SEQ_MSGS	16	/* bursts per i2c_transfer */
+
+int vvsensor_compile_sequence(struct i2c_client *client,
+			      struct vvsensor_seq *seq,
+			      const struct vvcam_sccb_data_s *regs,
+			      u32 count, u32 val_bytes)
+{
+	const struct i2c_adapter_quirks *q = client->adapter->quirks;
+	u32 max_len = VVSENSOR_SEQ_MAX_BURST;
+	u32 i, len = 0, burst = 0, next_addr = 0;
+	u8 *tmp, *hdr = NULL;
+
+	if (!count || (val_bytes != 1 && val_bytes != 2))
+		return -EINVAL;
+	if (q && q->max_write_len)
+		max_len = min_t(u32, max_len, q->max_write_len);
+	if (max_len < 2 + val_bytes)
+		return -EINVAL;
+
+	/* worst case every entry is a burst of its own */
+	tmp = kmalloc(count * (4 + val_bytes), GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	seq->nregs = 0;
+	seq->nbursts = 0;
+	seq->ndelays = 0;
+	for (i = 0; i < count; i++) {
+		if (regs[i].addr == VVSENSOR_SEQ_DELAY) {
+			put_unaligned_be16(VVSENSOR_SEQ_HDR_DELAY |
+					   min_t(u32, regs[i].data,
+						 VVSENSOR_SEQ_MAX_DELAY),
+					   tmp + len);
+			len += 2;
+			hdr = NULL;
+			seq->ndelays++;
+			continue;
+		}
+		if (!hdr || regs[i].addr != next_addr ||
+		    burst + val_bytes > max_len) {
+			hdr = tmp + len;
+			len += 2;
+			put_unaligned_be16(regs[i].addr, tmp + len);
+			len += 2;
+			burst = 2;
+			seq->nbursts++;
+		}
+		if (val_bytes == 2)
+			put_unaligned_be16(regs[i].data, tmp + len);
+		else
+			tmp[len] = regs[i].data & 0xff;
+		len += val_bytes;
+		burst += val_bytes;
+		put_unaligned_be16(burst, hdr);
+		next_addr = regs[i].addr + val_bytes;
+		seq->nregs++;
+	}
+
+	seq->blob = devm_kmemdup(&client->dev, tmp, len, GFP_KERNEL);
+	kfree(tmp);
+	if (!seq->blob)
+		return -ENOMEM;
+	seq->blob_len = len;
+	return 0;
+}
+
+static int vvsensor_seq_flush(struct i2c_client *client,
+			      struct i2c_msg *msgs, u32 n)
+{
+	int ret;
+
+	if (n == 0)
+		return 0;
+	ret = i2c_transfer(client->adapter, msgs, n);
+	if (ret != (int)n)
+		return ret < 0 ? ret : -EIO;
+	return 0;
+}
+
+int vvsensor_apply_sequence(struct i2c_client *client,
+			    struct vvsensor_seq *seq)
+{
+	const struct i2c_adapter_quirks *q = client->adapter->quirks;
+	struct i2c_msg msgs[VVSENSOR_SEQ_MSGS];
+	u32 max_msgs = VVSENSOR_SEQ_MSGS;
+	u32 pos = 0, n = 0, hdr;
+	ktime_t start;
+	u64 ns;
+	int ret = 0;
+
+	if (!seq->blob)
+		return -EINVAL;
+	if (q && q->max_num_msgs)
+		max_msgs = min_t(u32, max_msgs, q->max_num_msgs);
+	if (q && (q->flags & I2C_AQ_NO_REP_START))
+		max_msgs = 1;
+
+	start = ktime_get();
+	while (pos < seq->blob_len) {
+		hdr = get_unaligned_be16(seq->blob + pos);
+		pos += 2;
+		if (hdr & VVSENSOR_SEQ_HDR_DELAY) {
+			ret = vvsensor_seq_flush(client, msgs, n);
+			if (ret)
+				break;
+			n = 0;
+			msleep(hdr & ~VVSENSOR_SEQ_HDR_DELAY);
+			continue;
+		}
+		msgs[n].addr  = client->addr;
+		msgs[n].flags = client->flags & I2C_M_TEN;
+		msgs[n].len   = hdr;
+		msgs[n].buf   = seq->blob + pos;
+		pos += hdr;
+		if (++n == max_msgs) {
+			ret = vvsensor_seq_flush(client, msgs, n);
+			if (ret)
+				break;
+			n = 0;
+		}
+	}
+	if (!ret)
+		ret = vvsensor_seq_flush(client, msgs, n);
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret) {
+		seq->apply_errors++;
+		dev_err(&client->dev, "%s: %s i2c error %d\n",
+			__func__, seq->name, ret);
+		return ret;
+	}
+	seq->last_ns = ns;
+	if (seq->apply_count == 0 || ns < seq->min_ns)
+		seq->min_ns = ns;
+	if (ns > seq->max_ns)
+		seq->max_ns = ns;
+	seq->total_ns += ns;
+	seq->apply_count++;
+	return 0;
+}
+
+static int vvsensor_seq_show(struct seq_file *m, void *v)
+{
+	struct vvsensor_seq_set *set = m->private;
+	struct vvsensor_seq *seq;
+	u32 i;
+
+	seq_printf(m, "%-24s %5s %6s %6s %6s %6s %6s %8s %8s %8s %8s\n",
+		   "mode", "regs", "bursts", "delays", "bytes", "count",
+		   "errors", "last_us", "min_us", "max_us", "avg_us");
+	for (i = 0; i < set->count; i++) {
+		seq = &set->seq[i];
+		if (!seq->blob)
+			continue;
+		seq_printf(m, "%-24s %5u %6u %6u %6u %6u %6u %8llu %8llu %8llu %8llu\n",
+			   seq->name, seq->nregs, seq->nbursts, seq->ndelays,
+			   seq->blob_len, seq->apply_count, seq->apply_errors,
+			   div_u64(seq->last_ns, NSEC_PER_USEC),
+			   div_u64(seq->min_ns, NSEC_PER_USEC),
+			   div_u64(seq->max_ns, NSEC_PER_USEC),
+			   seq->apply_count ?
+			   div_u64(seq->total_ns, (u64)seq->apply_count *
+				   NSEC_PER_USEC) : 0);
+	}
+	return 0;
+}
+
+static int vvsensor_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vvsensor_seq_show, inode->i_private);
+}
+
+static const struct file_operations vvsensor_seq_fops = {
+	.owner   = THIS_MODULE,
+	.open    = vvsensor_seq_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Allocates count sequences for the caller to compile and exposes their
+ * timing in debugfs as <name>-<i2c dev>/sequences.
+ */
+int vvsensor_seq_set_init(struct i2c_client *client,
+			  struct vvsensor_seq_set *set, u32 count,
+			  const char *name)
+{
+	char dir[48];
+
+	set->seq = devm_kcalloc(&client->dev, count, sizeof(*set->seq),
+				GFP_KERNEL);
+	if (!set->seq)
+		return -ENOMEM;
+	set->count = count;
+
+	snprintf(dir, sizeof(dir), "%s-%s", name, dev_name(&client->dev));
+	set->debugfs = debugfs_create_dir(dir, NULL);
+	if (!IS_ERR_OR_NULL(set->debugfs))
+		debugfs_create_file("sequences", 0444, set->debugfs, set,
+				    &vvsensor_seq_fops);
+	return 0;
+}
+
+void vvsensor_seq_set_release(struct vvsensor_seq_set *set)
+{
+	debugfs_remove_recursive(set->debugfs);
+	set->debugfs = NULL;
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#ifndef _VVSENSOR_SEQ_H_
+#define _VVSENSOR_SEQ_H_
+
+#include <linux/i2c.h>
+#include <linux/debugfs.h>
+
+#include "vvsensor.h"
+
+/*
+ * A register table compiled into bursts of consecutive addresses, each
+ * one a ready i2c write buffer, with the delays kept inline. Compiled
+ * once at probe so a mode switch is a walk over the blob.
+ */
+struct vvsensor_seq {
+	char name[32];
+	u8 *blob;
+	u32 blob_len;
+	u32 nregs;
+	u32 nbursts;
+	u32 ndelays;
+	/* vvsensor_apply_sequence() timing */
+	u32 apply_count;
+	u32 apply_errors;
+	u64 last_ns;
+	u64 min_ns;
+	u64 max_ns;
+	u64 total_ns;
+};
+
+struct vvsensor_seq_set {
+	struct vvsensor_seq *seq;
+	u32 count;
+	struct dentry *debugfs;
+};
+
+int vvsensor_seq_set_init(struct i2c_client *client,
+			  struct vvsensor_seq_set *set, u32 count,
+			  const char *name);
+void vvsensor_seq_set_release(struct vvsensor_seq_set *set);
+int vvsensor_compile_sequence(struct i2c_client *client,
+			      struct vvsensor_seq *seq,
+			      const struct vvcam_sccb_data_s *regs,
+			      u32 count, u32 val_bytes);
+int vvsensor_apply_sequence(struct i2c_client *client,
+			    struct vvsensor_seq *seq);
+
+#endif /* _VVSENSOR_SEQ_H_ */
@@ -51,6 +51,7 @@
  *
  *****************************************************************************/
 # include <linux/dma-direct.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/spinlock.h>
@@ -69,7 +70,12 @@
 #include "vvdefs.h"
 #include "vvsensor.h"
 
+#define CREATE_TRACE_POINTS
+#include "video_trace.h"
+
 #define DEF_PLANE_NO    (0)
+#define VIV_EVENT_SUBSCRIBE_TIMEOUT_MS	(20)
+#define VIV_EVENT_SYNC_TIMEOUT_MS		(1000)
 
 static struct viv_video_device *vvdev[VIDEO_NODE_NUM];
 static struct list_head file_list_head[VIDEO_NODE_NUM];
@@ -101,6 +107,90 @@ static struct viv_video_fmt formats[] = {
 	 },
 };
 
+/*
+ * Two-plane formats offered on mplane nodes. The daemon only knows the
+ * contiguous layout, so each is negotiated as its base format and only
+ * the buffer planes differ.
+ */
+struct viv_mplane_fmt {
+	u32 fourcc;
+	u32 base;
+	unsigned int cbcr_vdiv;
+};
+
+static const struct viv_mplane_fmt mplane_formats[] = {
+	{ V4L2_PIX_FMT_NV12M, V4L2_PIX_FMT_NV12, 2 },
+	{ V4L2_PIX_FMT_NV16M, V4L2_PIX_FMT_NV16, 1 },
+};
+
+static const struct viv_mplane_fmt *viv_find_mplane_fmt(u32 fourcc)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mplane_formats); i++)
+		if (mplane_formats[i].fourcc == fourcc)
+			return &mplane_formats[i];
+	return NULL;
+}
+
+static void viv_fill_fmt_mp(struct viv_video_device *vdev,
+		const struct v4l2_pix_format *pix, u32 fourcc,
+		struct v4l2_pix_format_mplane *mp)
+{
+	const struct viv_mplane_fmt *mf = viv_find_mplane_fmt(fourcc);
+	struct v4l2_plane_pix_format *plane = mp->plane_fmt;
+
+	memset(mp, 0, sizeof(*mp));
+	mp->width = pix->width;
+	mp->height = pix->height;
+	mp->pixelformat = fourcc;
+	mp->field = pix->field;
+	mp->colorspace = pix->colorspace;
+	mp->quantization = pix->quantization;
+	if (mf) {
+		/* the mi has a single line length for luma and chroma */
+		mp->num_planes = 2;
+		plane[0].bytesperline = pix->bytesperline;
+		plane[0].sizeimage = ALIGN(pix->bytesperline * pix->height,
+					vdev->plane_align);
+		plane[1].bytesperline = pix->bytesperline;
+		plane[1].sizeimage = ALIGN(pix->bytesperline * pix->height /
+					mf->cbcr_vdiv, vdev->plane_align);
+	} else {
+		mp->num_planes = 1;
+		plane[0].bytesperline = pix->bytesperline;
+		plane[0].sizeimage = ALIGN(pix->sizeimage, vdev->plane_align);
+	}
+}
+
+static void viv_mplane_to_single(const struct v4l2_pix_format_mplane *mp,
+		struct v4l2_format *f)
+{
+	const struct viv_mplane_fmt *mf = viv_find_mplane_fmt(mp->pixelformat);
+
+	memset(f, 0, sizeof(*f));
+	f->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	f->fmt.pix.width = mp->width;
+	f->fmt.pix.height = mp->height;
+	f->fmt.pix.pixelformat = mf ? mf->base : mp->pixelformat;
+	f->fmt.pix.bytesperline = mp->plane_fmt[0].bytesperline;
+	f->fmt.pix.field = mp->field;
+	f->fmt.pix.colorspace = mp->colorspace;
+	f->fmt.pix.quantization = mp->quantization;
+}
+
+/*
+ * Only the yuv layouts written straight by the mi can be padded; raw
+ * line lengths are fixed by the packing and dwe uses its own stride.
+ */
+static bool viv_stride_supported(struct viv_video_device *vdev, u32 fourcc)
+{
+	if (vdev->dweEnabled)
+		return false;
+	return fourcc == V4L2_PIX_FMT_YUYV || fourcc == V4L2_PIX_FMT_NV12 ||
+	       fourcc == V4L2_PIX_FMT_NV16;
+}
+
 static int bayer_pattern_to_format(unsigned int bayer_pattern,
 		unsigned int bit_width, struct viv_video_fmt *fmt)
 {
@@ -207,59 +297,115 @@ static int video_event_subscribed(struct video_device *vdev,
 	return 0;
 }
 
-static int viv_event_wait_complete(struct viv_video_device *vdev,
-								   struct v4l2_event *event)
+/* cancel the waiters whose event nobody is subscribed to any more */
+static void viv_event_flush_waiters(struct viv_video_device *vdev)
 {
-	int timeout_ms = 1000;
-	int i = 0;
+	struct viv_event_waiter *waiter, *next;
+	struct v4l2_event event;
+	unsigned long flags;
 
-	for (i = 0; i < timeout_ms; i++) {
-		if (vdev->event_shm.complete)
-			return 0;
-		if (video_event_subscribed(vdev->video, event) == true) {
-			msleep(1);
-		} else {
-			return -EINVAL;
+	memset(&event, 0, sizeof(event));
+	event.type = VIV_VIDEO_EVENT_TYPE;
+
+	spin_lock_irqsave(&vdev->event_wait_lock, flags);
+	list_for_each_entry_safe(waiter, next, &vdev->event_wait_list, entry) {
+		event.id = waiter->id;
+		if (!video_event_subscribed(vdev->video, &event)) {
+			list_del_init(&waiter->entry);
+			waiter->result = -EINVAL;
+			complete(&waiter->done);
 		}
+	}
+	spin_unlock_irqrestore(&vdev->event_wait_lock, flags);
+}
+
+static void viv_event_complete(struct viv_video_device *vdev, u32 seq)
+{
+	struct viv_event_waiter *waiter;
+	unsigned long flags;
 
+	spin_lock_irqsave(&vdev->event_wait_lock, flags);
+	list_for_each_entry(waiter, &vdev->event_wait_list, entry) {
+		if (seq == 0 || waiter->seq == seq) {
+			list_del_init(&waiter->entry);
+			complete(&waiter->done);
+			break;
+		}
 	}
+	spin_unlock_irqrestore(&vdev->event_wait_lock, flags);
+}
+
+static void viv_event_stat_update(struct viv_video_device *vdev,
+		u32 id, u64 delta_ns, bool timeout)
+{
+	struct viv_event_stat *stat;
+	u64 delta_us = div_u64(delta_ns, NSEC_PER_USEC);
+
+	if (id >= VIV_VIDEO_EVENT_MAX)
+		return;
 
-	return -ETIMEDOUT;
+	stat = &vdev->event_stat[id];
+	stat->count++;
+	if (timeout)
+		stat->timeout++;
+	stat->last_us = delta_us;
+	stat->total_us += delta_us;
+	if (delta_us > stat->max_us)
+		stat->max_us = delta_us;
 }
 
 static int viv_v4l2_post_event(struct viv_video_device *vdev,
 		struct v4l2_event *event, bool sync)
 {
-	int ret = 0;
-	int i = 0;
+	struct viv_video_event *v_event =
+			(struct viv_video_event *)&event->u.data[0];
+	struct viv_event_waiter waiter;
+	unsigned long flags;
+	u64 start_ns;
 
 	if ((event->id != VIV_VIDEO_EVENT_DEL_STREAM) &&
-		(event->id != VIV_VIDEO_EVENT_STOP_STREAM)) {
-		for (i = 0; i < 10; i++) {
-			if (video_event_subscribed(vdev->video, event) == true) {
-				break;
-			} else {
-				msleep(2);
-			}
-		}
-	}
-
-	mutex_lock(&vdev->event_lock);
+		(event->id != VIV_VIDEO_EVENT_STOP_STREAM))
+		wait_event_timeout(vdev->event_subscribe_wq,
+				video_event_subscribed(vdev->video, event),
+				msecs_to_jiffies(VIV_EVENT_SUBSCRIBE_TIMEOUT_MS));
 
-	if (sync) {
-		vdev->event_shm.complete = 0;
-		vdev->event_shm.result = 0;
+	if (!sync) {
+		v4l2_event_queue(vdev->video, event);
+		return 0;
 	}
 
+	waiter.id = event->id;
+	waiter.result = 0;
+	init_completion(&waiter.done);
+
+	/* keep the queue order the same as the seq order */
+	mutex_lock(&vdev->event_lock);
+	spin_lock_irqsave(&vdev->event_wait_lock, flags);
+	if (++vdev->event_seq == 0)
+		++vdev->event_seq;
+	waiter.seq = vdev->event_seq;
+	list_add_tail(&waiter.entry, &vdev->event_wait_list);
+	spin_unlock_irqrestore(&vdev->event_wait_lock, flags);
+
+	v_event->seq = waiter.seq;
+	start_ns = ktime_get_ns();
 	v4l2_event_queue(vdev->video, event);
+	mutex_unlock(&vdev->event_lock);
 
-	if (sync) {
-		ret = viv_event_wait_complete(vdev, event);
-	}
+	if (!video_event_subscribed(vdev->video, event))
+		waiter.result = -EINVAL;
+	else if (!wait_for_completion_timeout(&waiter.done,
+				msecs_to_jiffies(VIV_EVENT_SYNC_TIMEOUT_MS)))
+		waiter.result = -ETIMEDOUT;
 
-	mutex_unlock(&vdev->event_lock);
+	spin_lock_irqsave(&vdev->event_wait_lock, flags);
+	if (!list_empty(&waiter.entry))
+		list_del(&waiter.entry);
+	viv_event_stat_update(vdev, waiter.id, ktime_get_ns() - start_ns,
+			waiter.result == -ETIMEDOUT);
+	spin_unlock_irqrestore(&vdev->event_wait_lock, flags);
 
-	return ret;
+	return waiter.result;
 }
 
 static int viv_post_event(struct v4l2_event *event, void *fh, bool sync)
@@ -344,6 +490,8 @@ static int start_streaming(struct vb2_queue *vq, unsigned int count)
 		handle->vdev->pipeline_status = PIPELINE_STREAMON;
 		handle->vdev->frame_cnt = 0;
 		handle->vdev->last_ts = 0;
+		handle->vdev->last_frame_id = 0;
+		handle->vdev->frame_drops = 0;
 	} else {
 		pr_err("can't start streaming, device busy!\n");
 		return -EBUSY;
@@ -373,20 +521,40 @@ static void stop_streaming(struct vb2_queue *vq)
 	}
 }
 
+/* per-plane sizes of the current format, returns the plane count */
+static unsigned int viv_queue_sizes(struct viv_video_device *vdev,
+		unsigned int sizes[], unsigned long *total)
+{
+	unsigned int i;
+
+	if (!vdev->mplane) {
+		sizes[0] = vdev->fmt.fmt.pix.sizeimage;
+		*total = sizes[0];
+		return 1;
+	}
+
+	*total = 0;
+	for (i = 0; i < vdev->fmt_mp.num_planes; i++) {
+		sizes[i] = vdev->fmt_mp.plane_fmt[i].sizeimage;
+		*total += sizes[i];
+	}
+	return vdev->fmt_mp.num_planes;
+}
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 8, 0)
 static int queue_setup(struct vb2_queue *vq, const struct v4l2_format *fmt,
 		       unsigned int *nbuffers, unsigned int *nplanes,
 		       unsigned int sizes[], void *alloc_ctxs[])
 {
 	struct viv_video_file *handle = queue_to_handle(vq);
-	unsigned long size = handle->vdev->fmt.fmt.pix.sizeimage;
+	unsigned long size;
 
 	pr_debug("enter %s\n", __func__);
+	*nplanes = viv_queue_sizes(handle->vdev, sizes, &size);
 	if (*nbuffers == 0)
 		*nbuffers = 1;
 	while (size * *nbuffers > RESERVED_MEM_SIZE)
 		(*nbuffers)--;
-	sizes[0] = size;
 	return 0;
 }
 #else
@@ -395,15 +563,14 @@ static int queue_setup(struct vb2_queue *q,
 		       unsigned int sizes[], struct device *alloc_devs[])
 {
 	struct viv_video_file *handle = queue_to_handle(q);
-	unsigned long size = handle->vdev->fmt.fmt.pix.sizeimage;
+	unsigned long size;
 
 	pr_debug("enter %s\n", __func__);
+	*num_planes = viv_queue_sizes(handle->vdev, sizes, &size);
 	if (*num_buffers == 0)
 		*num_buffers = 1;
 	while (size * *num_buffers > RESERVED_MEM_SIZE)
 		(*num_buffers)--;
-	*num_planes = 1;
-	sizes[0] = size;
 	return 0;
 }
 #endif
@@ -414,6 +581,26 @@ static int buffer_init(struct vb2_buffer *vb)
 	return 0;
 }
 
+static int buffer_prepare(struct vb2_buffer *vb)
+{
+	struct viv_video_file *handle = queue_to_handle(vb->vb2_queue);
+	u32 align = handle->vdev->plane_align;
+	unsigned int i;
+
+	if (!handle->vdev->mplane)
+		return 0;
+
+	/* plane bases go straight into the mi and dwe base registers */
+	for (i = 0; i < vb->num_planes; i++) {
+		if (!IS_ALIGNED(vb2_dma_contig_plane_dma_addr(vb, i), align)) {
+			pr_err("plane %u of buffer %u not %u byte aligned\n",
+				i, vb->index, align);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
 static void buffer_queue(struct vb2_buffer *vb)
 {
 	struct viv_video_file *handle;
@@ -435,11 +622,17 @@ static void buffer_queue(struct vb2_buffer *vb)
 		return;
 
 	buf->dma = vb2_dma_contig_plane_dma_addr(vb, DEF_PLANE_NO);
+	buf->dma_cb = vb->num_planes > 1 ?
+			vb2_dma_contig_plane_dma_addr(vb, 1) : 0;
+	buf->frame_id = 0;
 
 	vdev = handle->vdev;
 	if (!vdev)
 		return;
 
+	buf->stride = viv_stride_supported(vdev, vdev->fmt.fmt.pix.pixelformat) ?
+			vdev->fmt.fmt.pix.bytesperline : 0;
+
 	if ((vdev->dumpbuf_status == DUMPBUF_ENABLE) && (vdev->dumpbuf == NULL)){
 		vdev->dumpbuf = buf;
 		vdev->dumpbuf_status = DUMPBUF_DONE;
@@ -458,6 +651,7 @@ static void buffer_queue(struct vb2_buffer *vb)
 static struct vb2_ops buffer_ops = {
 	.queue_setup = queue_setup,
 	.buf_init = buffer_init,
+	.buf_prepare = buffer_prepare,
 	.buf_queue = buffer_queue,
 	.start_streaming = start_streaming,
 	.stop_streaming = stop_streaming,
@@ -478,7 +672,8 @@ static int video_open(struct file *file)
 
 	file->private_data = &handle->vfh;
 	handle->vdev = dev;
-	handle->queue.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	handle->queue.type = dev->mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE :
+			V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	handle->queue.drv_priv = handle;
 	handle->queue.ops = &buffer_ops;
 	handle->queue.io_modes = VB2_MMAP | VB2_DMABUF;
@@ -540,6 +735,7 @@ static int video_close(struct file *file)
 						handle->streamid, &handle->vfh,
 						true);
 				handle->vdev->pipeline_status = PIPELINE_INIT;
+				handle->vdev->pipeline_created = false;
 				handle->vdev->active = 0;
 			}
 		}
@@ -558,6 +754,7 @@ static int video_close(struct file *file)
 
 		v4l2_fh_del(&handle->vfh);
 		v4l2_fh_exit(&handle->vfh);
+		viv_event_flush_waiters(vdev);
 
 		{
 			struct ext_dma_buf *edb = NULL;
@@ -605,6 +802,8 @@ static int subscribe_event(struct v4l2_fh *fh,
 		return v4l2_ctrl_subscribe_event(fh, sub);
 	ret = v4l2_event_subscribe(fh, sub, 10, 0);
 	vdev = handle->vdev;
+	if (!ret && vdev)
+		wake_up_all(&vdev->event_subscribe_wq);
 	if (!ret && vdev && sub->id == VIV_VIDEO_EVENT_GET_CAPS_SUPPORTS) {
 		spin_lock_irqsave(&file_list_lock[vdev->id], flags);
 		vdev->subscribed_cnt++;
@@ -622,6 +821,7 @@ static int unsubscribe_event(struct v4l2_fh *fh,
 	struct viv_video_device *vdev;
 	spinlock_t *lock;
 	unsigned long flags;
+	int ret;
 
 	pr_debug("enter %s\n", __func__);
 	if (!handle || !handle->vdev || !sub)
@@ -643,13 +843,40 @@ static int unsubscribe_event(struct v4l2_fh *fh,
 				}
 			}
 			spin_unlock_irqrestore(lock, flags);
-			return v4l2_event_unsubscribe(fh, sub);
+			ret = v4l2_event_unsubscribe(fh, sub);
+			viv_event_flush_waiters(vdev);
+			return ret;
 		}
 	}
 	spin_unlock_irqrestore(lock, flags);
 	return 0;
 }
 
+static void viv_post_create_pipeline(struct viv_video_file *handle)
+{
+	viv_post_simple_event(VIV_VIDEO_EVENT_CREATE_PIPELINE,
+		handle->streamid, &handle->vfh, true);
+	handle->vdev->pipeline_created = true;
+}
+
+/*
+ * The daemon answers CREATE_PIPELINE with S_MODEINFO. Once that has been
+ * cached, enumeration is served from camera_mode and formats without
+ * the round trip, until S_CAPS_MODE switches the sensor mode. Setting up
+ * a stream still creates the pipeline, see viv_post_fmt_event().
+ */
+static void viv_create_pipeline(struct viv_video_file *handle)
+{
+	if (!handle->vdev->modeinfo_cached)
+		viv_post_create_pipeline(handle);
+}
+
+static void viv_invalidate_modeinfo(struct viv_video_device *vdev)
+{
+	vdev->modeinfo_cached = false;
+	vdev->caps_supports_cached = false;
+}
+
 static int set_caps_mode_event(struct file *file)
 {
 	struct viv_video_device *dev = video_drvdata(file);
@@ -738,6 +965,51 @@ static int viv_create_default_links(struct viv_video_device *dev)
 	return viv_create_link(source, ISP_PAD_SOURCE, sink, 0);
 }
 
+/*
+ * Remove the data links of one pad and keep the rest of the entity's, like
+ * the isp stats and rdma nodes. The media core can only drop all links of
+ * an entity, so the others are saved and created again with their flags.
+ */
+static void viv_remove_pad_links(struct media_entity *entity, u16 pad)
+{
+	struct {
+		struct media_entity *source, *sink;
+		u16 source_pad, sink_pad;
+		u32 flags;
+	} keep[8];
+	struct media_link *link;
+	int i, n = 0;
+
+	if (!entity)
+		return;
+
+	list_for_each_entry(link, &entity->links, list) {
+		if ((link->flags & MEDIA_LNK_FL_LINK_TYPE) != MEDIA_LNK_FL_DATA_LINK)
+			continue;
+		if ((link->source->entity == entity && link->source->index == pad) ||
+		    (link->sink->entity == entity && link->sink->index == pad))
+			continue;
+		if (n == ARRAY_SIZE(keep)) {
+			pr_warn("%s: too many links on %s\n", __func__, entity->name);
+			break;
+		}
+		keep[n].source = link->source->entity;
+		keep[n].source_pad = link->source->index;
+		keep[n].sink = link->sink->entity;
+		keep[n].sink_pad = link->sink->index;
+		keep[n].flags = link->flags;
+		n++;
+	}
+
+	media_entity_remove_links(entity);
+	for (i = 0; i < n; i++) {
+		if (media_create_pad_link(keep[i].source, keep[i].source_pad,
+				keep[i].sink, keep[i].sink_pad, keep[i].flags))
+			pr_err("%s: failed to restore a link of %s\n",
+					__func__, entity->name);
+	}
+}
+
 static int viv_config_dwe(struct viv_video_file *handle, bool enable)
 {
 	struct viv_video_device *vdev = handle->vdev;
@@ -759,7 +1031,7 @@ static int viv_config_dwe(struct viv_video_file *handle, bool enable)
 
 	if (!enable) {
 		source = viv_find_entity(vdev, ISP_DEVICE_NAME);
-		media_entity_remove_links(source);
+		viv_remove_pad_links(source, ISP_PAD_SOURCE);
 		rc = viv_create_link(source, ISP_PAD_SOURCE, sink, 0);
 		if (!rc)
 			vdev->dweEnabled = false;
@@ -773,7 +1045,7 @@ static int viv_config_dwe(struct viv_video_file *handle, bool enable)
 	if (vdev->sdcount > 1) {
 		source = viv_find_entity(vdev, ISP_DEVICE_NAME);
 		sink = viv_find_entity(vdev, DWE_DEVICE_NAME);
-		media_entity_remove_links(source);
+		viv_remove_pad_links(source, ISP_PAD_SOURCE);
 		if (viv_create_link(source, ISP_PAD_SOURCE, sink, DWE_PAD_SINK))
 			pr_err("failed to create link between isp and dwe!\n");
 	}
@@ -805,6 +1077,7 @@ static int viv_set_modeinfo(struct viv_video_file *handle,
 
 	if (pcamera_mode->size.width == 0 || pcamera_mode->size.height == 0 ) {
 		vdev->camera_status = 0;
+		viv_invalidate_modeinfo(vdev);
 		return -EINVAL;
 	}
 
@@ -817,6 +1090,7 @@ static int viv_set_modeinfo(struct viv_video_file *handle,
 		memcpy(&vdev->formats[vdev->formatscount], &fmt, sizeof(fmt));
 		vdev->formatscount++;
 	}
+	vdev->modeinfo_cached = true;
 
 	pfmt = &vdev->formats[0];
 
@@ -829,6 +1103,7 @@ static int viv_set_modeinfo(struct viv_video_file *handle,
 	init_v4l2_fmt(&vdev->fmt, pfmt->bpp, pfmt->depth,
 				&vdev->fmt.fmt.pix.bytesperline,
 				&vdev->fmt.fmt.pix.sizeimage);
+	viv_fill_fmt_mp(vdev, &vdev->fmt.fmt.pix, pfmt->fourcc, &vdev->fmt_mp);
 
 	vdev->crop.width = vdev->camera_mode.size.width;
 	vdev->crop.height = vdev->camera_mode.size.height;
@@ -860,7 +1135,7 @@ static long private_ioctl(struct file *file, void *fh,
 
 	switch (cmd) {
 	case VIV_VIDIOC_EVENT_COMPLETE:
-		dev->event_shm.complete = 1;
+		viv_event_complete(dev, ((struct viv_video_event *)arg)->seq);
 		break;
 	case VIV_VIDIOC_S_STREAMID:
 		pr_debug("priv ioctl VIV_VIDIOC_S_STREAMID\n");
@@ -937,6 +1212,7 @@ static long private_ioctl(struct file *file, void *fh,
 
 	case VIV_VIDIOC_S_CAPS_MODE:
 		memcpy(&(dev->caps_mode), arg, sizeof(dev->caps_mode));
+		viv_invalidate_modeinfo(dev);
 		rc = set_caps_mode_event(file);
 		if (rc == 0)
 			rc = dev->event_result;
@@ -952,7 +1228,8 @@ static long private_ioctl(struct file *file, void *fh,
 
 	case VIV_VIDIOC_GET_CAPS_SUPPORTS:{
 		pcaps_supports = (struct viv_caps_supports *)arg;
-		rc = get_caps_suppots_event(file);
+		if (!dev->caps_supports_cached)
+			rc = get_caps_suppots_event(file);
 		memcpy(pcaps_supports, &(dev->caps_supports),
 				sizeof(dev->caps_supports));
 		break;
@@ -961,6 +1238,7 @@ static long private_ioctl(struct file *file, void *fh,
 	case VIV_VIDIOC_SET_CAPS_SUPPORTS:{
 		pcaps_supports = (struct viv_caps_supports *)arg;
 		memcpy(&(dev->caps_supports), arg, sizeof(dev->caps_supports));
+		dev->caps_supports_cached = true;
 		break;
 	}
 
@@ -1005,9 +1283,11 @@ static int video_querycap(struct file *file, void *fh,
 		snprintf((char *)cap->bus_info, sizeof(cap->bus_info),
 				"platform:viv%d", dev->id);
 
-	cap->capabilities = V4L2_CAP_VIDEO_CAPTURE |
-			V4L2_CAP_STREAMING | V4L2_CAP_DEVICE_CAPS | V4L2_CAP_TIMEPERFRAME;
-	cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+	cap->device_caps = (dev && dev->mplane) ?
+			V4L2_CAP_VIDEO_CAPTURE_MPLANE : V4L2_CAP_VIDEO_CAPTURE;
+	cap->device_caps |= V4L2_CAP_STREAMING;
+	cap->capabilities = cap->device_caps |
+			V4L2_CAP_DEVICE_CAPS | V4L2_CAP_TIMEPERFRAME;
 	return 0;
 }
 
@@ -1020,6 +1300,12 @@ static int vidioc_enum_fmt_vid_cap(struct file *file, void *priv,
 		f->pixelformat = dev->formats[f->index].fourcc;
 		return 0;
 	}
+	if (dev->mplane &&
+	    f->index < dev->formatscount + ARRAY_SIZE(mplane_formats)) {
+		f->pixelformat =
+			mplane_formats[f->index - dev->formatscount].fourcc;
+		return 0;
+	}
 	return -EINVAL;
 }
 
@@ -1048,8 +1334,7 @@ static int vidioc_try_fmt_vid_cap(struct file *file, void *priv,
 	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
 		return -EINVAL;
 
-	viv_post_simple_event(VIV_VIDEO_EVENT_CREATE_PIPELINE,
-		handle->streamid, &handle->vfh, true);
+	viv_create_pipeline(handle);
 
 	f->fmt.pix.width = clamp_t(u32, f->fmt.pix.width, VIDEO_FRAME_MIN_WIDTH,
 				VIDEO_FRAME_MAX_WIDTH);
@@ -1073,12 +1358,19 @@ static int vidioc_try_fmt_vid_cap(struct file *file, void *priv,
 
 	f->fmt.pix.field = dev->fmt.fmt.pix.field;
 	init_v4l2_fmt(f, format->bpp, format->depth, &bytesperline, &sizeimage);
+	if (viv_stride_supported(dev, format->fourcc) &&
+	    f->fmt.pix.bytesperline > bytesperline) {
+		bytesperline = min_t(u32, ALIGN(f->fmt.pix.bytesperline,
+				VIDEO_STRIDE_ALIGN), VIDEO_FRAME_MAX_STRIDE);
+		sizeimage = bytesperline * f->fmt.pix.height * format->depth /
+				(8 * format->bpp);
+	}
 	f->fmt.pix.bytesperline = bytesperline;
 	f->fmt.pix.sizeimage = sizeimage;
 	return 0;
 }
 
-static int viv_post_fmt_event(struct file *file)
+static int viv_post_fmt_event(struct file *file, bool seamless)
 {
 	int ret = 0;
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
@@ -1088,6 +1380,8 @@ static int viv_post_fmt_event(struct file *file)
 	struct viv_video_event *v_event;
 
 	if (vdev->pipeline_status == PIPELINE_INIT) {
+		if (!vdev->pipeline_created)
+			viv_post_create_pipeline(handle);
 		ret = viv_post_simple_event(VIV_VIDEO_EVENT_NEW_STREAM,
 			handle->streamid, &handle->vfh, true);
 		if (ret)
@@ -1104,17 +1398,57 @@ static int viv_post_fmt_event(struct file *file)
 	v_event->response = handle->vdev->fmt.fmt.pix.height;
 	v_event->buf_index = handle->vdev->fmt.fmt.pix.pixelformat;
 	v_event->sync = true;
+	v_event->flags = seamless ? VIV_VIDEO_EVENT_FLAG_SEAMLESS : 0;
 	event.type = VIV_VIDEO_EVENT_TYPE;
 	event.id = VIV_VIDEO_EVENT_SET_FMT;
 	ret = viv_post_event(&event, &handle->vfh, true);
 	if (ret)
 		return ret;
 
-	vdev->pipeline_status = PIPELINE_FMTSETTED;
+	if (!seamless)
+		vdev->pipeline_status = PIPELINE_FMTSETTED;
 
 	return ret;
 }
 
+/*
+ * A running stream can change size without a teardown as long as the
+ * pixel format stays and every frame still fits the buffers it already
+ * has; the daemon then switches the sensor and isp at a frame boundary.
+ * Buffers queued before the switch keep their line length, so a padded
+ * format has to stay on the current bytesperline.
+ */
+static bool viv_fmt_seamless(struct viv_video_file *handle,
+		const struct v4l2_format *f)
+{
+	struct viv_video_device *vdev = handle->vdev;
+	struct vb2_queue *q = &handle->queue;
+	struct v4l2_pix_format_mplane mp;
+	struct vb2_buffer *vb;
+	unsigned int i;
+
+	if (!vb2_is_streaming(q))
+		return false;
+	vb = vb2_get_buffer(q, 0);
+	if (!vb)
+		return false;
+	if (f->fmt.pix.pixelformat != vdev->fmt.fmt.pix.pixelformat)
+		return false;
+	if (viv_stride_supported(vdev, f->fmt.pix.pixelformat) &&
+	    f->fmt.pix.bytesperline != vdev->fmt.fmt.pix.bytesperline)
+		return false;
+
+	if (!vdev->mplane)
+		return f->fmt.pix.sizeimage <= vb->planes[0].length;
+
+	viv_fill_fmt_mp(vdev, &f->fmt.pix, vdev->fmt_mp.pixelformat, &mp);
+	for (i = 0; i < mp.num_planes; i++) {
+		if (mp.plane_fmt[i].sizeimage > vb->planes[i].length)
+			return false;
+	}
+	return true;
+}
+
 static int vidioc_s_fmt_vid_cap(struct file *file, void *priv,
 				struct v4l2_format *f)
 {
@@ -1124,27 +1458,36 @@ static int vidioc_s_fmt_vid_cap(struct file *file, void *priv,
 	struct v4l2_event event;
 	struct viv_video_event *v_event;
 	struct viv_rect *rect = (struct viv_rect *)vdev->ctrls.buf_va;
+	bool busy, seamless = false;
 
 	pr_debug("enter %s\n", __func__);
 
-	if (vdev->pipeline_status == PIPELINE_REQBUFED ||
-		vdev->pipeline_status == PIPELINE_STREAMON) {
-		pr_err("%s stream is busy, pipeline status %d",
-			__func__, vdev->pipeline_status);
-		return -EBUSY;
-	}
-
 	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
 		return -EINVAL;
 
+	busy = vdev->pipeline_status == PIPELINE_REQBUFED ||
+		vdev->pipeline_status == PIPELINE_STREAMON;
+	if (busy && f->fmt.pix.bytesperline < vdev->fmt.fmt.pix.bytesperline)
+		f->fmt.pix.bytesperline = vdev->fmt.fmt.pix.bytesperline;
+
 	ret = vidioc_try_fmt_vid_cap(file, priv, f);
 
 	if (ret < 0)
 		return -EINVAL;
 
+	if (busy) {
+		seamless = vdev->pipeline_status == PIPELINE_STREAMON &&
+			viv_fmt_seamless(handle, f);
+		if (!seamless) {
+			pr_err("%s stream is busy, pipeline status %d",
+				__func__, vdev->pipeline_status);
+			return -EBUSY;
+		}
+	}
+
 	vdev->fmt.fmt.pix.colorspace = f->fmt.pix.colorspace;
 
-	if ((f->fmt.pix.pixelformat == V4L2_PIX_FMT_SBGGR8) ||
+	if (!seamless && ((f->fmt.pix.pixelformat == V4L2_PIX_FMT_SBGGR8) ||
 	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SGBRG8) ||
 	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SGRBG8) ||
 	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SRGGB8) ||
@@ -1155,7 +1498,7 @@ static int vidioc_s_fmt_vid_cap(struct file *file, void *priv,
 	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SBGGR12) ||
 	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SGBRG12) ||
 	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SGRBG12) ||
-	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SRGGB12)) {
+	    (f->fmt.pix.pixelformat == V4L2_PIX_FMT_SRGGB12))) {
 		viv_config_dwe(handle, false);
 	}
 
@@ -1179,11 +1522,62 @@ static int vidioc_s_fmt_vid_cap(struct file *file, void *priv,
 	event.id = VIV_VIDEO_EVENT_SET_COMPOSE;
 	viv_post_event(&event, &handle->vfh, true);
 
-	viv_post_fmt_event(file);
+	viv_post_fmt_event(file, seamless);
 
 	return ret;
 }
 
+static int vidioc_g_fmt_vid_cap_mplane(struct file *file, void *priv,
+				struct v4l2_format *f)
+{
+	struct viv_video_file *handle = priv_to_handle(file->private_data);
+
+	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		return -EINVAL;
+	f->fmt.pix_mp = handle->vdev->fmt_mp;
+	return 0;
+}
+
+static int vidioc_try_fmt_vid_cap_mplane(struct file *file, void *priv,
+				struct v4l2_format *f)
+{
+	struct viv_video_device *dev = video_drvdata(file);
+	u32 fourcc = f->fmt.pix_mp.pixelformat;
+	struct v4l2_format sf;
+	int ret;
+
+	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		return -EINVAL;
+
+	viv_mplane_to_single(&f->fmt.pix_mp, &sf);
+	ret = vidioc_try_fmt_vid_cap(file, priv, &sf);
+	if (ret < 0)
+		return ret;
+	viv_fill_fmt_mp(dev, &sf.fmt.pix, fourcc, &f->fmt.pix_mp);
+	return 0;
+}
+
+static int vidioc_s_fmt_vid_cap_mplane(struct file *file, void *priv,
+				struct v4l2_format *f)
+{
+	struct viv_video_file *handle = priv_to_handle(file->private_data);
+	struct viv_video_device *vdev = handle->vdev;
+	u32 fourcc = f->fmt.pix_mp.pixelformat;
+	struct v4l2_format sf;
+	int ret;
+
+	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+		return -EINVAL;
+
+	viv_mplane_to_single(&f->fmt.pix_mp, &sf);
+	ret = vidioc_s_fmt_vid_cap(file, priv, &sf);
+	if (ret < 0)
+		return ret;
+	viv_fill_fmt_mp(vdev, &sf.fmt.pix, fourcc, &vdev->fmt_mp);
+	f->fmt.pix_mp = vdev->fmt_mp;
+	return 0;
+}
+
 static int vidioc_reqbufs(struct file *file, void *priv,
 			  struct v4l2_requestbuffers *p)
 {
@@ -1200,7 +1594,7 @@ static int vidioc_reqbufs(struct file *file, void *priv,
 	}
 
 	pr_debug("enter %s %d %d\n", __func__, p->count, p->memory);
-	if (p->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (p->type != handle->queue.type)
 		return -EINVAL;
 
 	spin_lock_irqsave(&file_list_lock[vdev->id], flags);
@@ -1222,7 +1616,7 @@ static int vidioc_reqbufs(struct file *file, void *priv,
 
 	if ((p->count) && ((vdev->pipeline_status < PIPELINE_FMTSETTED) ||
 		(vdev->pipeline_status > PIPELINE_STREAMON)))
-		viv_post_fmt_event(file);
+		viv_post_fmt_event(file, false);
 
 	if (p->count)
 		vdev->pipeline_status = PIPELINE_REQBUFED;
@@ -1236,19 +1630,25 @@ static int vidioc_querybuf(struct file *file, void *priv, struct v4l2_buffer *p)
 {
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
 	struct vb2_buffer *vb;
-	int rc = 0;
+	int i, rc = 0;
 
 	pr_debug("enter %s\n", __func__);
 
-	if (p->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (p->type != handle->queue.type)
 		return -EINVAL;
 
 	mutex_lock(&handle->buffer_mutex);
 	rc = vb2_querybuf(&handle->queue, p);
 	if (!rc) {
-		if (p->flags & V4L2_BUF_FLAG_MAPPED) {
-			vb = handle->queue.bufs[p->index];
-			p->m.offset = vb2_dma_contig_plane_dma_addr(vb, 0);
+		vb = vb2_get_buffer(&handle->queue, p->index);
+		if (vb && (p->flags & V4L2_BUF_FLAG_MAPPED)) {
+			if (V4L2_TYPE_IS_MULTIPLANAR(p->type)) {
+				for (i = 0; i < p->length; i++)
+					p->m.planes[i].m.mem_offset =
+					vb2_dma_contig_plane_dma_addr(vb, i);
+			} else {
+				p->m.offset = vb2_dma_contig_plane_dma_addr(vb, 0);
+			}
 		}
 	}
 	mutex_unlock(&handle->buffer_mutex);
@@ -1260,7 +1660,7 @@ static int vidioc_qbuf(struct file *file, void *priv, struct v4l2_buffer *p)
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
 	int rc = 0;
 
-	if (p->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (p->type != handle->queue.type)
 		return -EINVAL;
 	mutex_lock(&handle->buffer_mutex);
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 0, 0)
@@ -1275,12 +1675,34 @@ static int vidioc_qbuf(struct file *file, void *priv, struct v4l2_buffer *p)
 static int vidioc_dqbuf(struct file *file, void *priv, struct v4l2_buffer *p)
 {
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
+	struct viv_video_device *vdev = handle->vdev;
+	struct vb2_buffer *vb;
+	struct vb2_dc_buf *buf;
+	unsigned long flags;
+	u64 latency;
 	int rc = 0;
 
 	if (handle->vdev->pipeline_status != PIPELINE_STREAMOFF) {
 		rc = vb2_dqbuf(&handle->queue, p, file->f_flags & O_NONBLOCK);
 		p->field = V4L2_FIELD_NONE;
-		p->sequence = handle->sequence++;
+		vb = rc == 0 ? vb2_get_buffer(&handle->queue, p->index) : NULL;
+		if (vb) {
+			buf = container_of(vb, struct vb2_dc_buf, vb.vb2_buf);
+			/* frames the isp did not stamp fall back to a dqbuf count */
+			if (!buf->frame_id)
+				p->sequence = handle->sequence;
+			handle->sequence++;
+			if (buf->done_ts) {
+				/* last pipeline stage done to userspace dqbuf */
+				latency = ktime_get_ns() - buf->done_ts;
+				/* shared by every handle and read by procfs */
+				spin_lock_irqsave(&vdev->event_wait_lock, flags);
+				vvlat_hist_add(&vdev->dqbuf_lat, latency);
+				spin_unlock_irqrestore(&vdev->event_wait_lock, flags);
+				trace_video_dqbuf(vdev->video->num,
+						p->index, latency);
+			}
+		}
 	} else {
 		rc = -EINVAL;
 	}
@@ -1348,8 +1770,7 @@ static int vidioc_enum_framesizes(struct file *file, void *priv,
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
 	int i;
 
-	viv_post_simple_event(VIV_VIDEO_EVENT_CREATE_PIPELINE,
-		handle->streamid, &handle->vfh, true);
+	viv_create_pipeline(handle);
 
 	if (fsize->index > 0)
 		return -EINVAL;
@@ -1378,7 +1799,7 @@ static int vidioc_g_parm(struct file *file, void *fh,
 {
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
 
-	if (a->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (a->type != handle->queue.type)
 		return -EINVAL;
 
 	memset(&a->parm, 0, sizeof(a->parm));
@@ -1395,7 +1816,7 @@ static int vidioc_s_parm(struct file *file, void *fh,
 	struct v4l2_event event;
 	struct viv_video_event *v_event;
 
-	if (a->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (a->type != handle->queue.type)
 		return -EINVAL;
 	if (a->parm.output.timeperframe.denominator > handle->vdev->camera_mode.fps)
 		return -EINVAL;
@@ -1431,11 +1852,7 @@ static int vidioc_enum_frameintervals(struct file *filp, void *priv,
 	struct viv_video_file *handle = priv_to_handle(filp->private_data);
 	int i;
 
-	if (!handle->pipeline) {
-		viv_post_simple_event(VIV_VIDEO_EVENT_CREATE_PIPELINE,
-			handle->streamid, &handle->vfh, true);
-		handle->pipeline = 1;
-	}
+	viv_create_pipeline(handle);
 
 	for (i = 0; i < dev->formatscount; ++i)
 		if (dev->formats[i].fourcc == fival->pixel_format)
@@ -1462,10 +1879,17 @@ static int vidioc_enum_frameintervals(struct file *filp, void *priv,
 	return 0;
 }
 
+/* selection takes either capture type on mplane nodes, as the spec allows */
+static bool viv_is_capture_type(struct viv_video_device *vdev, u32 type)
+{
+	return type == V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+	       (vdev->mplane && type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
+}
+
 static int vidioc_g_pixelaspect(struct file *file, void *fh,
 				    int buf_type, struct v4l2_fract *aspect)
 {
-	if (buf_type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (!viv_is_capture_type(video_drvdata(file), buf_type))
 		return -EINVAL;
 	pr_debug("%s not implemented\n", __func__);
 	return 0;
@@ -1477,11 +1901,10 @@ static int vidioc_g_selection(struct file *file, void *fh,
 	struct viv_video_file *handle = priv_to_handle(file->private_data);
 	struct viv_video_device *vdev = handle->vdev;
 
-	if (s->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (!viv_is_capture_type(vdev, s->type))
 		return -EINVAL;
 
-	viv_post_simple_event(VIV_VIDEO_EVENT_CREATE_PIPELINE,
-		handle->streamid, &handle->vfh, true);
+	viv_create_pipeline(handle);
 
 	switch (s->target) {
 	case V4L2_SEL_TGT_CROP_DEFAULT:
@@ -1521,11 +1944,10 @@ static int vidioc_s_selection(struct file *file, void *fh,
 	struct viv_rect * rect;
 	int rc;
 
-	if (s->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+	if (!viv_is_capture_type(vdev, s->type))
 		return -EINVAL;
 
-	viv_post_simple_event(VIV_VIDEO_EVENT_CREATE_PIPELINE,
-		handle->streamid, &handle->vfh, true);
+	viv_create_pipeline(handle);
 
 	if (s->r.top < 0 || s->r.left < 0)
 		return -EINVAL;
@@ -1612,6 +2034,24 @@ static const struct v4l2_ioctl_ops video_ioctl_ops = {
 	.vidioc_s_selection = vidioc_s_selection,
 };
 
+/* mplane nodes swap the single-plane format ioctls for their mplane twins */
+static void viv_init_mplane_ops(struct viv_video_device *vdev)
+{
+	struct v4l2_ioctl_ops *ops = &vdev->mplane_ioctl_ops;
+
+	*ops = video_ioctl_ops;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 3, 0)
+	ops->vidioc_enum_fmt_vid_cap = NULL;
+	ops->vidioc_enum_fmt_vid_cap_mplane = vidioc_enum_fmt_vid_cap;
+#endif
+	ops->vidioc_g_fmt_vid_cap = NULL;
+	ops->vidioc_try_fmt_vid_cap = NULL;
+	ops->vidioc_s_fmt_vid_cap = NULL;
+	ops->vidioc_g_fmt_vid_cap_mplane = vidioc_g_fmt_vid_cap_mplane;
+	ops->vidioc_try_fmt_vid_cap_mplane = vidioc_try_fmt_vid_cap_mplane;
+	ops->vidioc_s_fmt_vid_cap_mplane = vidioc_s_fmt_vid_cap_mplane;
+}
+
 /* sys /dev/mem can't map large memory size */
 static int viv_private_mmap(struct file *file, struct vm_area_struct *vma)
 {
@@ -1733,8 +2173,24 @@ static int viv_s_ctrl(struct v4l2_ctrl *ctrl)
 	return ret;
 }
 
+static int viv_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct viv_custom_ctrls *cc =
+		container_of(ctrl->handler, struct viv_custom_ctrls, handler);
+	struct viv_video_device *vdev =
+		container_of(cc, struct viv_video_device, ctrls);
+
+	switch (ctrl->id) {
+	case V4L2_CID_VIV_FRAME_DROPS:
+		*ctrl->p_new.p_s64 = vdev->frame_drops;
+		return 0;
+	}
+	return -EINVAL;
+}
+
 static const struct v4l2_ctrl_ops viv_ctrl_ops = {
 	.s_ctrl = viv_s_ctrl,
+	.g_volatile_ctrl = viv_g_volatile_ctrl,
 };
 
 const struct v4l2_ctrl_config viv_video_ctrls[] = {
@@ -1746,6 +2202,15 @@ const struct v4l2_ctrl_config viv_video_ctrls[] = {
 		.max = VIV_JSON_BUFFER_SIZE-1,
 		.step = 1,
 	},
+	{
+		.ops = &viv_ctrl_ops,
+		.id = V4L2_CID_VIV_FRAME_DROPS,
+		.type = V4L2_CTRL_TYPE_INTEGER64,
+		.name = "viv_frame_drops",
+		.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+		.max = S64_MAX,
+		.step = 1,
+	},
 };
 
 static int viv_notifier_bound(struct v4l2_async_notifier *notifier,
@@ -1817,6 +2282,7 @@ static void viv_buf_notify(struct vvbuf_ctx *ctx, struct vb2_dc_buf *buf)
 	struct viv_video_file *fh;
 	struct viv_video_device *vdev;
 	u64 cur_ts, interval;
+	unsigned int i;
 
 	if (!buf || buf->vb.vb2_buf.state != VB2_BUF_STATE_ACTIVE)
 		return;
@@ -1826,12 +2292,27 @@ static void viv_buf_notify(struct vvbuf_ctx *ctx, struct vb2_dc_buf *buf)
 	vdev = fh->vdev;
 	if (!vdev->active)
 		return;
-	buf->vb.vb2_buf.planes[DEF_PLANE_NO].bytesused =
-			vdev->fmt.fmt.pix.sizeimage;
+	if (vdev->mplane) {
+		for (i = 0; i < buf->vb.vb2_buf.num_planes; i++)
+			buf->vb.vb2_buf.planes[i].bytesused =
+				vdev->fmt_mp.plane_fmt[i].sizeimage;
+	} else {
+		buf->vb.vb2_buf.planes[DEF_PLANE_NO].bytesused =
+				vdev->fmt.fmt.pix.sizeimage;
+	}
 	cur_ts = ktime_get_ns();
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 0, 0)
 	buf->vb.vb2_buf.timestamp = buf->timestamp;
 #endif
+	if (buf->frame_id) {
+		buf->vb.sequence = (u32)buf->frame_id;
+		/* frames lost anywhere upstream show up as gaps */
+		if (vdev->last_frame_id && buf->frame_id > vdev->last_frame_id + 1)
+			vdev->frame_drops += buf->frame_id - vdev->last_frame_id - 1;
+		vdev->last_frame_id = buf->frame_id;
+	}
+	trace_video_buf_done(vdev->video->num, buf->vb.vb2_buf.index,
+			buf->timestamp);
 	vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
 
 	/* print fps info for debugging purpose */
@@ -1855,6 +2336,11 @@ static const struct vvbuf_ops viv_buf_ops = {
 static int video_info_procfs_show(struct seq_file *sfile, void *offset)
 {
 	struct viv_video_device *vdev;
+	struct viv_event_stat *stat;
+	struct vvlat_hist dqbuf_lat;
+	unsigned long flags;
+	int i;
+
 	vdev = (struct viv_video_device *) sfile->private;
 
 	seq_printf(sfile, "Name\t\t: %s\n", vdev->video->name);
@@ -1864,6 +2350,22 @@ static int video_info_procfs_show(struct seq_file *sfile, void *offset)
 				VIDEO_FRAME_MIN_WIDTH, VIDEO_FRAME_MIN_HEIGHT);
 	seq_printf(sfile, "Status\t\t: %s\n", vdev->pipeline_status == PIPELINE_STREAMON ? "run" : "idle");
 	seq_printf(sfile, "Fps\t\t: %d.%d\n", vdev->fps/100, vdev->fps%100);
+	seq_printf(sfile, "Drops\t\t: %llu\n", vdev->frame_drops);
+	seq_printf(sfile, "Mode cache\t: %s\n",
+		   vdev->modeinfo_cached ? "valid" : "empty");
+	seq_printf(sfile, "Event\t count\t timeout\t last(us)\t max(us)\t avg(us)\n");
+	spin_lock_irqsave(&vdev->event_wait_lock, flags);
+	for (i = 0; i < VIV_VIDEO_EVENT_MAX; i++) {
+		stat = &vdev->event_stat[i];
+		if (stat->count == 0)
+			continue;
+		seq_printf(sfile, "%d\t %u\t %u\t\t %llu\t\t %llu\t\t %llu\n",
+				i, stat->count, stat->timeout, stat->last_us,
+				stat->max_us, div_u64(stat->total_us, stat->count));
+	}
+	dqbuf_lat = vdev->dqbuf_lat;
+	spin_unlock_irqrestore(&vdev->event_wait_lock, flags);
+	vvlat_hist_show(sfile, "dqbuf", &dqbuf_lat);
 
 	return 0;
 }
@@ -2000,11 +2502,26 @@ static int viv_video_probe(struct platform_device *pdev)
 
 			v4l2_ctrl_handler_init(&vdev->ctrls.handler,  2 + ARRAY_SIZE(viv_video_ctrls));
 			vdev->ctrls.request = v4l2_ctrl_new_custom(&vdev->ctrls.handler, &viv_video_ctrls[0], NULL);
+			v4l2_ctrl_new_custom(&vdev->ctrls.handler, &viv_video_ctrls[1], NULL);
 			vdev->video->ctrl_handler = &vdev->ctrls.handler;
 
 			vdev->video->release = video_device_release;
 			vdev->video->fops = &video_ops;
-			vdev->video->ioctl_ops = &video_ioctl_ops;
+			vdev->mplane = fwnode_property_read_bool(
+					of_fwnode_handle(nodes[i].node),
+					"vsi,mplane");
+			vdev->plane_align = VIDEO_PLANE_ALIGN_MIN;
+			fwnode_property_read_u32(of_fwnode_handle(nodes[i].node),
+					"vsi,plane-align", &vdev->plane_align);
+			if (!is_power_of_2(vdev->plane_align) ||
+			    vdev->plane_align < VIDEO_PLANE_ALIGN_MIN)
+				vdev->plane_align = VIDEO_PLANE_ALIGN_MIN;
+			if (vdev->mplane) {
+				viv_init_mplane_ops(vdev);
+				vdev->video->ioctl_ops = &vdev->mplane_ioctl_ops;
+			} else {
+				vdev->video->ioctl_ops = &video_ioctl_ops;
+			}
 			vdev->video->minor = -1;
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 10, 0)
 			vdev->video->vfl_type = VFL_TYPE_VIDEO;
@@ -2012,8 +2529,9 @@ static int viv_video_probe(struct platform_device *pdev)
 			vdev->video->vfl_type = VFL_TYPE_GRABBER;
 #endif
 #if LINUX_VERSION_CODE > KERNEL_VERSION(5, 0, 0)
-			vdev->video->device_caps =
-					V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+			vdev->video->device_caps = V4L2_CAP_STREAMING |
+					(vdev->mplane ? V4L2_CAP_VIDEO_CAPTURE_MPLANE :
+					 V4L2_CAP_VIDEO_CAPTURE);
 #endif
 			video_set_drvdata(vdev->video, vdev);
 
@@ -2096,11 +2614,17 @@ static int viv_video_probe(struct platform_device *pdev)
 				memcpy(vdev->formats, formats, sizeof(formats));
 				vdev->formatscount = ARRAY_SIZE(formats);
 			}
+			viv_fill_fmt_mp(vdev, &vdev->fmt.fmt.pix,
+					vdev->formats[0].fourcc, &vdev->fmt_mp);
 			vdev->last_ts = 0;
 			vdev->fps = 0;
 			vdev->frame_cnt = 0;
 			atomic_set(&(vdev->refcnt), 0);
 			mutex_init(&vdev->event_lock);
+			spin_lock_init(&vdev->event_wait_lock);
+			INIT_LIST_HEAD(&vdev->event_wait_list);
+			init_waitqueue_head(&vdev->event_subscribe_wq);
+			vdev->event_seq = 0;
 
 			continue;
 register_fail:
@@ -59,9 +59,11 @@
 #include <media/v4l2-async.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-fh.h>
+#include <media/v4l2-ioctl.h>
 
 #include "viv_video_kevent.h"
 #include "vvbuf.h"
+#include "vvlat.h"
 
 #define MAX_SUBDEVS_NUM (8)
 #define VIDEO_NODE_NUM  (2)
@@ -74,6 +76,22 @@ struct viv_custom_ctrls {
 	struct completion wait;
 };
 
+struct viv_event_waiter {
+	struct list_head entry;
+	u32 seq;
+	u32 id;
+	int result;
+	struct completion done;
+};
+
+struct viv_event_stat {
+	u32 count;
+	u32 timeout;
+	u64 last_us;
+	u64 max_us;
+	u64 total_us;
+};
+
 struct viv_video_fmt {
 	int fourcc;
 	int depth;
@@ -101,11 +119,18 @@ struct viv_video_device {
 	struct media_device *mdev;
 	struct media_pad pad;
 	struct v4l2_format fmt;
+	bool mplane;		/* node is V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE */
+	u32 plane_align;	/* plane base and size alignment in bytes */
+	struct v4l2_pix_format_mplane fmt_mp;
+	struct v4l2_ioctl_ops mplane_ioctl_ops;
 	struct v4l2_fract timeperframe;
 	struct v4l2_rect crop, compose;
 	struct viv_custom_ctrls ctrls;
 	struct vvcam_constant_modeinfo camera_mode;
 	uint32_t camera_status;
+	bool modeinfo_cached;	/* camera_mode/formats valid without the daemon */
+	bool caps_supports_cached;
+	bool pipeline_created;	/* CREATE_PIPELINE sent since the last DEL_STREAM */
 	struct viv_video_fmt formats[20];
 	int formatscount;
 	int id;
@@ -124,7 +149,14 @@ struct viv_video_device {
 	int dumpbuf_status;
 	struct vb2_dc_buf* dumpbuf;
 	struct mutex event_lock;
-	struct video_event_shm event_shm;
+	spinlock_t event_wait_lock;
+	struct list_head event_wait_list;
+	wait_queue_head_t event_subscribe_wq;
+	u32 event_seq;
+	struct viv_event_stat event_stat[VIV_VIDEO_EVENT_MAX];
+	struct vvlat_hist dqbuf_lat;
+	u64 last_frame_id;
+	u64 frame_drops;	/* gaps in frame_id since stream on */
 	int pipeline_status;
 	struct proc_dir_entry *pde;
 };
@@ -141,7 +173,6 @@ struct viv_video_file {
 	struct completion wait;
 	struct list_head entry;
 	struct viv_video_device *vdev;
-	int pipeline;
 	struct list_head extdmaqueue;
 };
 
@@ -151,6 +182,9 @@ struct viv_video_file {
 #define VIDEO_FRAME_MAX_HEIGHT 3072
 #define VIDEO_FRAME_WIDTH_ALIGN 16
 #define VIDEO_FRAME_HEIGHT_ALIGN 8
+#define VIDEO_PLANE_ALIGN_MIN 16	/* dwe takes plane bases >> 4 */
+#define VIDEO_STRIDE_ALIGN 16
+#define VIDEO_FRAME_MAX_STRIDE (VIDEO_FRAME_MAX_WIDTH * 4)
 
 #define VIDEO_COLORSPACE_DEFAULT V4L2_COLORSPACE_SMPTE170M
 
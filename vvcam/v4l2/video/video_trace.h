@@ -0,0 +1,101 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vvcam_video
+
+#if !defined(_VIDEO_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _VIDEO_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(video_buf_done,
+	TP_PROTO(int id, u32 index, u64 timestamp),
+	TP_ARGS(id, index, timestamp),
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u32, index)
+		__field(u64, timestamp)
+	),
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->index = index;
+		__entry->timestamp = timestamp;
+	),
+	TP_printk("video%d index=%u timestamp=%llu",
+		__entry->id, __entry->index, __entry->timestamp)
+);
+
+TRACE_EVENT(video_dqbuf,
+	TP_PROTO(int id, u32 index, u64 latency_ns),
+	TP_ARGS(id, index, latency_ns),
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u32, index)
+		__field(u64, latency_ns)
+	),
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->index = index;
+		__entry->latency_ns = latency_ns;
+	),
+	TP_printk("video%d index=%u latency_ns=%llu",
+		__entry->id, __entry->index, __entry->latency_ns)
+);
+
+#endif /* _VIDEO_TRACE_H_ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE video_trace
+#include <trace/define_trace.h>
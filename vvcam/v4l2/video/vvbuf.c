@@ -69,6 +69,20 @@ void vvbuf_ctx_deinit(struct vvbuf_ctx *ctx)
 	/*nop*/
 }
 
+/* Drop every queued buffer without returning it. */
+void vvbuf_flush(struct vvbuf_ctx *ctx)
+{
+	unsigned long flags;
+
+	if (unlikely(!ctx))
+		return;
+
+	spin_lock_irqsave(&ctx->irqlock, flags);
+	if (!list_empty(&ctx->dmaqueue))
+		list_del_init(&ctx->dmaqueue);
+	spin_unlock_irqrestore(&ctx->irqlock, flags);
+}
+
 struct vb2_dc_buf *vvbuf_pull_buf(struct vvbuf_ctx *ctx)
 {
 	unsigned long flags;
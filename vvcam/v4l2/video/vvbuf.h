@@ -68,7 +68,12 @@ struct vb2_dc_buf {
 	struct media_pad *pad;
 	struct list_head irqlist;
 	dma_addr_t dma;
+	dma_addr_t dma_cb;	/* separate chroma plane, 0 if contiguous */
+	u32 stride;		/* bytes per line, 0 if packed */
 	uint64_t timestamp;
+	uint64_t done_ts;	/* when the producer completed it */
+	uint64_t queue_ts;	/* when the consumer queued it */
+	uint64_t frame_id;	/* isp frame_in_cnt of the frame, 0 if unknown */
 	int flags;
 };
 
@@ -86,6 +91,7 @@ struct vvbuf_ctx {
 
 void vvbuf_ctx_init(struct vvbuf_ctx *ctx);
 void vvbuf_ctx_deinit(struct vvbuf_ctx *ctx);
+void vvbuf_flush(struct vvbuf_ctx *ctx);
 struct vb2_dc_buf *vvbuf_pull_buf(struct vvbuf_ctx *ctx);
 int vvbuf_push_buf(struct vvbuf_ctx *ctx, struct vb2_dc_buf *buf);
 
@@ -0,0 +1,119 @@
+/****************************************************************************
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************
+ *
+ * The GPL License (GPL)
+ *
+ * Copyright (c) 2020 VeriSilicon Holdings Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program;
+ *
+ *****************************************************************************
+ *
+ * Note: This software is released under dual MIT and GPL licenses. A
+ * recipient may use this file under the terms of either the MIT license or
+ * GPL License. If you wish to use only one license not the other, you can
+ * indicate your decision by deleting one of the above license notices in your
+ * version of this file.
+ *
+ *****************************************************************************/
+#ifndef _VVLAT_H_
+#define _VVLAT_H_
+
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/time.h>
+
+/* bucket 0 is < 1us, bucket n holds [2^(n-1), 2^n) us */
+#define VVLAT_HIST_NUM		(24)
+
+struct vvlat_hist {
+	u64 count;
+	u64 total_us;
+	u64 max_us;
+	u32 bucket[VVLAT_HIST_NUM];
+};
+
+static inline void vvlat_hist_add(struct vvlat_hist *hist, u64 delta_ns)
+{
+	u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+	int i = fls64(us);
+
+	if (i >= VVLAT_HIST_NUM)
+		i = VVLAT_HIST_NUM - 1;
+	hist->bucket[i]++;
+	hist->count++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
+/* upper bound in us of the bucket holding the pct percentile */
+static inline u64 vvlat_hist_pct(const struct vvlat_hist *hist, u32 pct)
+{
+	u64 target, sum = 0;
+	int i;
+
+	if (hist->count == 0)
+		return 0;
+
+	target = div_u64(hist->count * pct + 99, 100);
+	for (i = 0; i < VVLAT_HIST_NUM; i++) {
+		sum += hist->bucket[i];
+		if (sum >= target)
+			return min_t(u64, 1ULL << i, hist->max_us);
+	}
+	return hist->max_us;
+}
+
+static inline void vvlat_hist_show(struct seq_file *sfile, const char *name,
+				const struct vvlat_hist *hist)
+{
+	int i;
+
+	seq_printf(sfile, "%s\t count %llu avg(us) %llu p50(us) %llu p99(us) %llu max(us) %llu\n",
+			name, hist->count,
+			hist->count ? div64_u64(hist->total_us, hist->count) : 0,
+			vvlat_hist_pct(hist, 50), vvlat_hist_pct(hist, 99),
+			hist->max_us);
+	seq_puts(sfile, "\t log2(us)");
+	for (i = 0; i < VVLAT_HIST_NUM; i++)
+		seq_printf(sfile, " %u", hist->bucket[i]);
+	seq_puts(sfile, "\n");
+}
+
+#endif /* _VVLAT_H_ */